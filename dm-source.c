@@ -6,8 +6,27 @@
 #include <sys/stat.h>
 #include <util/threading.h>
 #include <util/darray.h>
+#include <util/profiler.h>
+#include <util/crc32.h>
+#include <util/task.h>
 #include <curl/curl.h>
 #include <curl/easy.h>
+#include <math.h>
+#ifdef _WIN32
+#define COBJMACROS
+#include <windows.h>
+#include <wincodec.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef DM_HAVE_LIBJPEG
+#include <limits.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <jpeglib.h>
+#endif
+#endif
 
 
 #define blog(log_level, format, ...) \
@@ -21,6 +40,209 @@
 #define warn(format, ...) \
 	blog(LOG_WARNING, format, ##__VA_ARGS__)
 
+//for code that runs without a source, e.g. the download worker
+#define module_log(log_level, format, ...) \
+	(blog)(log_level, "[dm_source] " format, ##__VA_ARGS__)
+
+#define DM_DEFAULT_CARDSERVICE "http://dicecoalition.com/cardservice"
+
+//size used for cards and dice strips that haven't been downloaded yet
+#define DM_PLACEHOLDER_CX 368u
+#define DM_PLACEHOLDER_CY 515u
+#define DM_PLACEHOLDER_DICE_CY 50u
+
+#define DM_FETCH_QUEUE_SIZE 64
+//downloads up to this size are held in memory, decoded and written out on
+//the decoders.  bigger ones go to disk as they arrive.
+#define DM_FETCH_MAX_BODY (16 * 1024 * 1024)
+
+#define DM_TEAM_MAX_CARDS 64
+//teams a tournament source switches between
+#define DM_TOURNAMENT_MAX_TEAMS 64
+
+//variants are made down to 1/8th size, about where jpeg artifacts take over
+#define DM_SCALE_MAX_SHIFT 3
+#define DM_SET_CODE_MAX 8
+
+//profiler scope names, the profiler keys on the pointer so they're shared
+static const char *dm_profile_file_list = "dm_source: updateFileList";
+static const char *dm_profile_parse = "parse team";
+static const char *dm_profile_request = "check cache and request downloads";
+static const char *dm_profile_textures = "dm_source: updateTextures";
+static const char *dm_profile_probe = "probe card sizes";
+static const char *dm_profile_layout = "compile layout";
+static const char *dm_profile_compose = "compose";
+static const char *dm_profile_direct = "upload for direct render";
+static const char *dm_profile_atlas = "build atlas";
+static const char *dm_profile_buffer = "prepare buffer";
+static const char *dm_profile_tick = "dm_source: tick";
+static const char *dm_profile_downloads = "apply downloads";
+static const char *dm_profile_prefetch = "prefetch";
+static const char *dm_profile_advance = "advance";
+static const char *dm_profile_control = "control deltas";
+static const char *dm_profile_rebuild = "rebuild steps";
+
+//one card of a parsed team builder string
+struct dm_team_card {
+	uint8_t dice;
+	uint16_t number;
+	char set[DM_SET_CODE_MAX];
+};
+
+//one team of a tournament, as "<name>: <team builder string>"
+struct dm_team_entry {
+	char *name;
+	char *tbstring;
+};
+
+static inline bool dm_is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline bool dm_is_alnum(char c)
+{
+	return dm_is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool dm_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+struct dm_fetch_job {
+	char *url;
+	char *path;
+	//conditional request for a file that is already cached
+	bool revalidate;
+};
+
+//one face of a card plus its dice strip, as packed into the cycle cards atlas
+struct dm_frame {
+	size_t card;
+	int face;
+	uint32_t x;
+	uint32_t y;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t facewidth;
+	uint32_t faceheight;
+};
+
+//where a card was drawn in the composed views, so flip cards can be
+//redrawn in place
+struct dm_slot {
+	size_t card;
+	uint32_t x;
+	uint32_t y;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t dicex;
+	uint32_t dicey;
+	bool flip;
+};
+
+struct dm_layout;
+
+//what the compiled slot table was built for
+struct dm_layout_key {
+	const struct dm_layout *layout;
+	size_t count;
+	uint32_t cardwidth;
+	uint32_t cardheight;
+	uint32_t diceheight;
+	uint32_t margin;
+};
+
+//a card face in Cycle Cards mode.  it holds references to the card's images,
+//whose faces are resident textures, so showing it is only a pointer swap.
+struct dm_buffer {
+	struct dm_image *image;
+	struct dm_image *dice;
+	//drawn in place of a card that hasn't downloaded yet
+	gs_texture_t *blank;
+	size_t card;
+	int face;
+	bool flip;
+	bool placeholder;
+	uint32_t facewidth;
+	uint32_t faceheight;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+//where an amortized rebuild of a composed view has got to
+enum dm_rebuild_stage {
+	DM_REBUILD_IDLE,
+	DM_REBUILD_PROBE,
+	DM_REBUILD_LAYOUT,
+	DM_REBUILD_DECODE,
+	DM_REBUILD_UPLOAD,
+	DM_REBUILD_COPY,
+	DM_REBUILD_SWAP,
+};
+
+//a card decoded on the decoders for a rebuild.  the task and the rebuild
+//each hold a reference, whichever lets go last frees it
+struct dm_decode_job {
+	char *path;
+	int shift;
+	bool compressed;
+	struct dm_image *image;
+	bool hit;
+	uint64_t ns;
+	//taken into the source's stats by the first slot that uses it
+	bool counted;
+	os_event_t *done;
+	volatile long refs;
+};
+
+//a composed view being built off screen.  it gets its own slot table,
+//texture and image references, which are swapped in once it's complete
+struct dm_rebuild {
+	enum dm_rebuild_stage stage;
+	//file or slot the stage is on
+	size_t next;
+	uint32_t maxwidth;
+	uint32_t maxheight;
+	uint32_t diceheight;
+	uint32_t width;
+	uint32_t height;
+	//the slot table being built and what it was compiled for
+	struct dm_layout_key key;
+	DARRAY(struct dm_slot) slots;
+	DARRAY(size_t) flipslots;
+	gs_texture_t *texture;
+	//texture is the last team's, slots are blanked before they're drawn
+	bool reused;
+	gs_texture_t *placeholder;
+	//each slot's card decode, queued once the slots are laid out
+	DARRAY(struct dm_decode_job *) jobs;
+	//the slot's images between decode and copy
+	struct dm_image *card;
+	struct dm_image *dice;
+	//direct render keeps every slot's images
+	DARRAY(struct dm_image *) slotcards;
+	DARRAY(struct dm_image *) slotdice;
+	//flip step the faces were picked for
+	int index;
+	uint64_t start;
+	uint32_t ticks;
+};
+
+//running totals for the stats log and the properties panel
+struct dm_source_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t decode_ns;
+	uint64_t downloaded;
+	uint64_t last_log;
+	uint64_t last_snapshot;
+	//the properties panel reads this copy, the totals belong to the video thread
+	pthread_mutex_t mutex;
+	char *snapshot;
+};
+
 struct dm_source {
 	obs_source_t *src;
 	char *imagefolder;
@@ -28,23 +250,112 @@ struct dm_source {
 	uint32_t speed;
 	DARRAY(char*) files;
 	DARRAY(char*) dice;
+	DARRAY(struct dm_team_card) team;
 	int currentIndex;
 	uint64_t     last_time;
 	float        update_time_elapsed;
-	gs_image_file_t image;
-	gs_image_file_t diceimage;
 	gs_texture_t *comboTexture;
 	bool visible;
 	bool showdicecount;
-	bool useplaymatlayout;
-	bool usecreatorview;
 	uint32_t cardmargins;
 	uint32_t height;
 	uint32_t width;
 	char *format;
 	bool hasFlipCard;
+	char *cardservice;
+	//downloads the worker queue couldn't take yet
+	DARRAY(struct dm_fetch_job) pending;
+	//files still missing on disk, and the worker generation they were counted at
+	size_t waiting;
+	long fetch_generation;
+	bool placeholder_shown;
+	//set while a refresh asks the server about already cached files
+	bool revalidate;
+	//set by the refresh button on the UI thread, the tick does the refresh
+	volatile bool refresh_requested;
+	//cycle cards mode draws frames out of one atlas when the team fits
+	gs_texture_t *atlas;
+	DARRAY(struct dm_frame) frames;
+	size_t currentFrame;
+	bool atlas_unfit;
+	bool cycleatlas;
+	struct dm_buffer buffers[2];
+	int front;
+	bool back_ready;
+	bool prefetch_due;
+	DARRAY(struct dm_slot) slots;
+	//slots holding flip cards, the only ones a flip has to redraw
+	DARRAY(size_t) flipslots;
+	//composed views, NULL in cycle cards mode
+	const struct dm_layout *layout;
+	struct dm_layout *customlayout;
+	char *layoutfile;
+	time_t layout_mtime;
+	struct dm_layout_key layout_key;
+	//direct render draws each slot straight from the shared card textures,
+	//holding references to them instead of owning a combo texture
+	bool directrender;
+	DARRAY(struct dm_image *) slotcards;
+	DARRAY(struct dm_image *) slotdice;
+	gs_texture_t *placeholder;
+	//cards drawn as sprites are uploaded as bc1 blocks
+	bool gpucompress;
+	//cards are drawn from variants downscaled by 1 << scale_shift
+	bool scaletooutput;
+	int scale_shift;
+	//settings have been applied once, later updates only redo what changed
+	bool loaded;
+	struct dm_source_stats stats;
+	//requested downloads not seen on disk yet, counted into the stats when they land
+	DARRAY(char *) fetching;
+	//keep textures resident while hidden, up to standby_budget bytes
+	bool persistent;
+	size_t standby_budget;
+	bool standby;
+	bool standby_stale;
+	//dice count strips drawn from the built-in glyphs
+	uint32_t dice_height;
+	uint32_t dice_color;
+	uint32_t dice_background;
+	bool dice_bold;
+	//composed views are rebuilt a few steps per tick within this budget
+	struct dm_rebuild rebuild;
+	uint64_t rebuild_budget_ns;
+	//tournament mode shows one of several teams, with every team's cards
+	//held resident by preload_images
+	DARRAY(struct dm_team_entry) teams;
+	char *teamstext;
+	size_t activeteam;
+	//the tick moves the team on (control file, hotkeys) without touching
+	//the settings, dm_source_save writes it back on the ui thread.  the
+	//mutex covers what that reads against the tick replacing it
+	pthread_mutex_t team_mutex;
+	//the team settings as last applied, only a change from these is the user's
+	char *settings_tbstring;
+	char *settings_teams;
+	long long settings_activeteam;
+	//the last team's combo texture and atlas, drawn over by the next team
+	//of the same size instead of allocating new ones
+	gs_texture_t *spare_combo;
+	struct dm_layout_key spare_key;
+	gs_texture_t *spare_atlas;
+	//transparent pixels to blank the parts of a reused texture with
+	gs_texture_t *zeros;
+	//hotkey presses not taken by the tick yet
+	volatile long team_next;
+	volatile long team_prev;
+	DARRAY(char *) preload_paths;
+	DARRAY(struct dm_image *) preload_images;
+	size_t preload_next;
+	int preload_shift;
+	long preload_generation;
+	//live team changes from a local control file, see dm_source_poll_control
+	char *controlfile;
+	struct dm_control *control;
+	float control_elapsed;
 };
 
+#ifdef _WIN32
 bool ConvertCharToBitmap(TCHAR* szFileName, TCHAR* szStr, int iWidth, int iHeight, int iFontSize)
 {
 	HWND hWnd = GetActiveWindow();
@@ -118,530 +429,6224 @@ bool ConvertCharToBitmap(TCHAR* szFileName, TCHAR* szStr, int iWidth, int iHeigh
 	//Size of the file
 	bmfHeader.bfSize = dwSizeofDIB;
 
-	//bfType must always be BM for Bitmaps
-	bmfHeader.bfType = 0x4D42; //BM   
+	//bfType must always be BM for Bitmaps
+	bmfHeader.bfType = 0x4D42; //BM   
+
+	DWORD dwBytesWritten = 0;
+	WriteFile(hFile, (LPSTR)&bmfHeader, sizeof(BITMAPFILEHEADER), &dwBytesWritten, NULL);
+	WriteFile(hFile, (LPSTR)&bi, sizeof(BITMAPINFOHEADER), &dwBytesWritten, NULL);
+	WriteFile(hFile, (LPSTR)lpBitmap, dwBmpSize, &dwBytesWritten, NULL);
+
+	//Unlock and Free the DIB from the heap
+	GlobalUnlock(hDIB);
+	GlobalFree(hDIB);
+
+	//Close the handle for the file that was created
+	CloseHandle(hFile);
+
+	//SelectObject(hMemDC, hOldBrush);
+	SelectObject(hDC, hOldFont);
+	SelectObject(hDC, hOldBitmap);
+
+	//DeleteObject(hBrush);
+	DeleteObject(hFont);
+	DeleteObject(hBitmap);
+	DeleteDC(hMemDC);
+
+	ReleaseDC(NULL, hDC);
+
+	return true;
+}
+#endif
+
+size_t callbackfunction(void *ptr, size_t size, size_t nmemb, void* userdata)
+{
+	FILE* stream = (FILE*)userdata;
+	if (!stream)
+	{
+		printf("!!! No stream\n");
+		return 0;
+	}
+
+	size_t written = fwrite((FILE*)ptr, size, nmemb, stream);
+	return written * size;
+}
+
+/* ------------------------------------------------------------------------- */
+/* on disk cache index, one per image folder                                 */
+
+/*
+ * dm-cache-index.json in the image folder records every card the plugin has
+ * cached there: file name, size, crc32 of the download, last use (unix time)
+ * and dimensions once known.  Team loads look cards up here instead of
+ * probing the filesystem, and the folder is kept under the disk budget by
+ * deleting the least recently used cards.  Files dropped into the folder by
+ * hand or by another OBS are adopted the first time they're looked up.
+ * Compressed variants and bundles are recorded too so they count against
+ * the budget; variants are evicted like cards, bundles are only replaced by
+ * the next build.  OBS instances sharing a folder merge their changes into
+ * the index on disk under its lock before writing it.  The index file and
+ * the folder are only read and written with dm_disk.mutex released, against
+ * a copy of the entries taken under it.
+ */
+
+#define DM_DISK_INDEX_NAME "dm-cache-index.json"
+#define DM_DISK_DEFAULT_BUDGET_MB 1024
+
+struct dm_disk_entry {
+	char *name;
+	uint64_t size;
+	//0 for adopted files that weren't downloaded by this plugin
+	uint32_t crc;
+	int64_t used;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+struct dm_disk_index {
+	char *folder;
+	//sorted by name
+	DARRAY(struct dm_disk_entry) entries;
+	//names dropped since the last save, so a merge doesn't bring them back
+	DARRAY(char *) removed;
+	uint64_t bytes;
+	bool dirty;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	bool initialized;
+	DARRAY(struct dm_disk_index *) indexes;
+	volatile long budget_mb;
+	//cards used since OBS started are never evicted
+	int64_t session_start;
+} dm_disk;
+
+static void dm_validators_path(struct dstr *out, const char *path);
+static bool dm_images_publish(const char *path, uint8_t *pixels, enum gs_color_format format, uint32_t cx,
+	uint32_t cy, uint64_t start);
+static void dm_images_stamp(const char *path);
+static uint8_t *dm_decode_memory(const uint8_t *data, size_t size, enum gs_color_format *format,
+	uint32_t *cx, uint32_t *cy);
+static bool dm_fetch_lock(const char *path);
+static void dm_fetch_unlock(const char *path);
+static void dm_fetch_touch(const char *path);
+static void dm_bc1_path(struct dstr *out, const char *path, int shift);
+static bool dm_bundle_is_file(const char *name);
+
+//splits path into its folder and file name, returns the name
+static const char *dm_disk_split(const char *path, size_t *folder_len)
+{
+	const char *name = path;
+	for (const char *p = path; *p; p++)
+		if (*p == '/' || *p == '\\')
+			name = p + 1;
+	*folder_len = name > path ? (size_t)(name - path - 1) : 0;
+	return name;
+}
+
+static bool dm_disk_find(struct dm_disk_index *index, const char *name, size_t *pos)
+{
+	size_t lo = 0;
+	size_t hi = index->entries.num;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = strcmp(index->entries.array[mid].name, name);
+		if (cmp == 0) {
+			*pos = mid;
+			return true;
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*pos = lo;
+	return false;
+}
+
+static struct dm_disk_entry *dm_disk_insert(struct dm_disk_index *index, const char *name, uint64_t size)
+{
+	size_t pos;
+	if (dm_disk_find(index, name, &pos))
+		return &index->entries.array[pos];
+
+	struct dm_disk_entry *entry = da_insert_new(index->entries, pos);
+	entry->name = bstrdup(name);
+	entry->size = size;
+	index->bytes += size;
+	index->dirty = true;
+	return entry;
+}
+
+static void dm_disk_erase(struct dm_disk_index *index, size_t pos)
+{
+	index->bytes -= index->entries.array[pos].size;
+	da_push_back(index->removed, &index->entries.array[pos].name);
+	da_erase(index->entries, pos);
+	index->dirty = true;
+}
+
+static bool dm_disk_was_removed(struct dm_disk_index *index, const char *name)
+{
+	for (size_t i = 0; i < index->removed.num; i++)
+		if (strcmp(index->removed.array[i], name) == 0)
+			return true;
+	return false;
+}
+
+static void dm_disk_clear(struct dm_disk_index *index)
+{
+	for (size_t e = 0; e < index->entries.num; e++)
+		bfree(index->entries.array[e].name);
+	for (size_t e = 0; e < index->removed.num; e++)
+		bfree(index->removed.array[e]);
+	da_free(index->entries);
+	da_free(index->removed);
+	index->bytes = 0;
+}
+
+static void dm_disk_index_path(struct dstr *file, const char *folder)
+{
+	dstr_printf(file, "%s/%s", folder, DM_DISK_INDEX_NAME);
+}
+
+static void dm_disk_load(struct dm_disk_index *index)
+{
+	struct dstr file = { 0 };
+	dm_disk_index_path(&file, index->folder);
+	obs_data_t *data = obs_data_create_from_json_file(file.array);
+	dstr_free(&file);
+	if (!data)
+		return;
+
+	obs_data_array_t *cards = obs_data_get_array(data, "cards");
+	size_t count = obs_data_array_count(cards);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(cards, i);
+		const char *name = obs_data_get_string(item, "name");
+		if (*name) {
+			struct dm_disk_entry *entry = dm_disk_insert(index, name,
+				(uint64_t)obs_data_get_int(item, "size"));
+			entry->crc = (uint32_t)obs_data_get_int(item, "crc");
+			entry->used = obs_data_get_int(item, "used");
+			entry->cx = (uint32_t)obs_data_get_int(item, "cx");
+			entry->cy = (uint32_t)obs_data_get_int(item, "cy");
+		}
+		obs_data_release(item);
+	}
+	obs_data_array_release(cards);
+	obs_data_release(data);
+	index->dirty = false;
+}
+
+//expects the index file's lock to be held
+static bool dm_disk_save(struct dm_disk_index *index)
+{
+	bool saved = false;
+	struct dstr file = { 0 };
+	obs_data_t *data = obs_data_create();
+	obs_data_array_t *cards = obs_data_array_create();
+
+	for (size_t i = 0; i < index->entries.num; i++) {
+		struct dm_disk_entry *entry = &index->entries.array[i];
+		obs_data_t *item = obs_data_create();
+		obs_data_set_string(item, "name", entry->name);
+		obs_data_set_int(item, "size", (long long)entry->size);
+		obs_data_set_int(item, "crc", entry->crc);
+		obs_data_set_int(item, "used", entry->used);
+		if (entry->cx && entry->cy) {
+			obs_data_set_int(item, "cx", entry->cx);
+			obs_data_set_int(item, "cy", entry->cy);
+		}
+		obs_data_array_push_back(cards, item);
+		obs_data_release(item);
+	}
+	obs_data_set_array(data, "cards", cards);
+
+	dm_disk_index_path(&file, index->folder);
+	if (obs_data_save_json_safe(data, file.array, "tmp", "bak")) {
+		for (size_t i = 0; i < index->removed.num; i++)
+			bfree(index->removed.array[i]);
+		da_resize(index->removed, 0);
+		index->dirty = false;
+		saved = true;
+	}
+	else
+		module_log(LOG_WARNING, "failed to save cache index '%s'", file.array);
+
+	dstr_free(&file);
+	obs_data_array_release(cards);
+	obs_data_release(data);
+	return saved;
+}
+
+//copies the entries, the folder is shared.  indexes are only freed by
+//dm_disk_free so the copy can outlive the lock.
+static void dm_disk_copy(struct dm_disk_index *dst, const struct dm_disk_index *src)
+{
+	dst->folder = src->folder;
+	da_reserve(dst->entries, src->entries.num);
+	for (size_t i = 0; i < src->entries.num; i++) {
+		struct dm_disk_entry entry = src->entries.array[i];
+		entry.name = bstrdup(entry.name);
+		da_push_back(dst->entries, &entry);
+	}
+	dst->bytes = src->bytes;
+}
+
+//reads the index on disk into disk and checks the files it disagrees with
+//ours about, without the lock.  a size of theirs that isn't the file's is
+//replaced with ours, and ours' files that are gone from the folder are
+//listed in disk->removed, for dm_disk_merge to apply.
+static void dm_disk_probe(struct dm_disk_index *ours, struct dm_disk_index *disk)
+{
+	struct dstr path = { 0 };
+	struct stat st;
+	size_t pos;
+
+	disk->folder = ours->folder;
+	dm_disk_load(disk);
+
+	for (size_t i = 0; i < disk->entries.num; i++) {
+		struct dm_disk_entry *theirs = &disk->entries.array[i];
+		if (!dm_disk_find(ours, theirs->name, &pos))
+			continue;
+		uint64_t size = ours->entries.array[pos].size;
+		if (theirs->size == size)
+			continue;
+		//whichever record matches the file that's there now
+		dstr_printf(&path, "%s/%s", ours->folder, theirs->name);
+		if (os_stat(path.array, &st) != 0 || (uint64_t)st.st_size != theirs->size)
+			theirs->size = size;
+	}
+
+	for (size_t i = 0; i < ours->entries.num; i++) {
+		const char *name = ours->entries.array[i].name;
+		if (dm_disk_find(disk, name, &pos))
+			continue;
+		dstr_printf(&path, "%s/%s", ours->folder, name);
+		if (os_stat(path.array, &st) != 0) {
+			char *gone = bstrdup(name);
+			da_push_back(disk->removed, &gone);
+		}
+	}
+
+	dstr_free(&path);
+}
+
+//expects the lock to be held.  folds in what dm_disk_probe found other
+//processes sharing the folder saved since this one loaded the index:
+//entries they added, the later use of a card, and a card they downloaded
+//again.  entries of files that are gone, evicted elsewhere, are dropped.
+//snapshot is the copy that was probed, an entry changed since keeps ours.
+static void dm_disk_merge(struct dm_disk_index *index, struct dm_disk_index *disk,
+		struct dm_disk_index *snapshot)
+{
+	size_t pos, snap;
+
+	for (size_t i = 0; i < disk->entries.num; i++) {
+		struct dm_disk_entry *theirs = &disk->entries.array[i];
+		if (!dm_disk_find(index, theirs->name, &pos)) {
+			if (dm_disk_was_removed(index, theirs->name))
+				continue;
+			struct dm_disk_entry *entry = dm_disk_insert(index, theirs->name, theirs->size);
+			entry->crc = theirs->crc;
+			entry->used = theirs->used;
+			entry->cx = theirs->cx;
+			entry->cy = theirs->cy;
+			continue;
+		}
+
+		struct dm_disk_entry *ours = &index->entries.array[pos];
+		if (theirs->used > ours->used)
+			ours->used = theirs->used;
+		if (!ours->cx) {
+			ours->cx = theirs->cx;
+			ours->cy = theirs->cy;
+		}
+		if (theirs->size != ours->size && dm_disk_find(snapshot, theirs->name, &snap) &&
+		    snapshot->entries.array[snap].size == ours->size) {
+			index->bytes += theirs->size - ours->size;
+			ours->size = theirs->size;
+			ours->crc = theirs->crc;
+			ours->cx = theirs->cx;
+			ours->cy = theirs->cy;
+			index->dirty = true;
+		}
+	}
+
+	for (size_t i = 0; i < disk->removed.num; i++) {
+		const char *name = disk->removed.array[i];
+		if (dm_disk_find(index, name, &pos) && dm_disk_find(snapshot, name, &snap) &&
+		    index->entries.array[pos].size == snapshot->entries.array[snap].size &&
+		    index->entries.array[pos].crc == snapshot->entries.array[snap].crc)
+			dm_disk_erase(index, pos);
+	}
+}
+
+static struct dm_disk_index *dm_disk_lookup(const char *folder, size_t len)
+{
+	for (size_t i = 0; i < dm_disk.indexes.num; i++) {
+		struct dm_disk_index *index = dm_disk.indexes.array[i];
+		if (strlen(index->folder) == len && strncmp(index->folder, folder, len) == 0)
+			return index;
+	}
+	return NULL;
+}
+
+//expects the lock to be held, loads the folder's index on first use.  the
+//lock is let go while the file is read.
+static struct dm_disk_index *dm_disk_get(const char *folder, size_t len)
+{
+	struct dm_disk_index *index = dm_disk_lookup(folder, len);
+	if (index)
+		return index;
+
+	struct dm_disk_index *loaded = bzalloc(sizeof(struct dm_disk_index));
+	loaded->folder = bstrdup_n(folder, len);
+	pthread_mutex_unlock(&dm_disk.mutex);
+	dm_disk_load(loaded);
+	pthread_mutex_lock(&dm_disk.mutex);
+
+	//another thread may have loaded it meanwhile
+	index = dm_disk_lookup(folder, len);
+	if (index) {
+		dm_disk_clear(loaded);
+		bfree(loaded->folder);
+		bfree(loaded);
+		return index;
+	}
+	da_push_back(dm_disk.indexes, &loaded);
+	return loaded;
+}
+
+static void dm_disk_unlink(const char *folder, const char *name)
+{
+	struct dstr path = { 0 };
+	struct dstr sidecar = { 0 };
+	dstr_printf(&path, "%s/%s", folder, name);
+	dm_validators_path(&sidecar, path.array);
+	os_unlink(path.array);
+	os_unlink(sidecar.array);
+	for (int shift = 0; shift <= DM_SCALE_MAX_SHIFT; shift++) {
+		dm_bc1_path(&sidecar, path.array, shift);
+		os_unlink(sidecar.array);
+	}
+	dstr_free(&sidecar);
+	dstr_free(&path);
+}
+
+//expects the lock to be held.  erases the entry and its sidecars' entries,
+//returns its name for deleting the files
+static char *dm_disk_remove(struct dm_disk_index *index, size_t pos)
+{
+	struct dstr sidecar = { 0 };
+	char *name = bstrdup(index->entries.array[pos].name);
+
+	dm_disk_erase(index, pos);
+	for (int shift = 0; shift <= DM_SCALE_MAX_SHIFT; shift++) {
+		dm_bc1_path(&sidecar, name, shift);
+		if (dm_disk_find(index, sidecar.array, &pos))
+			dm_disk_erase(index, pos);
+	}
+
+	dstr_free(&sidecar);
+	return name;
+}
+
+//expects the lock to be held.  deletes the entry's file along with its
+//sidecars, and their entries
+static void dm_disk_drop(struct dm_disk_index *index, size_t pos)
+{
+	char *name = dm_disk_remove(index, pos);
+	dm_disk_unlink(index->folder, name);
+	bfree(name);
+}
+
+static void dm_disk_init(void)
+{
+	if (dm_disk.initialized)
+		return;
+	if (pthread_mutex_init(&dm_disk.mutex, NULL) != 0)
+		return;
+	dm_disk.budget_mb = DM_DISK_DEFAULT_BUDGET_MB;
+	dm_disk.session_start = (int64_t)time(NULL);
+	dm_disk.initialized = true;
+}
+
+//expects the index file's lock to be held and not dm_disk.mutex.  the
+//index is copied under the mutex, the copy probed against the disk and the
+//folder, and what that found folded back in under the mutex along with the
+//evictions.  evicted files are deleted and the index saved after letting go.
+static void dm_disk_flush_index(struct dm_disk_index *index, uint64_t budget)
+{
+	struct dm_disk_index snapshot = { 0 };
+	struct dm_disk_index disk = { 0 };
+	struct dm_disk_index saved = { 0 };
+	struct dstr path = { 0 };
+	DARRAY(char *) evicted;
+	da_init(evicted);
+
+	pthread_mutex_lock(&dm_disk.mutex);
+	dm_disk_copy(&snapshot, index);
+	pthread_mutex_unlock(&dm_disk.mutex);
+
+	dm_disk_probe(&snapshot, &disk);
+
+	pthread_mutex_lock(&dm_disk.mutex);
+	dm_disk_merge(index, &disk, &snapshot);
+	while (budget && index->bytes > budget) {
+		size_t oldest = DARRAY_INVALID;
+		for (size_t e = 0; e < index->entries.num; e++) {
+			struct dm_disk_entry *entry = &index->entries.array[e];
+			if (entry->used >= dm_disk.session_start || dm_bundle_is_file(entry->name))
+				continue;
+			if (oldest == DARRAY_INVALID || entry->used < index->entries.array[oldest].used)
+				oldest = e;
+		}
+		if (oldest == DARRAY_INVALID)
+			break;
+		char *name = dm_disk_remove(index, oldest);
+		da_push_back(evicted, &name);
+	}
+	//names dropped from here on are kept for the next save's merge
+	bool dirty = index->dirty;
+	if (dirty) {
+		dm_disk_copy(&saved, index);
+		saved.removed.da = index->removed.da;
+		da_init(index->removed);
+		index->dirty = false;
+	}
+	pthread_mutex_unlock(&dm_disk.mutex);
+
+	//a card being fetched again right now is left to the fetch
+	for (size_t i = 0; i < evicted.num; i++) {
+		dstr_printf(&path, "%s/%s", index->folder, evicted.array[i]);
+		if (dm_fetch_lock(path.array)) {
+			dm_disk_unlink(index->folder, evicted.array[i]);
+			dm_fetch_unlock(path.array);
+		}
+		bfree(evicted.array[i]);
+	}
+	if (evicted.num)
+		module_log(LOG_INFO, "evicted %zu files from '%s' to stay under %ld MB",
+			evicted.num, index->folder, os_atomic_load_long(&dm_disk.budget_mb));
+
+	if (dirty && !dm_disk_save(&saved)) {
+		pthread_mutex_lock(&dm_disk.mutex);
+		for (size_t i = 0; i < saved.removed.num; i++)
+			da_push_back(index->removed, &saved.removed.array[i]);
+		da_resize(saved.removed, 0);
+		index->dirty = true;
+		pthread_mutex_unlock(&dm_disk.mutex);
+	}
+
+	da_free(evicted);
+	dstr_free(&path);
+	dm_disk_clear(&saved);
+	dm_disk_clear(&disk);
+	dm_disk_clear(&snapshot);
+}
+
+//evicts least recently used cards until each folder is under budget and
+//writes out the indexes that changed.  an index another process is saving
+//right now is left for the next flush, false if any were.
+static bool dm_disk_flush(void)
+{
+	struct dstr file = { 0 };
+	bool flushed = true;
+
+	if (!dm_disk.initialized)
+		return true;
+
+	uint64_t budget = (uint64_t)os_atomic_load_long(&dm_disk.budget_mb) * 1024 * 1024;
+
+	for (size_t i = 0;; i++) {
+		pthread_mutex_lock(&dm_disk.mutex);
+		struct dm_disk_index *index = i < dm_disk.indexes.num ? dm_disk.indexes.array[i] : NULL;
+		bool due = index && (index->dirty || (budget && index->bytes > budget));
+		pthread_mutex_unlock(&dm_disk.mutex);
+		if (!index)
+			break;
+		if (!due)
+			continue;
+
+		dm_disk_index_path(&file, index->folder);
+		if (!dm_fetch_lock(file.array)) {
+			flushed = false;
+			continue;
+		}
+		dm_disk_flush_index(index, budget);
+		dm_fetch_unlock(file.array);
+	}
+
+	dstr_free(&file);
+	return flushed;
+}
+
+static void dm_disk_free(void)
+{
+	if (!dm_disk.initialized)
+		return;
+
+	//another process only holds an index's lock while it writes it
+	for (int attempt = 0; attempt < 50 && !dm_disk_flush(); attempt++)
+		os_sleep_ms(10);
+	for (size_t i = 0; i < dm_disk.indexes.num; i++) {
+		struct dm_disk_index *index = dm_disk.indexes.array[i];
+		dm_disk_clear(index);
+		bfree(index->folder);
+		bfree(index);
+	}
+	da_free(dm_disk.indexes);
+	pthread_mutex_destroy(&dm_disk.mutex);
+	dm_disk.initialized = false;
+}
+
+//0 turns the budget off.  the cap is shared by every source, the last one
+//updated wins
+static void dm_disk_set_budget(long budget_mb)
+{
+	os_atomic_set_long(&dm_disk.budget_mb, budget_mb);
+}
+
+//true if the file is cached, marking it used.  only files the index
+//doesn't know yet cost a filesystem probe.
+static bool dm_disk_exists(const char *path)
+{
+	size_t folder_len, pos;
+	struct stat st;
+	bool found;
+
+	if (!dm_disk.initialized)
+		return os_file_exists(path);
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	found = dm_disk_find(index, name, &pos);
+	if (!found && os_stat(path, &st) == 0) {
+		dm_disk_insert(index, name, (uint64_t)st.st_size);
+		found = dm_disk_find(index, name, &pos);
+	}
+	if (found) {
+		index->entries.array[pos].used = (int64_t)time(NULL);
+		index->dirty = true;
+	}
+	pthread_mutex_unlock(&dm_disk.mutex);
+	return found;
+}
+
+//a download was committed to path, or a file the plugin made itself with
+//crc 0
+static void dm_disk_record(const char *path, uint64_t size, uint32_t crc)
+{
+	size_t folder_len, pos;
+
+	if (!dm_disk.initialized)
+		return;
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	//a replaced file starts over, its dimensions may have changed too
+	if (dm_disk_find(index, name, &pos))
+		dm_disk_erase(index, pos);
+	struct dm_disk_entry *entry = dm_disk_insert(index, name, size);
+	entry->crc = crc;
+	entry->used = (int64_t)time(NULL);
+	pthread_mutex_unlock(&dm_disk.mutex);
+}
+
+//a file the index has went away, by hand or evicted by another process
+static void dm_disk_forget(const char *path)
+{
+	size_t folder_len, pos;
+
+	if (!dm_disk.initialized)
+		return;
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	if (dm_disk_find(index, name, &pos))
+		dm_disk_erase(index, pos);
+	pthread_mutex_unlock(&dm_disk.mutex);
+}
+
+//drops a corrupt card from the index and the folder so it's fetched again
+static void dm_disk_invalidate(const char *path)
+{
+	size_t folder_len, pos;
+
+	if (!dm_disk.initialized)
+		return;
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	if (dm_disk_find(index, name, &pos))
+		dm_disk_drop(index, pos);
+	else
+		dm_disk_unlink(index->folder, name);
+	pthread_mutex_unlock(&dm_disk.mutex);
+
+	module_log(LOG_WARNING, "removed corrupt cache file '%s'", path);
+}
+
+//cheap integrity check before a decode, the file has to be the size that
+//was downloaded.  sizes of adopted files are trusted.  a mismatch is checked
+//against the index on disk first, another process may have downloaded the
+//card again since this one recorded it.
+static bool dm_disk_check_size(const char *path, uint64_t size)
+{
+	size_t folder_len, pos, disk_pos;
+	bool valid = true;
+
+	if (!dm_disk.initialized)
+		return true;
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	bool found = dm_disk_find(index, name, &pos);
+	struct dm_disk_entry *entry = found ? &index->entries.array[pos] : NULL;
+	if (entry && entry->crc && entry->size != size) {
+		//read with the lock let go, then only applied if nothing recorded
+		//the card again meanwhile
+		struct dm_disk_index disk = { 0 };
+		uint64_t recorded = entry->size;
+		disk.folder = index->folder;
+		pthread_mutex_unlock(&dm_disk.mutex);
+		dm_disk_load(&disk);
+		pthread_mutex_lock(&dm_disk.mutex);
+
+		found = dm_disk_find(index, name, &pos);
+		entry = found ? &index->entries.array[pos] : NULL;
+		if (entry && entry->size == recorded && dm_disk_find(&disk, name, &disk_pos) &&
+		    disk.entries.array[disk_pos].size == size) {
+			index->bytes += size - entry->size;
+			entry->size = size;
+			entry->crc = disk.entries.array[disk_pos].crc;
+			entry->cx = disk.entries.array[disk_pos].cx;
+			entry->cy = disk.entries.array[disk_pos].cy;
+			index->dirty = true;
+		}
+		dm_disk_clear(&disk);
+	}
+	if (entry) {
+		if (entry->crc)
+			valid = entry->size == size;
+		else if (entry->size != size) {
+			index->bytes += size - entry->size;
+			entry->size = size;
+			index->dirty = true;
+		}
+	}
+	pthread_mutex_unlock(&dm_disk.mutex);
+	return valid;
+}
+
+//full check of a downloaded card against its crc, for the refresh button
+static bool dm_disk_verify(const char *path)
+{
+	size_t folder_len, pos;
+	uint32_t expected = 0;
+	uint64_t size = 0;
+
+	if (!dm_disk.initialized)
+		return true;
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	if (dm_disk_find(index, name, &pos)) {
+		expected = index->entries.array[pos].crc;
+		size = index->entries.array[pos].size;
+	}
+	pthread_mutex_unlock(&dm_disk.mutex);
+	if (!expected)
+		return true;
+
+	uint8_t buf[16384];
+	uint32_t crc = 0;
+	uint64_t total = 0;
+	FILE *fp = os_fopen(path, "rb");
+	if (!fp)
+		return false;
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		crc = calc_crc32(crc, buf, n);
+		total += n;
+	}
+	fclose(fp);
+	return crc == expected && total == size;
+}
+
+static bool dm_disk_get_size(const char *path, uint32_t *cx, uint32_t *cy)
+{
+	size_t folder_len, pos;
+	bool found = false;
+
+	if (!dm_disk.initialized)
+		return false;
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	if (dm_disk_find(index, name, &pos) && index->entries.array[pos].cx) {
+		*cx = index->entries.array[pos].cx;
+		*cy = index->entries.array[pos].cy;
+		found = true;
+	}
+	pthread_mutex_unlock(&dm_disk.mutex);
+	return found;
+}
+
+static void dm_disk_set_size(const char *path, uint32_t cx, uint32_t cy)
+{
+	size_t folder_len, pos;
+
+	if (!dm_disk.initialized)
+		return;
+
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	if (dm_disk_find(index, name, &pos)) {
+		index->entries.array[pos].cx = cx;
+		index->entries.array[pos].cy = cy;
+		index->dirty = true;
+	}
+	pthread_mutex_unlock(&dm_disk.mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* background tasks shared by all sources                                    */
+
+//file reads and parses kept off the video thread, one at a time in the
+//order they were queued
+static os_task_queue_t *dm_tasks;
+
+static void dm_tasks_init(void)
+{
+	dm_tasks = os_task_queue_create();
+	if (!dm_tasks)
+		module_log(LOG_WARNING, "failed to start the task queue, tasks run in place");
+}
+
+//runs what's queued before stopping
+static void dm_tasks_free(void)
+{
+	if (dm_tasks)
+		os_task_queue_destroy(dm_tasks);
+	dm_tasks = NULL;
+}
+
+static void dm_tasks_queue(os_task_t task, void *param)
+{
+	if (!dm_tasks || !os_task_queue_queue_task(dm_tasks, task, param))
+		task(param);
+}
+
+/* ------------------------------------------------------------------------- */
+/* image decoders shared by all sources                                      */
+
+//card art decoded for the composed views and downloads decoded and written
+//into the cache, spread over a few threads so the video thread only picks
+//up finished images.  one core is left for video
+#define DM_DECODERS_MAX 4
+
+static struct {
+	os_task_queue_t *queues[DM_DECODERS_MAX];
+#ifdef _WIN32
+	HRESULT com[DM_DECODERS_MAX];
+#endif
+	size_t count;
+	volatile long next;
+} dm_decoders;
+
+#ifdef _WIN32
+//WIC decodes downloads straight from memory on the decoder threads
+static void dm_decoders_com_init(void *param)
+{
+	HRESULT *com = param;
+	*com = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+}
+
+static void dm_decoders_com_free(void *param)
+{
+	HRESULT *com = param;
+	if (SUCCEEDED(*com))
+		CoUninitialize();
+	*com = E_FAIL;
+}
+#endif
+
+static void dm_decoders_init(void)
+{
+	int cores = os_get_logical_cores();
+	size_t count = cores > 2 ? (size_t)cores - 1 : 1;
+	if (count > DM_DECODERS_MAX)
+		count = DM_DECODERS_MAX;
+
+	for (size_t i = 0; i < count; i++) {
+		os_task_queue_t *queue = os_task_queue_create();
+		if (!queue)
+			break;
+#ifdef _WIN32
+		dm_decoders.com[i] = E_FAIL;
+		os_task_queue_queue_task(queue, dm_decoders_com_init, &dm_decoders.com[i]);
+#endif
+		dm_decoders.queues[dm_decoders.count++] = queue;
+	}
+	if (!dm_decoders.count)
+		module_log(LOG_WARNING, "failed to start the decoders, images decode in place");
+}
+
+//runs what's queued before stopping
+static void dm_decoders_free(void)
+{
+	for (size_t i = 0; i < dm_decoders.count; i++) {
+#ifdef _WIN32
+		os_task_queue_queue_task(dm_decoders.queues[i], dm_decoders_com_free, &dm_decoders.com[i]);
+#endif
+		os_task_queue_destroy(dm_decoders.queues[i]);
+		dm_decoders.queues[i] = NULL;
+	}
+	dm_decoders.count = 0;
+}
+
+//a committed download queues its write from a decoder, so everything queued
+//before this is done once every thread has been waited on twice
+static void dm_decoders_wait(void)
+{
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < dm_decoders.count; i++)
+			os_task_queue_wait(dm_decoders.queues[i]);
+	}
+}
+
+//round robin over the decoder threads
+static void dm_decoders_queue(os_task_t task, void *param)
+{
+	os_task_queue_t *queue = NULL;
+	if (dm_decoders.count)
+		queue = dm_decoders.queues[(size_t)os_atomic_inc_long(&dm_decoders.next) % dm_decoders.count];
+	if (!queue || !os_task_queue_queue_task(queue, task, param))
+		task(param);
+}
+
+/* ------------------------------------------------------------------------- */
+/* background download worker shared by all sources                          */
+
+//hard upper bound for the "Parallel Downloads" setting
+#define DM_FETCH_MAX_TRANSFERS 16
+#define DM_FETCH_DEFAULT_TRANSFERS 4
+//a lock older than this was left behind by a process that went away
+#define DM_FETCH_LOCK_STALE_S 60
+//how often a file locked by another process is checked on
+#define DM_FETCH_LOCK_RETRY_NS 250000000ULL
+//how often a download that is making progress refreshes its lock, well
+//inside the stale limit so a slow transfer isn't taken over
+#define DM_FETCH_LOCK_TOUCH_NS (10 * 1000000000ULL)
+
+struct dm_transfer {
+	CURL *curl;
+	struct curl_slist *headers;
+	struct dm_fetch_job job;
+	//the body is kept in memory and handed to the decoders once it checks
+	//out, which decodes it and writes it to <path>.<pid>.part to be renamed
+	//over the cache file, so the cache never holds a partial or error
+	//download.  one that grows past DM_FETCH_MAX_BODY goes to the part file
+	//as it arrives instead.
+	DARRAY(uint8_t) body;
+	struct dstr temp;
+	FILE *file;
+	uint32_t crc;
+	struct dstr etag;
+	struct dstr last_modified;
+	uint64_t bytes;
+	uint64_t lock_touched;
+	bool active;
+};
+
+static struct {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	os_event_t *event;
+	bool initialized;
+	volatile bool stop;
+	struct dm_fetch_job queue[DM_FETCH_QUEUE_SIZE];
+	size_t head;
+	size_t count;
+	volatile long max_transfers;
+	//bumped every time a job finishes, sources poll it from their tick
+	volatile long completed;
+	//paths queued or being fetched, a second request for one is dropped
+	DARRAY(char *) inflight;
+} dm_fetch;
+
+//a job waiting on a file another process is downloading
+struct dm_fetch_deferred {
+	struct dm_fetch_job job;
+	uint64_t retry;
+};
+
+static void dm_fetch_job_free(struct dm_fetch_job *job)
+{
+	bfree(job->url);
+	bfree(job->path);
+	job->url = NULL;
+	job->path = NULL;
+}
+
+static bool dm_fetch_pop(struct dm_fetch_job *job)
+{
+	bool popped = false;
+
+	pthread_mutex_lock(&dm_fetch.mutex);
+	if (dm_fetch.count) {
+		*job = dm_fetch.queue[dm_fetch.head];
+		dm_fetch.head = (dm_fetch.head + 1) % DM_FETCH_QUEUE_SIZE;
+		dm_fetch.count--;
+		popped = true;
+	}
+	pthread_mutex_unlock(&dm_fetch.mutex);
+
+	return popped;
+}
+
+//body bytes are only kept once we know the server sent an image, so a 304
+//keeps the cached file and error pages never land in the cache
+static size_t dm_transfer_write(void *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	struct dm_transfer *t = userdata;
+	size_t len = size * nmemb;
+
+	if (!t->bytes) {
+		long code = 0;
+		curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &code);
+		if (code != 200 && code != 201)
+			return len;
+	}
+
+	t->bytes += len;
+	t->crc = calc_crc32(t->crc, ptr, len);
+	uint64_t now = os_gettime_ns();
+	if (now - t->lock_touched >= DM_FETCH_LOCK_TOUCH_NS) {
+		t->lock_touched = now;
+		dm_fetch_touch(t->job.path);
+	}
+	if (!t->file && t->body.num + len <= DM_FETCH_MAX_BODY) {
+		da_push_back_array(t->body, (uint8_t *)ptr, len);
+		return len;
+	}
+
+	//too big to hold, what came so far goes to the part file with the rest
+	if (!t->file) {
+		t->file = os_fopen(t->temp.array, "wb");
+		if (!t->file || fwrite(t->body.array, 1, t->body.num, t->file) != t->body.num) {
+			module_log(LOG_WARNING, "failed to write '%s'", t->temp.array);
+			return 0;
+		}
+		da_free(t->body);
+	}
+	return callbackfunction(ptr, size, nmemb, t->file);
+}
+
+static size_t dm_transfer_header(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+	struct dm_transfer *t = userdata;
+	size_t len = size * nitems;
+	struct dstr *dst = NULL;
+	size_t skip = 0;
+
+	if (len > 5 && astrcmpi_n(buffer, "ETag:", 5) == 0) {
+		dst = &t->etag;
+		skip = 5;
+	} else if (len > 14 && astrcmpi_n(buffer, "Last-Modified:", 14) == 0) {
+		dst = &t->last_modified;
+		skip = 14;
+	}
+
+	if (dst) {
+		const char *value = buffer + skip;
+		size_t value_len = len - skip;
+		while (value_len && (*value == ' ' || *value == '\t')) {
+			value++;
+			value_len--;
+		}
+		while (value_len && (value[value_len - 1] == '\r' || value[value_len - 1] == '\n'))
+			value_len--;
+		dstr_ncopy(dst, value, value_len);
+	}
+
+	return len;
+}
+
+//validators for a cached image live next to it in <image>.etag
+static void dm_validators_path(struct dstr *out, const char *path)
+{
+	dstr_copy(out, path);
+	dstr_cat(out, ".etag");
+}
+
+static void dm_validators_read(const char *path, struct dstr *etag, struct dstr *last_modified)
+{
+	struct dstr sidecar = { 0 };
+	dm_validators_path(&sidecar, path);
+
+	char *text = os_quick_read_utf8_file(sidecar.array);
+	if (text) {
+		char *line = text;
+		while (line && *line) {
+			char *next = strchr(line, '\n');
+			if (next)
+				*(next++) = 0;
+			if (strncmp(line, "ETag: ", 6) == 0)
+				dstr_copy(etag, line + 6);
+			else if (strncmp(line, "Last-Modified: ", 15) == 0)
+				dstr_copy(last_modified, line + 15);
+			line = next;
+		}
+		bfree(text);
+	}
+
+	dstr_free(&sidecar);
+}
+
+static void dm_validators_write(const char *path, const struct dstr *etag, const struct dstr *last_modified)
+{
+	struct dstr sidecar = { 0 };
+	struct dstr text = { 0 };
+
+	dm_validators_path(&sidecar, path);
+	if (!dstr_is_empty(etag))
+		dstr_catf(&text, "ETag: %s\n", etag->array);
+	if (!dstr_is_empty(last_modified))
+		dstr_catf(&text, "Last-Modified: %s\n", last_modified->array);
+
+	if (!dstr_is_empty(&text))
+		os_quick_write_utf8_file(sidecar.array, text.array, text.len, false);
+	else
+		os_unlink(sidecar.array);
+
+	dstr_free(&text);
+	dstr_free(&sidecar);
+}
+
+//the job is finished one way or another, later requests for the path are fetched again
+static void dm_fetch_done(struct dm_fetch_job *job)
+{
+	pthread_mutex_lock(&dm_fetch.mutex);
+	for (size_t i = 0; i < dm_fetch.inflight.num; i++) {
+		if (strcmp(dm_fetch.inflight.array[i], job->path) == 0) {
+			bfree(dm_fetch.inflight.array[i]);
+			da_erase(dm_fetch.inflight, i);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&dm_fetch.mutex);
+
+	dm_fetch_job_free(job);
+	os_atomic_inc_long(&dm_fetch.completed);
+}
+
+static unsigned long dm_process_id(void)
+{
+#ifdef _WIN32
+	return (unsigned long)GetCurrentProcessId();
+#else
+	return (unsigned long)getpid();
+#endif
+}
+
+//each process downloads into its own temp file, so two sharing a cache
+//folder never write into or rename each other's partial body
+static void dm_fetch_part_path(struct dstr *part, const char *path, unsigned long pid)
+{
+	dstr_printf(part, "%s.%lu.part", path, pid);
+}
+
+static void dm_fetch_lock_path(struct dstr *lock, const char *path)
+{
+	dstr_copy(lock, path);
+	dstr_cat(lock, ".lock");
+}
+
+//the process id the lock file was written by, 0 if it can't be read
+static unsigned long dm_fetch_lock_owner(const char *lock)
+{
+	unsigned long pid = 0;
+	FILE *fp = os_fopen(lock, "rb");
+	if (fp) {
+		if (fscanf(fp, "%lu", &pid) != 1)
+			pid = 0;
+		fclose(fp);
+	}
+	return pid;
+}
+
+static bool dm_fetch_lock_write(const char *lock, const char *mode)
+{
+	FILE *fp = os_fopen(lock, mode);
+	if (!fp)
+		return false;
+	fprintf(fp, "%lu\n", dm_process_id());
+	return fclose(fp) == 0;
+}
+
+//advisory <path>.lock so OBS instances sharing a cache folder don't fetch
+//the same card at once.  created exclusively and holding the owner's process
+//id, a stale one is taken over along with the partial file it left.
+static bool dm_fetch_lock(const char *path)
+{
+	struct dstr lock = { 0 };
+	struct dstr part = { 0 };
+	struct stat st;
+	bool locked = false;
+
+	dm_fetch_lock_path(&lock, path);
+	for (int attempt = 0; attempt < 2 && !locked; attempt++) {
+		if (dm_fetch_lock_write(lock.array, "wx")) {
+			locked = true;
+		}
+		else if (os_stat(lock.array, &st) == 0 &&
+			 time(NULL) - st.st_mtime > DM_FETCH_LOCK_STALE_S) {
+			unsigned long owner = dm_fetch_lock_owner(lock.array);
+			if (owner && owner != dm_process_id()) {
+				dm_fetch_part_path(&part, path, owner);
+				os_unlink(part.array);
+			}
+			os_unlink(lock.array);
+		}
+		else {
+			break;
+		}
+	}
+
+	dstr_free(&part);
+	dstr_free(&lock);
+	return locked;
+}
+
+//keeps a lock this process holds from going stale while its download runs
+static void dm_fetch_touch(const char *path)
+{
+	struct dstr lock = { 0 };
+	dm_fetch_lock_path(&lock, path);
+	if (dm_fetch_lock_owner(lock.array) == dm_process_id())
+		dm_fetch_lock_write(lock.array, "wb");
+	dstr_free(&lock);
+}
+
+//only removes the lock if it's still this process's, another may have
+//taken it over
+static void dm_fetch_unlock(const char *path)
+{
+	struct dstr lock = { 0 };
+	dm_fetch_lock_path(&lock, path);
+	if (dm_fetch_lock_owner(lock.array) == dm_process_id())
+		os_unlink(lock.array);
+	dstr_free(&lock);
+}
+
+//the server can answer 200 with an error page or drop the connection
+//mid-body, only a complete image is allowed into the cache
+static bool dm_transfer_valid(struct dm_transfer *t)
+{
+	static const uint8_t png_sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	curl_off_t length = -1;
+	uint8_t magic[8];
+	bool valid = false;
+
+	curl_easy_getinfo(t->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+	if (t->bytes < sizeof(magic) || (length >= 0 && (uint64_t)length != t->bytes))
+		return false;
+
+	if (t->body.num >= sizeof(magic)) {
+		memcpy(magic, t->body.array, sizeof(magic));
+	}
+	else {
+		FILE *fp = os_fopen(t->temp.array, "rb");
+		if (!fp)
+			return false;
+		bool read = fread(magic, 1, sizeof(magic), fp) == sizeof(magic);
+		fclose(fp);
+		if (!read)
+			return false;
+	}
+	valid = (magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF) ||
+		memcmp(magic, png_sig, sizeof(png_sig)) == 0;
+	return valid;
+}
+
+//a download that checked out, on its way into the cache
+struct dm_fetch_commit {
+	struct dm_fetch_job job;
+	DARRAY(uint8_t) body;
+	//the body is already in the part file, it was too big to keep in memory
+	bool spilled;
+	struct dstr temp;
+	struct dstr etag;
+	struct dstr last_modified;
+	uint32_t crc;
+	uint64_t bytes;
+	//decoded from memory and in the image cache ahead of the file
+	bool published;
+	uint64_t start;
+};
+
+//writes the download into the cache folder.  a failed write only costs the
+//file, a body that was already decoded stays in the image cache until the
+//missing file is noticed.  the file's lock and in flight entry are held
+//until now, so sources only hear the job is done once they can find it.
+static void dm_fetch_write(void *param)
+{
+	struct dm_fetch_commit *c = param;
+	bool written = c->spilled;
+	bool committed = false;
+
+	if (!c->spilled) {
+		FILE *fp = os_fopen(c->temp.array, "wb");
+		written = fp && fwrite(c->body.array, 1, c->body.num, fp) == c->body.num;
+		if (fp && fclose(fp) != 0)
+			written = false;
+		if (!written)
+			module_log(LOG_WARNING, "failed to write '%s'", c->temp.array);
+	}
+	if (written && os_rename(c->temp.array, c->job.path) != 0)
+		module_log(LOG_WARNING, "failed to move download into '%s'", c->job.path);
+	else if (written)
+		committed = true;
+
+	if (committed) {
+		dm_validators_write(c->job.path, &c->etag, &c->last_modified);
+		dm_disk_record(c->job.path, c->bytes, c->crc);
+		if (c->published)
+			dm_images_stamp(c->job.path);
+		else
+			dm_images_publish(c->job.path, NULL, GS_UNKNOWN, 0, 0, c->start);
+	}
+	else {
+		os_unlink(c->temp.array);
+	}
+
+	dm_fetch_unlock(c->job.path);
+	dm_fetch_done(&c->job);
+	da_free(c->body);
+	dstr_free(&c->temp);
+	dstr_free(&c->etag);
+	dstr_free(&c->last_modified);
+	bfree(c);
+}
+
+//decodes the download straight from memory where that's possible and puts
+//it in the image cache before queueing the write, so the pixels don't wait
+//on the disk.  runs on a decoder thread.
+static void dm_fetch_commit(void *param)
+{
+	struct dm_fetch_commit *c = param;
+	enum gs_color_format format = GS_UNKNOWN;
+	uint32_t cx = 0, cy = 0;
+
+	c->start = os_gettime_ns();
+	//a spilled body is decoded from the file once it's in place
+	uint8_t *pixels = c->spilled ? NULL :
+		dm_decode_memory(c->body.array, c->body.num, &format, &cx, &cy);
+	if (pixels)
+		c->published = dm_images_publish(c->job.path, pixels, format, cx, cy, c->start);
+	dm_decoders_queue(dm_fetch_write, c);
+}
+
+//hands the transfer's job and body to the decoders, the worker carries on
+//with the next download
+static void dm_fetch_commit_queue(struct dm_transfer *t)
+{
+	struct dm_fetch_commit *c = bzalloc(sizeof(struct dm_fetch_commit));
+	c->job = t->job;
+	memset(&t->job, 0, sizeof(t->job));
+	c->body.da = t->body.da;
+	da_init(t->body);
+	c->spilled = t->file != NULL;
+	dstr_copy(&c->temp, t->temp.array);
+	dstr_copy(&c->etag, t->etag.array);
+	dstr_copy(&c->last_modified, t->last_modified.array);
+	c->crc = t->crc;
+	c->bytes = t->bytes;
+	dm_decoders_queue(dm_fetch_commit, c);
+}
+
+static void dm_transfer_start(struct dm_transfer *t, CURLM *multi, struct dm_fetch_job *job)
+{
+	t->job = *job;
+	t->file = NULL;
+	da_resize(t->body, 0);
+	t->bytes = 0;
+	t->crc = 0;
+	t->lock_touched = os_gettime_ns();
+	dm_fetch_part_path(&t->temp, t->job.path, dm_process_id());
+	dstr_copy(&t->etag, "");
+	dstr_copy(&t->last_modified, "");
+
+	//handles are reused so curl keeps their connections alive
+	curl_easy_setopt(t->curl, CURLOPT_URL, t->job.url);
+	curl_easy_setopt(t->curl, CURLOPT_PRIVATE, t);
+
+	if (t->headers) {
+		curl_slist_free_all(t->headers);
+		t->headers = NULL;
+	}
+	if (t->job.revalidate) {
+		struct dstr etag = { 0 };
+		struct dstr last_modified = { 0 };
+		struct dstr header = { 0 };
+
+		dm_validators_read(t->job.path, &etag, &last_modified);
+		if (!dstr_is_empty(&etag)) {
+			dstr_printf(&header, "If-None-Match: %s", etag.array);
+			t->headers = curl_slist_append(t->headers, header.array);
+		}
+		if (!dstr_is_empty(&last_modified)) {
+			dstr_printf(&header, "If-Modified-Since: %s", last_modified.array);
+			t->headers = curl_slist_append(t->headers, header.array);
+		}
+
+		dstr_free(&header);
+		dstr_free(&last_modified);
+		dstr_free(&etag);
+	}
+	curl_easy_setopt(t->curl, CURLOPT_HTTPHEADER, t->headers);
+
+	curl_multi_add_handle(multi, t->curl);
+	t->active = true;
+}
+
+//returns the number of body bytes received for a download that checked out
+static uint64_t dm_transfer_finish(struct dm_transfer *t, CURLM *multi, CURLcode rc)
+{
+	long code = 0;
+	curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &code);
+	curl_multi_remove_handle(multi, t->curl);
+
+	bool written = !t->file || fclose(t->file) == 0;
+	bool queued = false;
+
+	if (rc != CURLE_OK) {
+		module_log(LOG_WARNING, "failed to fetch '%s': %s", t->job.url, curl_easy_strerror(rc));
+	} else if (code == 304) {
+		module_log(LOG_DEBUG, "'%s' not modified", t->job.url);
+	} else if ((code == 200 || code == 201) && t->bytes) {
+		if (!written || !dm_transfer_valid(t)) {
+			module_log(LOG_WARNING, "discarding incomplete download of '%s'", t->job.url);
+		}
+		else {
+			dm_fetch_commit_queue(t);
+			queued = true;
+		}
+	} else {
+		module_log(LOG_WARNING, "failed to fetch '%s': response code %ld", t->job.url, code);
+	}
+	if (t->file && !queued)
+		os_unlink(t->temp.array);
+
+	uint64_t bytes = queued ? t->bytes : 0;
+	t->file = NULL;
+	//big bodies aren't worth keeping around for the next transfer
+	if (t->body.capacity > 1024 * 1024)
+		da_free(t->body);
+	t->active = false;
+	if (!queued) {
+		dm_fetch_unlock(t->job.path);
+		dm_fetch_done(&t->job);
+	}
+	return bytes;
+}
+
+//starts the job if this process holds the file's lock, otherwise parks it
+//until the other process is done with it
+static bool dm_fetch_begin(struct dm_transfer *t, CURLM *multi, struct dm_fetch_job *job)
+{
+	//another source or process may have fetched the file already
+	if (!job->revalidate && os_file_exists(job->path)) {
+		dm_fetch_done(job);
+		return true;
+	}
+	if (!dm_fetch_lock(job->path))
+		return false;
+	//it may have landed between the check and the lock
+	if (!job->revalidate && os_file_exists(job->path)) {
+		dm_fetch_unlock(job->path);
+		dm_fetch_done(job);
+		return true;
+	}
+
+	dm_transfer_start(t, multi, job);
+	return true;
+}
+
+static void *dm_fetch_thread(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	os_set_thread_name("dm_source: fetch");
+
+	struct dm_transfer transfers[DM_FETCH_MAX_TRANSFERS] = { 0 };
+	CURLM *multi = curl_multi_init();
+	CURLSH *share = curl_share_init();
+	int active = 0;
+
+	//only this thread touches the handles, so the share needs no lock callbacks
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+	for (size_t i = 0; i < DM_FETCH_MAX_TRANSFERS; i++) {
+		CURL *curl = curl_easy_init();
+		curl_easy_setopt(curl, CURLOPT_SHARE, share);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, dm_transfer_write);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfers[i]);
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, dm_transfer_header);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfers[i]);
+		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+		curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+		transfers[i].curl = curl;
+	}
+
+	DARRAY(struct dm_fetch_deferred) deferred;
+	da_init(deferred);
+
+	//per batch totals, logged whenever the worker goes idle
+	uint64_t batch_start = 0;
+	uint64_t batch_bytes = 0;
+	long batch_files = 0;
+
+	while (!os_atomic_load_bool(&dm_fetch.stop)) {
+		long limit = os_atomic_load_long(&dm_fetch.max_transfers);
+		if (limit < 1)
+			limit = 1;
+		if (limit > DM_FETCH_MAX_TRANSFERS)
+			limit = DM_FETCH_MAX_TRANSFERS;
+		curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, limit);
+
+		uint64_t now = os_gettime_ns();
+		size_t next_deferred = 0;
+		for (long i = 0; i < DM_FETCH_MAX_TRANSFERS && active < limit; i++) {
+			struct dm_fetch_job job;
+			bool retry = false;
+			if (transfers[i].active)
+				continue;
+
+			//jobs waiting on another process go first once they're due
+			while (next_deferred < deferred.num && deferred.array[next_deferred].retry > now)
+				next_deferred++;
+			if (next_deferred < deferred.num) {
+				job = deferred.array[next_deferred].job;
+				da_erase(deferred, next_deferred);
+				retry = true;
+			}
+			else if (!dm_fetch_pop(&job)) {
+				break;
+			}
+
+			if (!dm_fetch_begin(&transfers[i], multi, &job)) {
+				struct dm_fetch_deferred *wait = da_push_back_new(deferred);
+				if (!retry)
+					module_log(LOG_DEBUG, "'%s' is being fetched by another process", job.path);
+				wait->job = job;
+				wait->retry = now + DM_FETCH_LOCK_RETRY_NS;
+				//the slot stays free for the next job
+				i--;
+				continue;
+			}
+			if (!transfers[i].active) {
+				i--;
+				continue;
+			}
+
+			if (!batch_files)
+				batch_start = os_gettime_ns();
+			batch_files++;
+			active++;
+		}
+
+		if (!active) {
+			if (batch_files) {
+				module_log(LOG_INFO, "fetched %ld files (%llu bytes) in %llu ms",
+						batch_files, (unsigned long long)batch_bytes,
+						(unsigned long long)(os_gettime_ns() - batch_start) / 1000000);
+				batch_files = 0;
+				batch_bytes = 0;
+				dm_disk_flush();
+			}
+			if (deferred.num)
+				os_event_timedwait(dm_fetch.event, (unsigned long)(DM_FETCH_LOCK_RETRY_NS / 1000000));
+			else
+				os_event_wait(dm_fetch.event);
+			continue;
+		}
+
+		int running = 0;
+		curl_multi_perform(multi, &running);
+
+		CURLMsg *msg;
+		int remaining;
+		while ((msg = curl_multi_info_read(multi, &remaining))) {
+			struct dm_transfer *t = NULL;
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+			batch_bytes += dm_transfer_finish(t, multi, msg->data.result);
+			active--;
+		}
+
+		//wakes on socket activity, or periodically to pick up new jobs
+		if (active)
+			curl_multi_wait(multi, NULL, 0, 50, NULL);
+	}
+
+	for (size_t i = 0; i < DM_FETCH_MAX_TRANSFERS; i++) {
+		struct dm_transfer *t = &transfers[i];
+		if (t->active) {
+			curl_multi_remove_handle(multi, t->curl);
+			if (t->file) {
+				fclose(t->file);
+				os_unlink(t->temp.array);
+			}
+			dm_fetch_unlock(t->job.path);
+			dm_fetch_job_free(&t->job);
+		}
+		curl_slist_free_all(t->headers);
+		curl_easy_cleanup(t->curl);
+		da_free(t->body);
+		dstr_free(&t->temp);
+		dstr_free(&t->etag);
+		dstr_free(&t->last_modified);
+	}
+	for (size_t i = 0; i < deferred.num; i++)
+		dm_fetch_job_free(&deferred.array[i].job);
+	da_free(deferred);
+	curl_multi_cleanup(multi);
+	curl_share_cleanup(share);
+
+	return NULL;
+}
+
+static void dm_fetch_init(void)
+{
+	if (dm_fetch.initialized)
+		return;
+	if (pthread_mutex_init(&dm_fetch.mutex, NULL) != 0)
+		return;
+	if (os_event_init(&dm_fetch.event, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&dm_fetch.mutex);
+		return;
+	}
+	dm_fetch.stop = false;
+	dm_fetch.max_transfers = DM_FETCH_DEFAULT_TRANSFERS;
+	if (pthread_create(&dm_fetch.thread, NULL, dm_fetch_thread, NULL) != 0) {
+		os_event_destroy(dm_fetch.event);
+		pthread_mutex_destroy(&dm_fetch.mutex);
+		return;
+	}
+	dm_fetch.initialized = true;
+}
+
+static void dm_fetch_free(void)
+{
+	if (!dm_fetch.initialized)
+		return;
+
+	os_atomic_set_bool(&dm_fetch.stop, true);
+	os_event_signal(dm_fetch.event);
+	pthread_join(dm_fetch.thread, NULL);
+	//downloads still being committed finish with the in flight list
+	dm_decoders_wait();
+
+	for (size_t i = 0; i < dm_fetch.count; i++)
+		dm_fetch_job_free(&dm_fetch.queue[(dm_fetch.head + i) % DM_FETCH_QUEUE_SIZE]);
+	dm_fetch.count = 0;
+	for (size_t i = 0; i < dm_fetch.inflight.num; i++)
+		bfree(dm_fetch.inflight.array[i]);
+	da_free(dm_fetch.inflight);
+
+	os_event_destroy(dm_fetch.event);
+	pthread_mutex_destroy(&dm_fetch.mutex);
+	dm_fetch.initialized = false;
+}
+
+//the cap is shared by every source, the last one updated wins
+static void dm_fetch_set_max_transfers(long max_transfers)
+{
+	os_atomic_set_long(&dm_fetch.max_transfers, max_transfers);
+}
+
+//hands the job to the worker, which takes ownership of it.  returns false
+//when the queue is full so the caller can try again on a later tick.
+static bool dm_fetch_push(struct dm_fetch_job *job)
+{
+	bool queued = false;
+
+	if (!dm_fetch.initialized)
+		return false;
+
+	bool duplicate = false;
+	pthread_mutex_lock(&dm_fetch.mutex);
+	for (size_t i = 0; i < dm_fetch.inflight.num && !duplicate; i++)
+		duplicate = strcmp(dm_fetch.inflight.array[i], job->path) == 0;
+	if (!duplicate && dm_fetch.count < DM_FETCH_QUEUE_SIZE) {
+		size_t tail = (dm_fetch.head + dm_fetch.count) % DM_FETCH_QUEUE_SIZE;
+		char *path = bstrdup(job->path);
+		da_push_back(dm_fetch.inflight, &path);
+		dm_fetch.queue[tail] = *job;
+		dm_fetch.count++;
+		queued = true;
+	}
+	pthread_mutex_unlock(&dm_fetch.mutex);
+
+	//already on its way, the caller sees it land like any other download
+	if (duplicate) {
+		dm_fetch_job_free(job);
+		return true;
+	}
+	if (queued) {
+		job->url = NULL;
+		job->path = NULL;
+		os_event_signal(dm_fetch.event);
+	}
+	return queued;
+}
+
+static inline long dm_fetch_generation(void)
+{
+	return os_atomic_load_long(&dm_fetch.completed);
+}
+
+//queues a download for the source, parking it on the source if the worker is busy
+static void dm_source_request(struct dm_source *context, const char *url, const char *path, bool revalidate)
+{
+	struct dm_fetch_job job;
+	job.url = bstrdup(url);
+	job.path = bstrdup(path);
+	job.revalidate = revalidate;
+
+	//refreshes of cached files would count the old file as downloaded
+	bool tracked = revalidate;
+	for (size_t i = 0; !tracked && i < context->fetching.num; i++)
+		tracked = strcmp(context->fetching.array[i], path) == 0;
+	if (!tracked) {
+		char *copy = bstrdup(path);
+		da_push_back(context->fetching, &copy);
+	}
+
+	if (!dm_fetch_push(&job))
+		da_push_back(context->pending, &job);
+}
+
+static void dm_source_flush_pending(struct dm_source *context)
+{
+	size_t sent = 0;
+	while (sent < context->pending.num && dm_fetch_push(&context->pending.array[sent]))
+		sent++;
+	if (sent)
+		da_erase_range(context->pending, 0, sent);
+}
+
+static void dm_source_clear_pending(struct dm_source *context)
+{
+	for (size_t i = 0; i < context->pending.num; i++)
+		dm_fetch_job_free(&context->pending.array[i]);
+	da_resize(context->pending, 0);
+}
+
+static size_t dm_source_count_missing(struct dm_source *context)
+{
+	size_t missing = 0;
+	for (size_t i = 0; i < context->files.num; i++) {
+		if (!dm_disk_exists(context->files.array[i]))
+			missing++;
+	}
+	return missing;
+}
+
+/* ------------------------------------------------------------------------- */
+/* graphics accounting                                                       */
+
+//every decode, upload, copy and graphics lock the plugin does goes through
+//these so an operation's cost can be logged as counts and not only time
+static struct {
+	volatile long decodes;
+	//the decodes that came straight from a download's body
+	volatile long memory_decodes;
+	volatile long textures;
+	volatile long copies;
+	//in bytes, wraps around but the differences the logs use stay right
+	volatile long upload_bytes;
+	volatile long locks;
+} dm_gfx;
+
+struct dm_gfx_counts {
+	uint64_t time;
+	long decodes;
+	long textures;
+	long copies;
+	long upload_bytes;
+	long locks;
+};
+
+static inline void dm_enter_graphics(void)
+{
+	os_atomic_inc_long(&dm_gfx.locks);
+	obs_enter_graphics();
+}
+
+static inline void dm_leave_graphics(void)
+{
+	obs_leave_graphics();
+}
+
+static uint8_t *dm_decode_file(const char *path, enum gs_color_format *format, uint32_t *cx, uint32_t *cy)
+{
+	uint8_t *pixels = gs_create_texture_file_data(path, format, cx, cy);
+	if (pixels)
+		os_atomic_inc_long(&dm_gfx.decodes);
+	return pixels;
+}
+
+#ifdef _WIN32
+//decodes a jpeg or png that's still in memory with WIC, the calling thread
+//needs COM initialized
+static uint8_t *dm_decode_memory(const uint8_t *data, size_t size, enum gs_color_format *format,
+		uint32_t *cx, uint32_t *cy)
+{
+	IWICImagingFactory *factory = NULL;
+	IWICStream *stream = NULL;
+	IWICBitmapDecoder *decoder = NULL;
+	IWICBitmapFrameDecode *frame = NULL;
+	IWICFormatConverter *converter = NULL;
+	uint8_t *pixels = NULL;
+	UINT width = 0, height = 0;
+
+	if (!data || !size || size > MAXDWORD)
+		return NULL;
+
+	HRESULT hr = CoCreateInstance(&CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER,
+			&IID_IWICImagingFactory, (void **)&factory);
+	if (SUCCEEDED(hr))
+		hr = IWICImagingFactory_CreateStream(factory, &stream);
+	if (SUCCEEDED(hr))
+		hr = IWICStream_InitializeFromMemory(stream, (BYTE *)data, (DWORD)size);
+	if (SUCCEEDED(hr))
+		hr = IWICImagingFactory_CreateDecoderFromStream(factory, (IStream *)stream, NULL,
+				WICDecodeMetadataCacheOnDemand, &decoder);
+	if (SUCCEEDED(hr))
+		hr = IWICBitmapDecoder_GetFrame(decoder, 0, &frame);
+	if (SUCCEEDED(hr))
+		hr = IWICImagingFactory_CreateFormatConverter(factory, &converter);
+	if (SUCCEEDED(hr))
+		hr = IWICFormatConverter_Initialize(converter, (IWICBitmapSource *)frame,
+				&GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, NULL, 0.0,
+				WICBitmapPaletteTypeCustom);
+	if (SUCCEEDED(hr))
+		hr = IWICFormatConverter_GetSize(converter, &width, &height);
+	if (SUCCEEDED(hr) && width && height) {
+		pixels = bmalloc((size_t)width * height * 4);
+		hr = IWICFormatConverter_CopyPixels(converter, NULL, width * 4, width * height * 4, pixels);
+	}
+
+	if (converter)
+		IWICFormatConverter_Release(converter);
+	if (frame)
+		IWICBitmapFrameDecode_Release(frame);
+	if (decoder)
+		IWICBitmapDecoder_Release(decoder);
+	if (stream)
+		IWICStream_Release(stream);
+	if (factory)
+		IWICImagingFactory_Release(factory);
+
+	if (FAILED(hr) || !pixels) {
+		bfree(pixels);
+		return NULL;
+	}
+	*format = GS_BGRA;
+	*cx = width;
+	*cy = height;
+	os_atomic_inc_long(&dm_gfx.decodes);
+	os_atomic_inc_long(&dm_gfx.memory_decodes);
+	return pixels;
+}
+#elif defined(DM_HAVE_LIBJPEG)
+struct dm_jpeg_error {
+	struct jpeg_error_mgr mgr;
+	jmp_buf jump;
+};
+
+static void dm_jpeg_fail(j_common_ptr cinfo)
+{
+	struct dm_jpeg_error *err = (struct dm_jpeg_error *)cinfo->err;
+	longjmp(err->jump, 1);
+}
+
+static void dm_jpeg_quiet(j_common_ptr cinfo)
+{
+	UNUSED_PARAMETER(cinfo);
+}
+
+//decodes a jpeg that's still in memory with libjpeg, pngs and anything
+//libjpeg gives up on fall back to dm_decode_file
+static uint8_t *dm_decode_memory(const uint8_t *data, size_t size, enum gs_color_format *format,
+		uint32_t *cx, uint32_t *cy)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct dm_jpeg_error err;
+	uint8_t *volatile pixels = NULL;
+	uint8_t *volatile row = NULL;
+
+	if (!data || size < 3 || data[0] != 0xFF || data[1] != 0xD8 || data[2] != 0xFF ||
+	    size > ULONG_MAX)
+		return NULL;
+
+	cinfo.err = jpeg_std_error(&err.mgr);
+	err.mgr.error_exit = dm_jpeg_fail;
+	err.mgr.output_message = dm_jpeg_quiet;
+	if (setjmp(err.jump)) {
+		jpeg_destroy_decompress(&cinfo);
+		bfree(pixels);
+		bfree(row);
+		return NULL;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char *)data, (unsigned long)size);
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&cinfo);
+	if (!cinfo.output_width || !cinfo.output_height)
+		longjmp(err.jump, 1);
+
+	uint32_t width = cinfo.output_width;
+	pixels = bmalloc((size_t)width * cinfo.output_height * 4);
+	row = bmalloc((size_t)width * 3);
+	while (cinfo.output_scanline < cinfo.output_height) {
+		uint8_t *out = pixels + (size_t)cinfo.output_scanline * width * 4;
+		JSAMPROW rows[1] = { row };
+		jpeg_read_scanlines(&cinfo, rows, 1);
+		for (uint32_t x = 0; x < width; x++) {
+			out[x * 4 + 0] = row[x * 3 + 0];
+			out[x * 4 + 1] = row[x * 3 + 1];
+			out[x * 4 + 2] = row[x * 3 + 2];
+			out[x * 4 + 3] = 255;
+		}
+	}
+
+	*format = GS_RGBA;
+	*cx = width;
+	*cy = cinfo.output_height;
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	bfree(row);
+	os_atomic_inc_long(&dm_gfx.decodes);
+	os_atomic_inc_long(&dm_gfx.memory_decodes);
+	return pixels;
+}
+#else
+//no decoder for memory here, callers fall back to dm_decode_file
+static uint8_t *dm_decode_memory(const uint8_t *data, size_t size, enum gs_color_format *format,
+		uint32_t *cx, uint32_t *cy)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(size);
+	UNUSED_PARAMETER(format);
+	UNUSED_PARAMETER(cx);
+	UNUSED_PARAMETER(cy);
+	return NULL;
+}
+#endif
+
+static void dm_gfx_add_upload(size_t bytes)
+{
+	long old;
+	do {
+		old = os_atomic_load_long(&dm_gfx.upload_bytes);
+	} while (!os_atomic_compare_swap_long(&dm_gfx.upload_bytes, old,
+			(long)((unsigned long)old + (unsigned long)bytes)));
+}
+
+static gs_texture_t *dm_texture_create(uint32_t cx, uint32_t cy, enum gs_color_format format, const uint8_t *data)
+{
+	os_atomic_inc_long(&dm_gfx.textures);
+	if (data)
+		dm_gfx_add_upload((size_t)cx * cy * gs_get_format_bpp(format) / 8);
+	return gs_texture_create(cx, cy, format, 1, data ? &data : NULL, 0);
+}
+
+static gs_texture_t *dm_texture_create_gdi(uint32_t cx, uint32_t cy)
+{
+	os_atomic_inc_long(&dm_gfx.textures);
+	return gs_texture_create_gdi(cx, cy);
+}
+
+static inline void dm_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+	gs_texture_t *src, uint32_t src_x, uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	os_atomic_inc_long(&dm_gfx.copies);
+	gs_copy_texture_region(dst, dst_x, dst_y, src, src_x, src_y, src_w, src_h);
+}
+
+static void dm_gfx_snapshot(struct dm_gfx_counts *counts)
+{
+	counts->time = os_gettime_ns();
+	counts->decodes = os_atomic_load_long(&dm_gfx.decodes);
+	counts->textures = os_atomic_load_long(&dm_gfx.textures);
+	counts->copies = os_atomic_load_long(&dm_gfx.copies);
+	counts->upload_bytes = os_atomic_load_long(&dm_gfx.upload_bytes);
+	counts->locks = os_atomic_load_long(&dm_gfx.locks);
+}
+
+//logs what an operation cost since the snapshot, if it did any graphics work.
+//the counters are shared so sources working at the same time blur together.
+static void dm_gfx_log(struct dm_source *context, const char *op, const struct dm_gfx_counts *start)
+{
+	struct dm_gfx_counts now;
+	dm_gfx_snapshot(&now);
+	if (now.decodes == start->decodes && now.textures == start->textures &&
+	    now.copies == start->copies && now.locks == start->locks)
+		return;
+
+	debug("%s: %llu us, %ld decodes, %ld textures, %ld copies, %.1f KB uploaded, %ld graphics locks",
+		op,
+		(unsigned long long)((now.time - start->time) / 1000),
+		now.decodes - start->decodes, now.textures - start->textures,
+		now.copies - start->copies,
+		(double)((unsigned long)now.upload_bytes - (unsigned long)start->upload_bytes) / 1024.0,
+		now.locks - start->locks);
+}
+
+/* ------------------------------------------------------------------------- */
+/* dice count glyphs                                                         */
+
+/*
+ * The dice count under each card is drawn from a small built-in 5x7 font
+ * instead of a downloaded Dice<N>.jpg.  Strips are named by a key in place
+ * of a file path, "glyphs:dice/<count>/<height>/<color>/<background>/<bold>",
+ * so the image cache renders each distinct one once and every card and
+ * source with the same count shares it, without touching the network, the
+ * disk or the decoder.
+ */
+
+#define DM_GLYPH_PREFIX "glyphs:"
+#define DM_GLYPH_CX 5
+#define DM_GLYPH_CY 7
+//one blank column between glyphs, which the bold face grows into
+#define DM_GLYPH_ADVANCE (DM_GLYPH_CX + 1)
+
+#define DM_DICE_DEFAULT_HEIGHT DM_PLACEHOLDER_DICE_CY
+#define DM_DICE_DEFAULT_COLOR 0xFFFFFFFF
+#define DM_DICE_DEFAULT_BACKGROUND 0xFF000000
+
+static const char dm_glyph_chars[] = "0123456789CDEI: ";
+
+//rows top to bottom, the high bit of the low five is the leftmost column
+static const uint8_t dm_glyph_rows[][DM_GLYPH_CY] = {
+	{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },
+	{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },
+	{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },
+	{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },
+	{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },
+	{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },
+	{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },
+	{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },
+	{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },
+	{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },
+	{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },
+	{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },
+	{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },
+	{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },
+	{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+};
+
+#define DM_GLYPH_COUNT (sizeof(dm_glyph_rows) / sizeof(dm_glyph_rows[0]))
+
+//coverage of every glyph in the regular and bold faces, expanded from the
+//rows once so drawing a strip is only lookups
+static struct {
+	pthread_once_t once;
+	uint8_t cells[2][DM_GLYPH_COUNT][DM_GLYPH_CY][DM_GLYPH_ADVANCE];
+} dm_glyphs = { PTHREAD_ONCE_INIT };
+
+static void dm_glyphs_build(void)
+{
+	for (size_t g = 0; g < DM_GLYPH_COUNT; g++) {
+		for (int y = 0; y < DM_GLYPH_CY; y++) {
+			for (int x = 0; x < DM_GLYPH_CX; x++) {
+				if (!(dm_glyph_rows[g][y] & (0x10 >> x)))
+					continue;
+				dm_glyphs.cells[0][g][y][x] = 1;
+				dm_glyphs.cells[1][g][y][x] = 1;
+				dm_glyphs.cells[1][g][y][x + 1] = 1;
+			}
+		}
+	}
+}
+
+static inline bool dm_is_glyph_strip(const char *path)
+{
+	return path && strncmp(path, DM_GLYPH_PREFIX, sizeof(DM_GLYPH_PREFIX) - 1) == 0;
+}
+
+static void dm_dice_strip_key(struct dstr *key, uint32_t dice, uint32_t height,
+		uint32_t color, uint32_t background, bool bold)
+{
+	dstr_printf(key, DM_GLYPH_PREFIX "dice/%u/%u/%08x/%08x/%d",
+			dice, height, color, background, bold ? 1 : 0);
+}
+
+static bool dm_dice_strip_parse(const char *key, uint32_t *dice, uint32_t *height,
+		uint32_t *color, uint32_t *background, bool *bold)
+{
+	int b = 0;
+	if (!dm_is_glyph_strip(key) ||
+	    sscanf(key + sizeof(DM_GLYPH_PREFIX) - 1, "dice/%u/%u/%x/%x/%d",
+			    dice, height, color, background, &b) != 5 || !*height)
+		return false;
+	*bold = b != 0;
+	return true;
+}
+
+//widest label, "DICE: 255", in glyph columns
+#define DM_DICE_LABEL_CX ((uint32_t)(sizeof("DICE: 255") - 1) * DM_GLYPH_ADVANCE - 1)
+
+//glyphs fill three quarters of the strip height, at the largest whole scale
+//whose widest label still fits under a card.  the strip is that label plus a
+//glyph pixel either side, so every count at one height is the same size
+static void dm_dice_strip_metrics(uint32_t height, uint32_t *scale, uint32_t *width)
+{
+	uint32_t s = height * 3 / 4 / DM_GLYPH_CY;
+	if (s > (DM_PLACEHOLDER_CX - 2) / (DM_DICE_LABEL_CX + 2))
+		s = (DM_PLACEHOLDER_CX - 2) / (DM_DICE_LABEL_CX + 2);
+	if (s < 1)
+		s = 1;
+	*scale = s;
+	*width = (DM_DICE_LABEL_CX + 2) * s;
+}
+
+static bool dm_dice_strip_size(const char *key, uint32_t *cx, uint32_t *cy)
+{
+	uint32_t dice, height, color, background, scale;
+	bool bold;
+	if (!dm_dice_strip_parse(key, &dice, &height, &color, &background, &bold))
+		return false;
+	dm_dice_strip_metrics(height, &scale, cx);
+	*cy = height;
+	return true;
+}
+
+static inline void dm_color_rgba(uint32_t color, uint8_t *out)
+{
+	//obs colour settings are 0xAABBGGRR, which is rgba in memory order
+	out[0] = color & 0xFF;
+	out[1] = (color >> 8) & 0xFF;
+	out[2] = (color >> 16) & 0xFF;
+	out[3] = (color >> 24) & 0xFF;
+}
+
+//draws "DICE: <n>" centred on the background, returns rgba pixels or NULL if the key isn't a dice strip
+static uint8_t *dm_dice_strip_render(const char *key, uint32_t *cx, uint32_t *cy)
+{
+	uint32_t dice, height, color, background;
+	bool bold;
+	if (!dm_dice_strip_parse(key, &dice, &height, &color, &background, &bold))
+		return NULL;
+
+	pthread_once(&dm_glyphs.once, dm_glyphs_build);
+
+	char text[16];
+	snprintf(text, sizeof(text), "DICE: %u", dice);
+	size_t len = strlen(text);
+
+	uint32_t width, scale;
+	uint32_t textwidth = (uint32_t)len * DM_GLYPH_ADVANCE - 1;
+	dm_dice_strip_metrics(height, &scale, &width);
+
+	uint8_t fg[4], bg[4];
+	dm_color_rgba(color, fg);
+	dm_color_rgba(background, bg);
+
+	uint8_t *pixels = bmalloc((size_t)width * height * 4);
+	for (size_t i = 0; i < (size_t)width * height; i++)
+		memcpy(pixels + i * 4, bg, 4);
+
+	int x0 = ((int)width - (int)(textwidth * scale)) / 2;
+	int y0 = ((int)height - (int)(DM_GLYPH_CY * scale)) / 2;
+	for (size_t c = 0; c < len; c++) {
+		const char *found = strchr(dm_glyph_chars, text[c]);
+		size_t g = found ? (size_t)(found - dm_glyph_chars) : DM_GLYPH_COUNT - 1;
+		for (uint32_t y = 0; y < DM_GLYPH_CY * scale; y++) {
+			int py = y0 + (int)y;
+			if (py < 0 || py >= (int)height)
+				continue;
+			for (uint32_t x = 0; x < DM_GLYPH_ADVANCE * scale; x++) {
+				int px = x0 + (int)((c * DM_GLYPH_ADVANCE) * scale + x);
+				if (px < 0 || px >= (int)width ||
+				    !dm_glyphs.cells[bold][g][y / scale][x / scale])
+					continue;
+				memcpy(pixels + ((size_t)py * width + px) * 4, fg, 4);
+			}
+		}
+	}
+
+	*cx = width;
+	*cy = height;
+	return pixels;
+}
+
+/* ------------------------------------------------------------------------- */
+/* decoded image cache shared by all sources                                 */
+
+#define DM_IMAGE_DEFAULT_BUDGET_MB 256
+#define DM_STANDBY_DEFAULT_BUDGET_MB 64
+//how long a cached entry is trusted before its mtime is checked again
+#define DM_IMAGE_RECHECK_NS 1000000000ULL
+
+struct dm_image {
+	char *path;
+	//variant downscaled by 1 << shift, 0 is the file as decoded
+	int shift;
+	time_t mtime;
+	uint64_t checked;
+	uint64_t last_used;
+	long refs;
+	//dropped from the cache while still referenced, freed on last release
+	bool detached;
+
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_format format;
+	uint8_t *pixels;
+	//flip cards are two faces side by side, each gets its own texture
+	int faces;
+	uint32_t facewidth;
+	gs_texture_t *textures[2];
+	//pixels are bc1 blocks padded to whole blocks, cx and cy are the card's
+	bool compressed;
+	//pixels point into this mapped bundle instead of a decoded copy
+	struct dm_bundle *bundle;
+	size_t pixel_bytes;
+	//pixels plus the texture once it's uploaded
+	size_t bytes;
+};
+
+//header probe results, kept for layout passes that don't need pixels
+struct dm_probe {
+	char *path;
+	time_t mtime;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	bool initialized;
+	DARRAY(struct dm_image *) images;
+	DARRAY(struct dm_probe) probes;
+	DARRAY(struct dm_bundle *) bundles;
+	size_t bytes;
+	volatile long budget_mb;
+	//cards mapped from bundles, for comparing team load times
+	volatile long mapped;
+} dm_images;
+
+/* ------------------------------------------------------------------------- */
+/* per-set card bundles                                                      */
+
+/*
+ * A bundle holds every cached card of a set already decoded, so loading a
+ * team maps one file per set instead of decoding a jpeg per card.  Each
+ * rebuild writes a new generation, <set>.<generation>.dmb, and then points
+ * <set>.dmb at it by name.  A mapped generation is never written over or
+ * renamed onto, which Windows refuses, it's deleted once a later build finds
+ * it unused.  A <set>.dmb from before generations is a bundle itself.
+ * layout, all little endian:
+ *
+ *   struct dm_bundle_header
+ *   struct dm_bundle_entry[count], sorted by card number
+ *   pixel data, each card 16 byte aligned
+ *
+ * entries remember the mtime of the jpeg they were built from, a card whose
+ * jpeg has changed since is decoded from the jpeg as usual.
+ */
+
+#define DM_BUNDLE_MAGIC 0x31424D44 //"DMB1"
+#define DM_BUNDLE_EXT ".dmb"
+
+struct dm_bundle_header {
+	uint32_t magic;
+	uint32_t count;
+	uint64_t reserved;
+};
+
+struct dm_bundle_entry {
+	uint32_t number;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t format;
+	int64_t mtime;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct dm_bundle {
+	//the <set>.dmb pointer and its mtime when it named file
+	char *path;
+	time_t mtime;
+	char *file;
+	//one reference for the registry plus one per image using its pixels
+	long refs;
+	bool detached;
+
+	uint8_t *data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE handle;
+	HANDLE mapping;
+#endif
+	const struct dm_bundle_entry *entries;
+	uint32_t count;
+};
+
+static void dm_bundle_unmap(struct dm_bundle *bundle)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(bundle->data);
+	CloseHandle(bundle->mapping);
+	CloseHandle(bundle->handle);
+#else
+	munmap(bundle->data, bundle->size);
+#endif
+	bfree(bundle->path);
+	bfree(bundle->file);
+	bfree(bundle);
+}
+
+//maps the generation file for the pointer at path
+static struct dm_bundle *dm_bundle_map(const char *path, const char *file, time_t mtime)
+{
+	struct dm_bundle *bundle = bzalloc(sizeof(struct dm_bundle));
+
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	bundle->handle = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (bundle->handle == INVALID_HANDLE_VALUE) {
+		bfree(bundle);
+		return NULL;
+	}
+	if (!GetFileSizeEx(bundle->handle, &size) || size.QuadPart == 0) {
+		CloseHandle(bundle->handle);
+		bfree(bundle);
+		return NULL;
+	}
+	bundle->size = (size_t)size.QuadPart;
+	bundle->mapping = CreateFileMappingA(bundle->handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	bundle->data = bundle->mapping ?
+		MapViewOfFile(bundle->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!bundle->data) {
+		if (bundle->mapping)
+			CloseHandle(bundle->mapping);
+		CloseHandle(bundle->handle);
+		bfree(bundle);
+		return NULL;
+	}
+#else
+	int fd = open(file, O_RDONLY);
+	struct stat st;
+	if (fd < 0) {
+		bfree(bundle);
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		bfree(bundle);
+		return NULL;
+	}
+	bundle->size = (size_t)st.st_size;
+	bundle->data = mmap(NULL, bundle->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (bundle->data == MAP_FAILED) {
+		bfree(bundle);
+		return NULL;
+	}
+#endif
+
+	bundle->path = bstrdup(path);
+	bundle->file = bstrdup(file);
+	bundle->mtime = mtime;
+	bundle->refs = 1;
+
+	//check every entry once here so lookups can trust the index
+	const struct dm_bundle_header *header = (const void *)bundle->data;
+	bool valid = bundle->size >= sizeof(*header) && header->magic == DM_BUNDLE_MAGIC &&
+		header->count <= (bundle->size - sizeof(*header)) / sizeof(struct dm_bundle_entry);
+	if (valid) {
+		bundle->entries = (const void *)(bundle->data + sizeof(*header));
+		bundle->count = header->count;
+	}
+	for (uint32_t i = 0; valid && i < bundle->count; i++) {
+		const struct dm_bundle_entry *entry = &bundle->entries[i];
+		uint32_t bpp = gs_get_format_bpp((enum gs_color_format)entry->format);
+		valid = bpp && entry->size == (uint64_t)entry->cx * entry->cy * bpp / 8 &&
+			entry->offset <= bundle->size && entry->size <= bundle->size - entry->offset &&
+			(i == 0 || entry->number > bundle->entries[i - 1].number);
+	}
+	if (!valid) {
+		module_log(LOG_WARNING, "ignoring invalid card bundle '%s'", file);
+		dm_bundle_unmap(bundle);
+		return NULL;
+	}
+	return bundle;
+}
+
+static const struct dm_bundle_entry *dm_bundle_find(const struct dm_bundle *bundle, uint32_t number)
+{
+	size_t lo = 0;
+	size_t hi = bundle->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const struct dm_bundle_entry *entry = &bundle->entries[mid];
+		if (entry->number == number)
+			return entry;
+		if (entry->number < number)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+//parses a "<number><set>.jpg" card file name, dice strips and anything
+//else the plugin didn't download are rejected
+static bool dm_bundle_card_name(const char *name, uint32_t *number, char *set)
+{
+	const char *p = name;
+	uint32_t value = 0;
+	while (dm_is_digit(*p) && value < 100000)
+		value = value * 10 + (uint32_t)(*p++ - '0');
+	if (p == name)
+		return false;
+
+	const char *start = p;
+	while (dm_is_alnum(*p))
+		p++;
+	size_t setlen = p - start;
+	if (!setlen || setlen >= DM_SET_CODE_MAX || astrcmpi(p, ".jpg") != 0)
+		return false;
+
+	memcpy(set, start, setlen);
+	set[setlen] = 0;
+	*number = value;
+	return true;
+}
+
+//maps "<folder>/<number><set>.jpg" to "<folder>/<set>.dmb" and the card number
+static bool dm_bundle_path(const char *path, struct dstr *bundle_path, uint32_t *number)
+{
+	char set[DM_SET_CODE_MAX];
+	const char *name = path;
+	for (const char *p = path; *p; p++)
+		if (*p == '/' || *p == '\\')
+			name = p + 1;
+
+	if (!dm_bundle_card_name(name, number, set))
+		return false;
+
+	dstr_ncopy(bundle_path, path, name - path);
+	dstr_cat(bundle_path, set);
+	dstr_cat(bundle_path, DM_BUNDLE_EXT);
+	return true;
+}
+
+//the generation file the <set>.dmb pointer at path names
+static bool dm_bundle_resolve(const char *path, struct dstr *file)
+{
+	char name[64];
+	uint32_t magic = 0;
+
+	FILE *fp = os_fopen(path, "rb");
+	if (!fp)
+		return false;
+	size_t len = fread(name, 1, sizeof(name) - 1, fp);
+	fclose(fp);
+
+	memcpy(&magic, name, len < sizeof(magic) ? len : sizeof(magic));
+	if (magic == DM_BUNDLE_MAGIC) {
+		dstr_copy(file, path);
+		return true;
+	}
+
+	while (len && dm_is_space(name[len - 1]))
+		len--;
+	name[len] = 0;
+	size_t extlen = sizeof(DM_BUNDLE_EXT) - 1;
+	if (len <= extlen || strcmp(name + len - extlen, DM_BUNDLE_EXT) != 0 ||
+	    strpbrk(name, "/\\:") != NULL)
+		return false;
+
+	const char *folder_end = path;
+	for (const char *p = path; *p; p++)
+		if (*p == '/' || *p == '\\')
+			folder_end = p + 1;
+	dstr_ncopy(file, path, folder_end - path);
+	dstr_cat(file, name);
+	return true;
+}
+
+//expects the image cache lock to be held, returns true if it can be unmapped
+static bool dm_bundle_unref(struct dm_bundle *bundle)
+{
+	return --bundle->refs == 0;
+}
+
+static void dm_bundle_release(struct dm_bundle *bundle)
+{
+	pthread_mutex_lock(&dm_images.mutex);
+	bool unmap = dm_bundle_unref(bundle);
+	pthread_mutex_unlock(&dm_images.mutex);
+	if (unmap)
+		dm_bundle_unmap(bundle);
+}
+
+//returns a referenced bundle holding an up to date copy of the card file
+//at path, or NULL if it has to be decoded from the file itself
+static struct dm_bundle *dm_bundle_acquire(const char *path, time_t mtime,
+	const struct dm_bundle_entry **entry)
+{
+	struct dstr bundle_path = { 0 };
+	struct dstr file = { 0 };
+	struct dm_bundle *bundle = NULL;
+	struct dm_bundle *stale = NULL;
+	uint32_t number;
+	struct stat st;
+
+	if (!dm_bundle_path(path, &bundle_path, &number) ||
+	    os_stat(bundle_path.array, &st) != 0) {
+		dstr_free(&bundle_path);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = 0; i < dm_images.bundles.num; i++) {
+		struct dm_bundle *cached = dm_images.bundles.array[i];
+		if (strcmp(cached->path, bundle_path.array) != 0)
+			continue;
+		if (cached->mtime == st.st_mtime) {
+			bundle = cached;
+			bundle->refs++;
+		}
+		break;
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	//the pointer changed, only a new generation needs mapping
+	if (!bundle && !dm_bundle_resolve(bundle_path.array, &file)) {
+		dstr_free(&bundle_path);
+		return NULL;
+	}
+
+	if (!bundle) {
+		pthread_mutex_lock(&dm_images.mutex);
+		for (size_t i = 0; i < dm_images.bundles.num; i++) {
+			struct dm_bundle *cached = dm_images.bundles.array[i];
+			if (strcmp(cached->path, bundle_path.array) != 0)
+				continue;
+			if (strcmp(cached->file, file.array) == 0) {
+				cached->mtime = st.st_mtime;
+				bundle = cached;
+				bundle->refs++;
+			}
+			else {
+				//rebuilt since it was mapped, images still using it keep it alive
+				da_erase(dm_images.bundles, i);
+				cached->detached = true;
+				if (dm_bundle_unref(cached))
+					stale = cached;
+			}
+			break;
+		}
+		pthread_mutex_unlock(&dm_images.mutex);
+	}
+
+	if (stale)
+		dm_bundle_unmap(stale);
+
+	if (!bundle) {
+		struct dm_bundle *mapped = dm_bundle_map(bundle_path.array, file.array, st.st_mtime);
+		pthread_mutex_lock(&dm_images.mutex);
+		//another source may have mapped it while this one did
+		for (size_t i = 0; mapped && i < dm_images.bundles.num; i++) {
+			struct dm_bundle *cached = dm_images.bundles.array[i];
+			if (strcmp(cached->path, mapped->path) == 0 && strcmp(cached->file, mapped->file) == 0) {
+				bundle = cached;
+				bundle->refs++;
+				break;
+			}
+		}
+		if (mapped && !bundle) {
+			bundle = mapped;
+			bundle->refs++;
+			da_push_back(dm_images.bundles, &bundle);
+			mapped = NULL;
+		}
+		pthread_mutex_unlock(&dm_images.mutex);
+		if (mapped)
+			dm_bundle_unmap(mapped);
+	}
+	dstr_free(&bundle_path);
+	dstr_free(&file);
+	if (!bundle)
+		return NULL;
+
+	*entry = dm_bundle_find(bundle, number);
+	if (!*entry || (*entry)->mtime != (int64_t)mtime) {
+		dm_bundle_release(bundle);
+		return NULL;
+	}
+	return bundle;
+}
+
+//one loose card file found by the bundle builder
+struct dm_bundle_card {
+	uint32_t number;
+	char set[DM_SET_CODE_MAX];
+	time_t mtime;
+};
+
+static volatile long dm_bundle_building;
+
+static int dm_bundle_card_compare(const void *a, const void *b)
+{
+	const struct dm_bundle_card *ca = a;
+	const struct dm_bundle_card *cb = b;
+	int set = strcmp(ca->set, cb->set);
+	if (set)
+		return set;
+	return ca->number < cb->number ? -1 : ca->number > cb->number;
+}
+
+//makes the next lookup re-read the pointer at path, a rebuild within the
+//second it was mapped in leaves its mtime as it was
+static void dm_bundle_invalidate(const char *path)
+{
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = 0; i < dm_images.bundles.num; i++)
+		if (strcmp(dm_images.bundles.array[i]->path, path) == 0)
+			dm_images.bundles.array[i]->mtime = 0;
+	pthread_mutex_unlock(&dm_images.mutex);
+}
+
+//true for "<set>.<hex generation>.dmb", the files a build of set writes
+static bool dm_bundle_is_generation(const char *name, const char *set)
+{
+	size_t setlen = strlen(set);
+	size_t extlen = sizeof(DM_BUNDLE_EXT) - 1;
+	size_t len = strlen(name);
+	if (len <= setlen + 1 + extlen || strncmp(name, set, setlen) != 0 || name[setlen] != '.' ||
+	    astrcmpi(name + len - extlen, DM_BUNDLE_EXT) != 0)
+		return false;
+	for (size_t i = setlen + 1; i < len - extlen; i++)
+		if (!dm_is_digit(name[i]) && (name[i] < 'a' || name[i] > 'f'))
+			return false;
+	return true;
+}
+
+//true for the files a bundle build writes, which the disk budget counts but
+//doesn't evict
+static bool dm_bundle_is_file(const char *name)
+{
+	size_t extlen = sizeof(DM_BUNDLE_EXT) - 1;
+	size_t len = strlen(name);
+	return len > extlen && astrcmpi(name + len - extlen, DM_BUNDLE_EXT) == 0;
+}
+
+//deletes the set's generations other than current.  one still mapped here or
+//by another process can't go on Windows, the next build tries it again.
+static void dm_bundle_prune(const char *folder, const char *set, const char *current)
+{
+	struct dstr path = { 0 };
+	os_dir_t *dir = os_opendir(folder);
+	struct os_dirent *ent;
+
+	while (dir && (ent = os_readdir(dir)) != NULL) {
+		if (ent->directory || strcmp(ent->d_name, current) == 0 ||
+		    !dm_bundle_is_generation(ent->d_name, set))
+			continue;
+		dstr_printf(&path, "%s/%s", folder, ent->d_name);
+		if (os_unlink(path.array) == 0)
+			dm_disk_forget(path.array);
+	}
+	if (dir)
+		os_closedir(dir);
+	dstr_free(&path);
+}
+
+//decodes cards[0..count) into a new generation of the set's bundle, then
+//points <folder>/<set>.dmb at it.  nothing mapped is ever written to.
+static size_t dm_bundle_write(const char *folder, const struct dm_bundle_card *cards, size_t count)
+{
+	static const uint8_t zeros[16] = { 0 };
+	struct dm_bundle_header header = { DM_BUNDLE_MAGIC, 0, 0 };
+	struct dm_bundle_entry *entries = bzalloc(sizeof(struct dm_bundle_entry) * count);
+	struct dstr card_path = { 0 };
+	struct dstr path = { 0 };
+	struct dstr name = { 0 };
+	struct dstr file = { 0 };
+	bool ok = true;
+
+	dstr_printf(&path, "%s/%s%s", folder, cards[0].set, DM_BUNDLE_EXT);
+	dstr_printf(&name, "%s.%llx%s", cards[0].set, (unsigned long long)os_gettime_ns(), DM_BUNDLE_EXT);
+	dstr_printf(&file, "%s/%s", folder, name.array);
+
+	FILE *fp = os_fopen(file.array, "wb");
+	if (!fp) {
+		ok = false;
+		goto done;
+	}
+
+	//the index goes in last, once every offset is known
+	uint64_t offset = sizeof(header) + sizeof(struct dm_bundle_entry) * count;
+	ok = fseek(fp, (long)offset, SEEK_SET) == 0;
+
+	for (size_t i = 0; ok && i < count; i++) {
+		enum gs_color_format format;
+		uint32_t cx, cy;
+
+		dstr_printf(&card_path, "%s/%u%s.jpg", folder, cards[i].number, cards[i].set);
+		uint8_t *pixels = gs_create_texture_file_data(card_path.array, &format, &cx, &cy);
+		if (!pixels)
+			continue;
+
+		size_t pad = (size_t)((16 - offset % 16) % 16);
+		struct dm_bundle_entry *entry = &entries[header.count++];
+		entry->number = cards[i].number;
+		entry->cx = cx;
+		entry->cy = cy;
+		entry->format = (uint32_t)format;
+		entry->mtime = (int64_t)cards[i].mtime;
+		entry->offset = offset + pad;
+		entry->size = (uint64_t)cx * cy * gs_get_format_bpp(format) / 8;
+		ok = fwrite(zeros, 1, pad, fp) == pad &&
+			fwrite(pixels, 1, (size_t)entry->size, fp) == entry->size;
+		offset = entry->offset + entry->size;
+		bfree(pixels);
+	}
+
+	//unused index slots from cards that failed to decode stay zeroed
+	ok = ok && fseek(fp, 0, SEEK_SET) == 0 &&
+		fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(entries, sizeof(struct dm_bundle_entry), count, fp) == count;
+	ok = fclose(fp) == 0 && ok;
+
+	//the pointer is the only file replaced, and nothing maps it
+	ok = ok && os_quick_write_utf8_file_safe(path.array, name.array, name.len, false, "tmp", NULL);
+	if (ok) {
+		dm_disk_record(file.array, offset, 0);
+		dm_bundle_invalidate(path.array);
+		dm_bundle_prune(folder, cards[0].set, name.array);
+	}
+	else {
+		module_log(LOG_WARNING, "failed to write card bundle '%s'", file.array);
+		os_unlink(file.array);
+	}
+
+done:
+	dstr_free(&card_path);
+	dstr_free(&path);
+	dstr_free(&name);
+	dstr_free(&file);
+	bfree(entries);
+	return ok ? header.count : 0;
+}
+
+//converts the loose jpegs in folder to one bundle per set, returns how many
+//cards were bundled
+static size_t dm_bundle_build_folder(const char *folder, size_t *sets)
+{
+	DARRAY(struct dm_bundle_card) cards;
+	struct dstr path = { 0 };
+	size_t bundled = 0;
+
+	*sets = 0;
+	da_init(cards);
+
+	os_dir_t *dir = os_opendir(folder);
+	struct os_dirent *ent;
+	while (dir && (ent = os_readdir(dir)) != NULL) {
+		struct dm_bundle_card card = { 0 };
+		struct stat st;
+
+		if (ent->directory || !dm_bundle_card_name(ent->d_name, &card.number, card.set))
+			continue;
+		dstr_printf(&path, "%s/%s", folder, ent->d_name);
+		if (os_stat(path.array, &st) != 0)
+			continue;
+		card.mtime = st.st_mtime;
+		da_push_back(cards, &card);
+	}
+	if (dir)
+		os_closedir(dir);
+
+	qsort(cards.array, cards.num, sizeof(struct dm_bundle_card), dm_bundle_card_compare);
+
+	for (size_t first = 0; first < cards.num;) {
+		size_t last = first + 1;
+		while (last < cards.num && strcmp(cards.array[last].set, cards.array[first].set) == 0)
+			last++;
+		//the same card can't appear twice in one index
+		size_t count = 0;
+		for (size_t i = first; i < last; i++)
+			if (i == first || cards.array[i].number != cards.array[i - 1].number)
+				cards.array[first + count++] = cards.array[i];
+		size_t written = dm_bundle_write(folder, &cards.array[first], count);
+		if (written) {
+			bundled += written;
+			(*sets)++;
+		}
+		first = last;
+	}
+
+	dstr_free(&path);
+	da_free(cards);
+	return bundled;
+}
+
+static void *dm_bundle_builder_thread(void *data)
+{
+	char *folder = data;
+	uint64_t start = os_gettime_ns();
+	size_t sets;
+
+	os_set_thread_name("dm_source: bundle builder");
+	size_t bundled = dm_bundle_build_folder(folder, &sets);
+	module_log(LOG_INFO, "bundled %zu cards into %zu sets in %llu ms", bundled, sets,
+		(unsigned long long)((os_gettime_ns() - start) / 1000000));
+
+	bfree(folder);
+	os_atomic_set_long(&dm_bundle_building, 0);
+	return NULL;
+}
+
+//converts the loose jpegs in folder to bundles on a background thread
+static void dm_bundle_build(const char *folder)
+{
+	pthread_t thread;
+
+	if (!folder || !*folder)
+		return;
+	if (os_atomic_inc_long(&dm_bundle_building) != 1) {
+		os_atomic_dec_long(&dm_bundle_building);
+		module_log(LOG_INFO, "card bundles are already being built");
+		return;
+	}
+
+	char *copy = bstrdup(folder);
+	if (pthread_create(&thread, NULL, dm_bundle_builder_thread, copy) != 0) {
+		bfree(copy);
+		os_atomic_set_long(&dm_bundle_building, 0);
+		return;
+	}
+	pthread_detach(thread);
+}
+
+/* ------------------------------------------------------------------------- */
+/* block compressed cards                                                    */
+
+/*
+ * Cards that are only drawn as sprites can be uploaded as BC1 (DXT1)
+ * blocks, an eighth the size of rgba.  The encoder is plain C with no
+ * graphics, so it runs headless.  Its output is kept next to the card as
+ * "<card>.<shift>.bc1", so later loads skip the jpeg decode as well.
+ * Textures are padded out to whole 4x4 blocks and drawn as a subregion.
+ * Anything that isn't 8 bit colour stays rgba, and so does a flip card
+ * whose faces don't split on a block edge.
+ */
+
+#define DM_BC1_MAGIC 0x31434244 /* "DBC1" */
+//cards the encoder button also times uploads of, both ways
+#define DM_BC1_BENCH_CARDS 16
+#define DM_BC1_MAX_SIZE 16384
+
+struct dm_bc1_header {
+	uint32_t magic;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t reserved;
+	//of the card the blocks were encoded from
+	int64_t mtime;
+};
+
+//quality, size and upload cost of the compressed tier against rgba,
+//guarded by the image cache mutex
+static struct {
+	long encoded;
+	double psnr_sum;
+	double psnr_min;
+	uint64_t rgba_bytes;
+	uint64_t bc1_bytes;
+	uint64_t encode_ns;
+	//texture uploads by format, [0] rgba and [1] bc1
+	long uploads[2];
+	uint64_t upload_bytes[2];
+	uint64_t upload_ns[2];
+} dm_bc1;
+
+static volatile long dm_bc1_building;
+
+static inline uint32_t dm_round4(uint32_t value)
+{
+	return (value + 3) & ~3u;
+}
+
+static inline size_t dm_bc1_size(uint32_t cx, uint32_t cy)
+{
+	return (size_t)(dm_round4(cx) / 4) * (dm_round4(cy) / 4) * 8;
+}
+
+static bool dm_bc1_encodable(enum gs_color_format format, uint32_t cx, uint32_t cy)
+{
+	if (format != GS_RGBA && format != GS_BGRA && format != GS_BGRX)
+		return false;
+	//a flip card's faces each need whole blocks
+	return cx <= cy || cx % 8 == 0;
+}
+
+static void dm_bc1_path(struct dstr *out, const char *path, int shift)
+{
+	dstr_printf(out, "%s.%d.bc1", path, shift);
+}
+
+static inline uint16_t dm_pack565(const int *c)
+{
+	return (uint16_t)((((c[0] * 31 + 127) / 255) << 11) |
+		(((c[1] * 63 + 127) / 255) << 5) | ((c[2] * 31 + 127) / 255));
+}
+
+static inline void dm_unpack565(uint16_t value, int *c)
+{
+	int r = (value >> 11) & 31;
+	int g = (value >> 5) & 63;
+	int b = value & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+//one 4x4 block from its bounding box, flipped along whichever diagonal the
+//colours run, with the ends pulled in a little.  returns the squared error
+//of the pixels that are really in the image.
+static uint64_t dm_bc1_block(int px[16][3], int valid, uint8_t *out)
+{
+	int lo[3] = { 255, 255, 255 };
+	int hi[3] = { 0, 0, 0 };
+	int mean[3] = { 0, 0, 0 };
+
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			if (px[i][c] < lo[c])
+				lo[c] = px[i][c];
+			if (px[i][c] > hi[c])
+				hi[c] = px[i][c];
+			mean[c] += px[i][c];
+		}
+	}
+
+	//red and blue against green pick the diagonal
+	long cov_rg = 0, cov_bg = 0;
+	for (int i = 0; i < 16; i++) {
+		int g = px[i][1] * 16 - mean[1];
+		cov_rg += (long)(px[i][0] * 16 - mean[0]) * g;
+		cov_bg += (long)(px[i][2] * 16 - mean[2]) * g;
+	}
+	int ends[2][3];
+	for (int c = 0; c < 3; c++) {
+		int inset = (hi[c] - lo[c]) / 16;
+		ends[0][c] = hi[c] - inset;
+		ends[1][c] = lo[c] + inset;
+	}
+	if (cov_rg < 0) {
+		int t = ends[0][0]; ends[0][0] = ends[1][0]; ends[1][0] = t;
+	}
+	if (cov_bg < 0) {
+		int t = ends[0][2]; ends[0][2] = ends[1][2]; ends[1][2] = t;
+	}
+
+	uint16_t c0 = dm_pack565(ends[0]);
+	uint16_t c1 = dm_pack565(ends[1]);
+	//c0 > c1 selects the four colour mode, equal ends only use index 0
+	if (c0 < c1) {
+		uint16_t t = c0; c0 = c1; c1 = t;
+	}
+
+	int palette[4][3];
+	dm_unpack565(c0, palette[0]);
+	dm_unpack565(c1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	uint32_t indices = 0;
+	uint64_t error = 0;
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		int bestdist = INT32_MAX;
+		for (int p = 0; p < (c0 == c1 ? 1 : 4); p++) {
+			int dr = px[i][0] - palette[p][0];
+			int dg = px[i][1] - palette[p][1];
+			int db = px[i][2] - palette[p][2];
+			int dist = dr * dr + dg * dg + db * db;
+			if (dist < bestdist) {
+				bestdist = dist;
+				best = p;
+			}
+		}
+		indices |= (uint32_t)best << (2 * i);
+		if (valid & (1 << i))
+			error += (uint64_t)bestdist;
+	}
+
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (8 * i)) & 0xFF;
+	return error;
+}
+
+//encodes rgba or bgra pixels to bc1 blocks, repeating the edge pixels out to
+//whole blocks, and gives the psnr of what the blocks decode to
+static uint8_t *dm_bc1_encode(const uint8_t *pixels, enum gs_color_format format,
+		uint32_t cx, uint32_t cy, double *psnr)
+{
+	uint32_t bx = dm_round4(cx) / 4;
+	uint32_t by = dm_round4(cy) / 4;
+	uint8_t *blocks = bmalloc(dm_bc1_size(cx, cy));
+	int red = format == GS_RGBA ? 0 : 2;
+	uint64_t error = 0;
+
+	for (uint32_t y = 0; y < by; y++) {
+		for (uint32_t x = 0; x < bx; x++) {
+			int px[16][3];
+			int valid = 0;
+			for (uint32_t i = 0; i < 16; i++) {
+				uint32_t sx = x * 4 + i % 4;
+				uint32_t sy = y * 4 + i / 4;
+				if (sx < cx && sy < cy)
+					valid |= 1 << i;
+				if (sx >= cx)
+					sx = cx - 1;
+				if (sy >= cy)
+					sy = cy - 1;
+				const uint8_t *p = pixels + ((size_t)sy * cx + sx) * 4;
+				px[i][0] = p[red];
+				px[i][1] = p[1];
+				px[i][2] = p[2 - red];
+			}
+			error += dm_bc1_block(px, valid, blocks + ((size_t)y * bx + x) * 8);
+		}
+	}
+
+	double mse = (double)error / ((double)cx * cy * 3);
+	*psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+	return blocks;
+}
+
+static uint8_t *dm_bc1_read(const char *path, int shift, time_t mtime, uint32_t *cx, uint32_t *cy)
+{
+	struct dm_bc1_header header;
+	struct dstr file = { 0 };
+	uint8_t *blocks = NULL;
+
+	dm_bc1_path(&file, path, shift);
+	FILE *fp = os_fopen(file.array, "rb");
+	//marks it used, the variants are evicted along with the cards
+	if (fp)
+		dm_disk_exists(file.array);
+	dstr_free(&file);
+	if (!fp)
+		return NULL;
+
+	//encoded from an older copy of the card, or not ours
+	if (fread(&header, sizeof(header), 1, fp) == 1 && header.magic == DM_BC1_MAGIC &&
+	    header.mtime == (int64_t)mtime && header.cx && header.cy &&
+	    header.cx <= DM_BC1_MAX_SIZE && header.cy <= DM_BC1_MAX_SIZE) {
+		size_t size = dm_bc1_size(header.cx, header.cy);
+		blocks = bmalloc(size);
+		if (fread(blocks, 1, size, fp) == size) {
+			*cx = header.cx;
+			*cy = header.cy;
+		}
+		else {
+			bfree(blocks);
+			blocks = NULL;
+		}
+	}
+	fclose(fp);
+	return blocks;
+}
+
+static void dm_bc1_write(const char *path, int shift, time_t mtime, uint32_t cx, uint32_t cy,
+		const uint8_t *blocks)
+{
+	struct dm_bc1_header header = { DM_BC1_MAGIC, cx, cy, 0, (int64_t)mtime };
+	struct dstr file = { 0 };
+	struct dstr temp = { 0 };
+	size_t size = dm_bc1_size(cx, cy);
+
+	dm_bc1_path(&file, path, shift);
+	dstr_printf(&temp, "%s.tmp", file.array);
+	FILE *fp = os_fopen(temp.array, "wb");
+	bool ok = fp && fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(blocks, 1, size, fp) == size;
+	ok = fp && fclose(fp) == 0 && ok;
+	if (ok) {
+		os_unlink(file.array);
+		ok = os_rename(temp.array, file.array) == 0;
+	}
+	if (ok)
+		dm_disk_record(file.array, sizeof(header) + size, 0);
+	else
+		os_unlink(temp.array);
+	dstr_free(&file);
+	dstr_free(&temp);
+}
+
+//encodes a decoded card, counts it into the quality report and keeps the
+//blocks on disk for next time.  NULL if the card can't be compressed.
+static uint8_t *dm_bc1_encode_card(const char *path, int shift, time_t mtime,
+		const uint8_t *pixels, enum gs_color_format format, uint32_t cx, uint32_t cy, double *out_psnr)
+{
+	if (!pixels || !dm_bc1_encodable(format, cx, cy))
+		return NULL;
+
+	uint64_t start = os_gettime_ns();
+	double psnr;
+	uint8_t *blocks = dm_bc1_encode(pixels, format, cx, cy, &psnr);
+	if (out_psnr)
+		*out_psnr = psnr;
+	uint64_t elapsed = os_gettime_ns() - start;
+	dm_bc1_write(path, shift, mtime, cx, cy, blocks);
+
+	pthread_mutex_lock(&dm_images.mutex);
+	if (!dm_bc1.encoded || psnr < dm_bc1.psnr_min)
+		dm_bc1.psnr_min = psnr;
+	dm_bc1.encoded++;
+	dm_bc1.psnr_sum += psnr;
+	dm_bc1.rgba_bytes += (uint64_t)cx * cy * 4;
+	dm_bc1.bc1_bytes += dm_bc1_size(cx, cy);
+	dm_bc1.encode_ns += elapsed;
+	pthread_mutex_unlock(&dm_images.mutex);
+	return blocks;
+}
+
+static void dm_bc1_format_report(struct dstr *out, const char *separator)
+{
+	pthread_mutex_lock(&dm_images.mutex);
+	if (dm_bc1.encoded) {
+		dstr_catf(out, "bc1: %ld cards, %.1f dB mean psnr (%.1f worst), %.1f MB rgba -> %.1f MB, %.1f ms per card%s",
+			dm_bc1.encoded, dm_bc1.psnr_sum / dm_bc1.encoded, dm_bc1.psnr_min,
+			dm_bc1.rgba_bytes / (1024.0 * 1024.0), dm_bc1.bc1_bytes / (1024.0 * 1024.0),
+			dm_bc1.encode_ns / 1000000.0 / dm_bc1.encoded, separator);
+	}
+	static const char *names[2] = { "rgba", "bc1" };
+	for (int i = 0; i < 2; i++) {
+		double mb = dm_bc1.upload_bytes[i] / (1024.0 * 1024.0);
+		dstr_catf(out, "%s uploads: %ld, %.1f MB in %.2f ms (%.2f ms per MB)%s", names[i],
+			dm_bc1.uploads[i], mb, dm_bc1.upload_ns[i] / 1000000.0,
+			mb > 0.0 ? dm_bc1.upload_ns[i] / 1000000.0 / mb : 0.0, i ? "" : separator);
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+}
+
+//times creating the same card's texture from rgba and from blocks
+static void dm_bc1_bench(const uint8_t *pixels, enum gs_color_format format, uint32_t cx, uint32_t cy,
+		const uint8_t *blocks, uint64_t *rgba_ns, uint64_t *bc1_ns)
+{
+	dm_enter_graphics();
+	uint64_t start = os_gettime_ns();
+	gs_texture_t *texture = dm_texture_create(cx, cy, format, pixels);
+	gs_flush();
+	*rgba_ns += os_gettime_ns() - start;
+	gs_texture_destroy(texture);
+
+	start = os_gettime_ns();
+	texture = dm_texture_create(dm_round4(cx), dm_round4(cy), GS_DXT1, blocks);
+	gs_flush();
+	*bc1_ns += os_gettime_ns() - start;
+	gs_texture_destroy(texture);
+	dm_leave_graphics();
+}
+
+static void *dm_bc1_builder_thread(void *data)
+{
+	char *folder = data;
+	uint64_t start = os_gettime_ns();
+	uint64_t rgba_ns = 0, bc1_ns = 0;
+	size_t benched = 0;
+	size_t encoded = 0;
+	double psnr_sum = 0.0;
+	uint64_t rgba_bytes = 0, bc1_bytes = 0;
+	struct dstr path = { 0 };
+
+	os_set_thread_name("dm_source: bc1 encoder");
+
+	os_dir_t *dir = os_opendir(folder);
+	struct os_dirent *ent;
+	while (dir && (ent = os_readdir(dir)) != NULL) {
+		uint32_t number, cx, cy;
+		char set[DM_SET_CODE_MAX];
+		struct stat st;
+
+		if (ent->directory || !dm_bundle_card_name(ent->d_name, &number, set))
+			continue;
+		dstr_printf(&path, "%s/%s", folder, ent->d_name);
+		if (os_stat(path.array, &st) != 0)
+			continue;
+
+		//already encoded from this copy of the card
+		uint8_t *blocks = dm_bc1_read(path.array, 0, st.st_mtime, &cx, &cy);
+		if (blocks) {
+			bfree(blocks);
+			continue;
+		}
+
+		enum gs_color_format format;
+		uint8_t *pixels = gs_create_texture_file_data(path.array, &format, &cx, &cy);
+		double psnr;
+		blocks = dm_bc1_encode_card(path.array, 0, st.st_mtime, pixels, format, cx, cy, &psnr);
+		if (!blocks) {
+			bfree(pixels);
+			continue;
+		}
+		encoded++;
+		psnr_sum += psnr;
+		rgba_bytes += (uint64_t)cx * cy * 4;
+		bc1_bytes += dm_bc1_size(cx, cy);
+
+		if (benched < DM_BC1_BENCH_CARDS) {
+			dm_bc1_bench(pixels, format, cx, cy, blocks, &rgba_ns, &bc1_ns);
+			benched++;
+		}
+		bfree(pixels);
+		bfree(blocks);
+	}
+	if (dir)
+		os_closedir(dir);
+
+	module_log(LOG_INFO, "bc1: encoded %zu cards in %llu ms, %.1f dB mean psnr, %.1f MB rgba -> %.1f MB",
+		encoded, (unsigned long long)((os_gettime_ns() - start) / 1000000),
+		encoded ? psnr_sum / encoded : 0.0,
+		rgba_bytes / (1024.0 * 1024.0), bc1_bytes / (1024.0 * 1024.0));
+	if (benched)
+		module_log(LOG_INFO, "bc1: %zu card uploads took %.2f ms as rgba, %.2f ms as bc1",
+			benched, rgba_ns / 1000000.0, bc1_ns / 1000000.0);
+
+	dstr_free(&path);
+	bfree(folder);
+	os_atomic_set_long(&dm_bc1_building, 0);
+	return NULL;
+}
+
+//pre-encodes the loose jpegs in folder on a background thread
+static void dm_bc1_build(const char *folder)
+{
+	pthread_t thread;
+
+	if (!folder || !*folder)
+		return;
+	if (os_atomic_inc_long(&dm_bc1_building) != 1) {
+		os_atomic_dec_long(&dm_bc1_building);
+		module_log(LOG_INFO, "cards are already being encoded");
+		return;
+	}
+
+	char *copy = bstrdup(folder);
+	if (pthread_create(&thread, NULL, dm_bc1_builder_thread, copy) != 0) {
+		bfree(copy);
+		os_atomic_set_long(&dm_bc1_building, 0);
+		return;
+	}
+	pthread_detach(thread);
+}
+
+static void dm_image_destroy(struct dm_image *image)
+{
+	if (image->textures[0]) {
+		dm_enter_graphics();
+		for (int face = 0; face < image->faces; face++)
+			gs_texture_destroy(image->textures[face]);
+		dm_leave_graphics();
+	}
+	if (image->bundle)
+		dm_bundle_release(image->bundle);
+	else
+		bfree(image->pixels);
+	bfree(image->path);
+	bfree(image);
+}
+
+static void dm_images_init(void)
+{
+	if (dm_images.initialized)
+		return;
+	if (pthread_mutex_init(&dm_images.mutex, NULL) != 0)
+		return;
+	dm_images.budget_mb = DM_IMAGE_DEFAULT_BUDGET_MB;
+	dm_images.initialized = true;
+}
+
+static void dm_images_free(void)
+{
+	if (!dm_images.initialized)
+		return;
+
+	for (size_t i = 0; i < dm_images.images.num; i++)
+		dm_image_destroy(dm_images.images.array[i]);
+	da_free(dm_images.images);
+	dm_images.bytes = 0;
+
+	for (size_t i = 0; i < dm_images.probes.num; i++)
+		bfree(dm_images.probes.array[i].path);
+	da_free(dm_images.probes);
+
+	for (size_t i = 0; i < dm_images.bundles.num; i++)
+		dm_bundle_unmap(dm_images.bundles.array[i]);
+	da_free(dm_images.bundles);
+
+	pthread_mutex_destroy(&dm_images.mutex);
+	dm_images.initialized = false;
+}
+
+static void dm_images_set_budget(long budget_mb)
+{
+	os_atomic_set_long(&dm_images.budget_mb, budget_mb);
+}
+
+//removes the entry from the cache, the caller frees it outside the lock
+//once nothing references it any more
+static bool dm_images_remove(size_t idx)
+{
+	struct dm_image *image = dm_images.images.array[idx];
+	dm_images.bytes -= image->bytes;
+	da_erase(dm_images.images, idx);
+	image->detached = true;
+	return image->refs == 0;
+}
+
+//evicts least recently used, unreferenced entries until under budget.
+//expects the lock to be held, victims are returned for freeing after unlock.
+static void dm_images_trim(struct dm_image **victims, size_t *num_victims, size_t max_victims)
+{
+	size_t budget = (size_t)os_atomic_load_long(&dm_images.budget_mb) * 1024 * 1024;
+
+	while (dm_images.bytes > budget && *num_victims < max_victims) {
+		size_t oldest = DARRAY_INVALID;
+		for (size_t i = 0; i < dm_images.images.num; i++) {
+			struct dm_image *image = dm_images.images.array[i];
+			if (image->refs)
+				continue;
+			if (oldest == DARRAY_INVALID ||
+			    image->last_used < dm_images.images.array[oldest]->last_used)
+				oldest = i;
+		}
+		if (oldest == DARRAY_INVALID)
+			break;
+
+		victims[(*num_victims)++] = dm_images.images.array[oldest];
+		dm_images_remove(oldest);
+	}
+}
+
+static void dm_images_free_victims(struct dm_image **victims, size_t num_victims)
+{
+	for (size_t i = 0; i < num_victims; i++)
+		dm_image_destroy(victims[i]);
+}
+
+//drops every unreferenced entry, used once the last source is gone so the
+//textures are released while the graphics context still exists
+static void dm_images_purge(void)
+{
+	DARRAY(struct dm_image *) victims;
+	da_init(victims);
+
+	if (!dm_images.initialized)
+		return;
+
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = dm_images.images.num; i > 0; i--) {
+		struct dm_image *image = dm_images.images.array[i - 1];
+		if (dm_images_remove(i - 1))
+			da_push_back(victims, &image);
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	for (size_t i = 0; i < victims.num; i++)
+		dm_image_destroy(victims.array[i]);
+	da_free(victims);
+}
+
+//adds one source row into the per-channel sums of its blocks.  only ever
+//called with a literal block, so it's inlined once per shift with constant
+//inner bounds the compiler can unroll and vectorize.
+static inline void dm_downscale_row(const uint8_t *row, uint32_t *sums, uint32_t dcx, const uint32_t block)
+{
+	for (uint32_t x = 0; x < dcx; x++) {
+		const uint8_t *p = row + (size_t)x * block * 4;
+		uint32_t *sum = sums + (size_t)x * 4;
+		for (uint32_t bx = 0; bx < block; bx++) {
+			sum[0] += p[bx * 4];
+			sum[1] += p[bx * 4 + 1];
+			sum[2] += p[bx * 4 + 2];
+			sum[3] += p[bx * 4 + 3];
+		}
+	}
+}
+
+//averages every (1 << shift) square block of a 4 byte per pixel image, the
+//remainder rows and columns are dropped.  shift is 1 to DM_SCALE_MAX_SHIFT,
+//full size images are never run through here.
+static uint8_t *dm_downscale(const uint8_t *src, uint32_t cx, uint32_t cy, int shift,
+	uint32_t *out_cx, uint32_t *out_cy)
+{
+	if (shift < 1 || shift > DM_SCALE_MAX_SHIFT)
+		return NULL;
+
+	uint32_t block = 1u << shift;
+	uint32_t dcx = cx >> shift;
+	uint32_t dcy = cy >> shift;
+	uint32_t round = 1u << (2 * shift - 1);
+	size_t stride = (size_t)cx * 4;
+
+	if (!dcx || !dcy)
+		return NULL;
+
+	uint8_t *dst = bmalloc((size_t)dcx * dcy * 4);
+	uint32_t *sums = bmalloc((size_t)dcx * 4 * sizeof(uint32_t));
+
+	for (uint32_t y = 0; y < dcy; y++) {
+		memset(sums, 0, (size_t)dcx * 4 * sizeof(uint32_t));
+		for (uint32_t by = 0; by < block; by++) {
+			const uint8_t *row = src + (size_t)(y * block + by) * stride;
+			switch (shift) {
+			case 1:
+				dm_downscale_row(row, sums, dcx, 2);
+				break;
+			case 2:
+				dm_downscale_row(row, sums, dcx, 4);
+				break;
+			default:
+				dm_downscale_row(row, sums, dcx, 8);
+				break;
+			}
+		}
+
+		uint8_t *out = dst + (size_t)y * dcx * 4;
+		for (size_t i = 0; i < (size_t)dcx * 4; i++)
+			out[i] = (uint8_t)((sums[i] + round) >> (2 * shift));
+	}
+
+	bfree(sums);
+	*out_cx = dcx;
+	*out_cy = dcy;
+	return dst;
+}
+
+static void dm_image_release(struct dm_image *image);
+static void dm_image_discard(struct dm_image *image);
+
+//fills in everything but the pixels, which the caller has already set
+static void dm_image_init(struct dm_image *image, const char *path, time_t mtime, uint64_t now)
+{
+	image->path = bstrdup(path);
+	image->mtime = mtime;
+	image->checked = now;
+	image->last_used = now;
+	image->refs = 1;
+	image->pixel_bytes = image->compressed ? dm_bc1_size(image->cx, image->cy) :
+		(size_t)image->cx * image->cy * gs_get_format_bpp(image->format) / 8;
+	//dice strips are wide but only have the one face
+	image->faces = image->cx > image->cy && !dm_is_glyph_strip(path) ? 2 : 1;
+	image->facewidth = image->cx / image->faces;
+	//mapped pixels are the file's pages, only a decoded copy counts
+	image->bytes = image->bundle ? 0 : image->pixel_bytes;
+}
+
+//returns a referenced, decoded image for the file or NULL if it isn't on disk
+//or can't be decoded.  shift picks a variant downscaled by 1 << shift, which
+//is made from the full decode and cached on its own.  compressed asks for bc1
+//blocks, an rgba image comes back if the card can't be compressed.  the
+//texture is created on first use by dm_image_face.
+static struct dm_image *dm_image_acquire(const char *path, int shift, bool compressed, bool *hit)
+{
+	struct dm_image *victims[8];
+	size_t num_victims = 0;
+	struct dm_image *image = NULL;
+	uint64_t now = os_gettime_ns();
+	struct stat st;
+
+	if (!path || !dm_images.initialized)
+		return NULL;
+	if (dm_is_glyph_strip(path))
+		compressed = false;
+
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = 0; i < dm_images.images.num; i++) {
+		struct dm_image *cached = dm_images.images.array[i];
+		if (cached->shift != shift || cached->compressed != compressed ||
+		    strcmp(cached->path, path) != 0)
+			continue;
+
+		//rendered strips have no file to go stale
+		if (now - cached->checked < DM_IMAGE_RECHECK_NS || dm_is_glyph_strip(path)) {
+			image = cached;
+		} else if (os_stat(path, &st) == 0 && st.st_mtime == cached->mtime) {
+			cached->checked = now;
+			image = cached;
+		} else if (dm_images_remove(i)) {
+			//file changed or went away since it was decoded
+			victims[num_victims++] = cached;
+		}
+		break;
+	}
+	if (image) {
+		image->refs++;
+		image->last_used = now;
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	dm_images_free_victims(victims, num_victims);
+	if (hit)
+		*hit = image != NULL;
+	if (image)
+		return image;
+
+	bool glyphs = dm_is_glyph_strip(path);
+	if (glyphs) {
+		st.st_mtime = 0;
+	}
+	else if (os_stat(path, &st) != 0) {
+		//so the next lookup fetches it again instead of trusting the index
+		dm_disk_forget(path);
+		return NULL;
+	}
+
+	//decode outside the lock so other sources aren't held up
+	image = bzalloc(sizeof(struct dm_image));
+	const struct dm_bundle_entry *entry = NULL;
+	struct dm_image *full = NULL;
+	if (compressed) {
+		image->pixels = dm_bc1_read(path, shift, st.st_mtime, &image->cx, &image->cy);
+		if (!image->pixels) {
+			struct dm_image *rgba = dm_image_acquire(path, shift, false, NULL);
+			if (!rgba) {
+				bfree(image);
+				return NULL;
+			}
+			image->pixels = dm_bc1_encode_card(path, shift, st.st_mtime, rgba->pixels,
+				rgba->format, rgba->cx, rgba->cy, NULL);
+			if (!image->pixels) {
+				bfree(image);
+				return rgba;
+			}
+			image->cx = rgba->cx;
+			image->cy = rgba->cy;
+			dm_image_discard(rgba);
+		}
+		image->format = GS_DXT1;
+		image->compressed = true;
+		image->shift = shift;
+	}
+	else if (shift > 0) {
+		full = dm_image_acquire(path, 0, false, NULL);
+		if (!full) {
+			bfree(image);
+			return NULL;
+		}
+		if (gs_get_format_bpp(full->format) == 32)
+			image->pixels = dm_downscale(full->pixels, full->cx, full->cy, shift,
+				&image->cx, &image->cy);
+		//too small or an unusual format, the full size is the best there is
+		if (!image->pixels) {
+			bfree(image);
+			return full;
+		}
+		image->format = full->format;
+		image->shift = shift;
+		dm_image_discard(full);
+	}
+	else if (glyphs) {
+		image->pixels = dm_dice_strip_render(path, &image->cx, &image->cy);
+		image->format = GS_RGBA;
+		if (!image->pixels) {
+			bfree(image);
+			return NULL;
+		}
+	}
+	else if ((image->bundle = dm_bundle_acquire(path, st.st_mtime, &entry)) != NULL) {
+		image->pixels = image->bundle->data + entry->offset;
+		image->format = (enum gs_color_format)entry->format;
+		image->cx = entry->cx;
+		image->cy = entry->cy;
+		os_atomic_inc_long(&dm_images.mapped);
+	}
+	else {
+		//a file written within the stale lock window may be another
+		//process's download its index doesn't have yet, the decode decides
+		bool sized = dm_disk_check_size(path, (uint64_t)st.st_size);
+		bool fresh = time(NULL) - st.st_mtime < DM_FETCH_LOCK_STALE_S;
+		if (sized || fresh)
+			image->pixels = dm_decode_file(path, &image->format, &image->cx, &image->cy);
+		if (!image->pixels) {
+			dm_disk_invalidate(path);
+			bfree(image);
+			return NULL;
+		}
+		if (!sized)
+			dm_disk_record(path, (uint64_t)st.st_size, 0);
+	}
+	dm_image_init(image, path, st.st_mtime, now);
+
+	num_victims = 0;
+	pthread_mutex_lock(&dm_images.mutex);
+	da_push_back(dm_images.images, &image);
+	dm_images.bytes += image->bytes;
+	dm_images_trim(victims, &num_victims, sizeof(victims) / sizeof(victims[0]));
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	dm_images_free_victims(victims, num_victims);
+	return image;
+}
+
+//puts a downloaded card into the image cache, so the first source to draw
+//it gets a cache hit instead of decoding on the video thread.  takes the
+//pixels if the download was decoded from memory, the file isn't written yet
+//then and the image waits for dm_images_stamp.  otherwise decodes the file
+//that was just committed.  returns whether the card is cached.
+static bool dm_images_publish(const char *path, uint8_t *pixels, enum gs_color_format format, uint32_t cx,
+	uint32_t cy, uint64_t start)
+{
+	struct dm_image *victims[8];
+	size_t num_victims = 0;
+	bool duplicate = false;
+	bool memory = pixels != NULL;
+	struct stat st;
+
+	if (!dm_images.initialized || (!memory && os_stat(path, &st) != 0)) {
+		bfree(pixels);
+		return false;
+	}
+	//no file to take an mtime from, any older decode of the card is stale
+	if (memory)
+		st.st_mtime = 0;
+
+	struct dm_image *image = bzalloc(sizeof(struct dm_image));
+	image->pixels = pixels;
+	image->format = format;
+	image->cx = cx;
+	image->cy = cy;
+	if (!memory)
+		image->pixels = dm_decode_file(path, &image->format, &image->cx, &image->cy);
+	if (!image->pixels) {
+		bfree(image);
+		return false;
+	}
+	dm_image_init(image, path, st.st_mtime, os_gettime_ns());
+	//cached but unused until a source acquires it
+	image->refs = 0;
+	if (!memory)
+		dm_disk_set_size(path, image->cx, image->cy);
+
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = 0; i < dm_images.images.num; i++) {
+		struct dm_image *cached = dm_images.images.array[i];
+		if (cached->shift || cached->compressed || strcmp(cached->path, path) != 0)
+			continue;
+		//a source got to the new file first
+		if (cached->mtime == st.st_mtime)
+			duplicate = true;
+		else if (dm_images_remove(i))
+			victims[num_victims++] = cached;
+		break;
+	}
+	if (!duplicate) {
+		da_push_back(dm_images.images, &image);
+		dm_images.bytes += image->bytes;
+		dm_images_trim(victims, &num_victims, sizeof(victims) / sizeof(victims[0]));
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	if (duplicate)
+		dm_image_destroy(image);
+	dm_images_free_victims(victims, num_victims);
+	module_log(LOG_DEBUG, "decoded '%s' from %s in %llu us", path, memory ? "memory" : "disk",
+		(unsigned long long)((os_gettime_ns() - start) / 1000));
+	return true;
+}
+
+//gives a card published from memory the mtime of the file that's now been
+//written for it, until then the image is only trusted until its next recheck
+static void dm_images_stamp(const char *path)
+{
+	uint32_t cx = 0, cy = 0;
+	struct stat st;
+
+	if (!dm_images.initialized || os_stat(path, &st) != 0)
+		return;
+
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = 0; i < dm_images.images.num; i++) {
+		struct dm_image *cached = dm_images.images.array[i];
+		if (cached->shift || cached->compressed || cached->mtime || strcmp(cached->path, path) != 0)
+			continue;
+		cached->mtime = st.st_mtime;
+		cached->checked = os_gettime_ns();
+		cx = cached->cx;
+		cy = cached->cy;
+		break;
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	if (cx && cy)
+		dm_disk_set_size(path, cx, cy);
+}
+
+//releases a full size decode that was only needed to make a variant, it's
+//dropped straight away unless something else is using it
+static void dm_image_discard(struct dm_image *image)
+{
+	pthread_mutex_lock(&dm_images.mutex);
+	if (image->refs == 1 && !image->textures[0] && !image->detached) {
+		for (size_t i = 0; i < dm_images.images.num; i++) {
+			if (dm_images.images.array[i] == image) {
+				dm_images_remove(i);
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+	dm_image_release(image);
+}
+
+//another reference to an image the caller already holds one of
+static struct dm_image *dm_image_addref(struct dm_image *image)
+{
+	if (image) {
+		pthread_mutex_lock(&dm_images.mutex);
+		image->refs++;
+		pthread_mutex_unlock(&dm_images.mutex);
+	}
+	return image;
+}
+
+static void dm_image_release(struct dm_image *image)
+{
+	struct dm_image *victims[8];
+	size_t num_victims = 0;
+	bool destroy;
+
+	if (!image)
+		return;
+
+	pthread_mutex_lock(&dm_images.mutex);
+	image->refs--;
+	destroy = image->detached && image->refs == 0;
+	if (!destroy)
+		dm_images_trim(victims, &num_victims, sizeof(victims) / sizeof(victims[0]));
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	if (destroy)
+		dm_image_destroy(image);
+	dm_images_free_victims(victims, num_victims);
+}
+
+//uploads every face of the image on first use and returns the one asked for,
+//textures are shared by every source.  must be called inside the graphics
+//context.  the upload runs outside the cache lock so other threads looking
+//up images don't wait on it, if two threads upload the same image the first
+//to finish is kept.
+static gs_texture_t *dm_image_face(struct dm_image *image, int face)
+{
+	gs_texture_t *textures[2] = { NULL, NULL };
+
+	if (!image)
+		return NULL;
+
+	pthread_mutex_lock(&dm_images.mutex);
+	if (image->textures[0]) {
+		pthread_mutex_unlock(&dm_images.mutex);
+		return image->textures[face < image->faces ? face : 0];
+	}
+	//keeps the pixels from being trimmed while they upload
+	image->refs++;
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	//compressed images are split and padded in whole 4x4 blocks
+	bool bc = image->compressed;
+	size_t bpp = gs_get_format_bpp(image->format) / 8;
+	uint32_t facewidth = bc ? dm_round4(image->facewidth) : image->facewidth;
+	uint32_t height = bc ? dm_round4(image->cy) : image->cy;
+	uint32_t rows = bc ? height / 4 : height;
+	size_t stride = bc ? (size_t)dm_round4(image->cx) / 4 * 8 : (size_t)image->cx * bpp;
+	size_t linesize = bc ? (size_t)facewidth / 4 * 8 : (size_t)facewidth * bpp;
+	uint64_t start = os_gettime_ns();
+
+	if (image->faces == 1) {
+		const uint8_t *data = image->pixels;
+		textures[0] = dm_texture_create(facewidth, height, image->format, data);
+	}
+	else {
+		//split the double wide image so each face uploads on its own
+		uint8_t *half = bmalloc(linesize * rows);
+		for (int i = 0; i < 2; i++) {
+			for (uint32_t y = 0; y < rows; y++)
+				memcpy(half + y * linesize, image->pixels + y * stride + i * linesize, linesize);
+			const uint8_t *data = half;
+			textures[i] = dm_texture_create(facewidth, height, image->format, data);
+		}
+		bfree(half);
+	}
+	uint64_t ns = os_gettime_ns() - start;
+
+	pthread_mutex_lock(&dm_images.mutex);
+	bool lost = image->textures[0] != NULL;
+	if (!lost) {
+		image->textures[0] = textures[0];
+		image->textures[1] = textures[1];
+		dm_bc1.uploads[bc]++;
+		dm_bc1.upload_bytes[bc] += linesize * rows * image->faces;
+		dm_bc1.upload_ns[bc] += ns;
+
+		image->bytes += image->pixel_bytes;
+		if (!image->detached)
+			dm_images.bytes += image->pixel_bytes;
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	if (lost) {
+		for (int i = 0; i < 2; i++)
+			if (textures[i])
+				gs_texture_destroy(textures[i]);
+	}
+	gs_texture_t *texture = image->textures[face < image->faces ? face : 0];
+	dm_image_release(image);
+	return texture;
+}
+
+static inline uint32_t dm_read_be16(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 8) | p[1];
+}
+
+static inline uint32_t dm_read_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+//reads the frame size out of a JPEG's SOF segment or a PNG's IHDR chunk
+//without decoding anything
+static bool dm_probe_header(const char *path, uint32_t *cx, uint32_t *cy)
+{
+	static const uint8_t png_sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	uint8_t buf[24];
+	bool found = false;
+
+	FILE *fp = os_fopen(path, "rb");
+	if (!fp)
+		return false;
+
+	if (fread(buf, 1, 2, fp) != 2)
+		goto done;
+
+	if (buf[0] == png_sig[0] && buf[1] == png_sig[1]) {
+		if (fread(buf + 2, 1, 22, fp) != 22 || memcmp(buf, png_sig, 8) != 0 ||
+		    memcmp(buf + 12, "IHDR", 4) != 0)
+			goto done;
+		*cx = dm_read_be32(buf + 16);
+		*cy = dm_read_be32(buf + 20);
+		found = true;
+	}
+	else if (buf[0] == 0xFF && buf[1] == 0xD8) {
+		for (;;) {
+			int marker;
+			//markers can be padded with any number of 0xFF bytes
+			do {
+				marker = fgetc(fp);
+			} while (marker == 0xFF);
+			if (marker == EOF)
+				break;
+
+			//standalone markers have no length
+			if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+				continue;
+			if (marker == 0xD9 || marker == 0xDA)
+				break;
+
+			if (fread(buf, 1, 2, fp) != 2)
+				break;
+			uint32_t len = dm_read_be16(buf);
+			if (len < 2)
+				break;
+
+			bool sof = marker >= 0xC0 && marker <= 0xCF &&
+				marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+			if (sof) {
+				if (len < 7 || fread(buf, 1, 5, fp) != 5)
+					break;
+				*cy = dm_read_be16(buf + 1);
+				*cx = dm_read_be16(buf + 3);
+				found = *cx && *cy;
+				break;
+			}
+			if (fseek(fp, len - 2, SEEK_CUR) != 0)
+				break;
+
+			//next marker
+			if (fgetc(fp) != 0xFF)
+				break;
+		}
+	}
+
+done:
+	fclose(fp);
+	return found;
+}
+
+//card dimensions for layout.  probes the file header once per path and mtime
+//and only falls back to a full decode for formats the probe doesn't know.
+static bool dm_image_full_size(const char *path, uint32_t *cx, uint32_t *cy)
+{
+	struct stat st;
+	bool found = false;
+
+	if (dm_is_glyph_strip(path))
+		return dm_dice_strip_size(path, cx, cy);
+	if (!path || !dm_images.initialized || os_stat(path, &st) != 0)
+		return false;
+
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = 0; i < dm_images.probes.num; i++) {
+		struct dm_probe *probe = &dm_images.probes.array[i];
+		if (strcmp(probe->path, path) != 0)
+			continue;
+		if (probe->mtime == st.st_mtime) {
+			*cx = probe->cx;
+			*cy = probe->cy;
+			found = true;
+		}
+		else {
+			bfree(probe->path);
+			da_erase(dm_images.probes, i);
+		}
+		break;
+	}
+	pthread_mutex_unlock(&dm_images.mutex);
+	if (found)
+		return true;
+
+	//the disk index remembers sizes across restarts
+	bool indexed = dm_disk_get_size(path, cx, cy);
+	found = indexed || dm_probe_header(path, cx, cy);
+	if (!found) {
+		struct dm_image *image = dm_image_acquire(path, 0, false, NULL);
+		if (image) {
+			*cx = image->cx;
+			*cy = image->cy;
+			found = true;
+		}
+		dm_image_release(image);
+	}
+	if (found && !indexed)
+		dm_disk_set_size(path, *cx, *cy);
+
+	if (found) {
+		struct dm_probe probe = { bstrdup(path), st.st_mtime, *cx, *cy };
+		pthread_mutex_lock(&dm_images.mutex);
+		da_push_back(dm_images.probes, &probe);
+		pthread_mutex_unlock(&dm_images.mutex);
+	}
+	return found;
+}
+
+//size of the variant downscaled by 1 << shift, as made by dm_downscale
+static bool dm_image_size(const char *path, uint32_t *cx, uint32_t *cy, int shift)
+{
+	if (!dm_image_full_size(path, cx, cy))
+		return false;
+	if ((*cx >> shift) && (*cy >> shift)) {
+		*cx >>= shift;
+		*cy >>= shift;
+	}
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* team builder strings                                                      */
+
+/*
+ * Parses a team builder string such as "4x75bff;2x78avx" in a single pass
+ * without allocating.  The team builder link form, where the list is the
+ * first query value ("...?team=4x75bff;2x78avx&..."), is handled in the same
+ * pass: everything before the first '=' is dropped and a '&' after it ends
+ * the list.  Tokens that aren't <dice>x<number><set> with a card number
+ * of 1-999 and a set code of up to 7 characters are skipped.  Reentrant,
+ * fills at most max cards and returns how many were written.
+ */
+static size_t dm_parse_team(const char *str, struct dm_team_card *out, size_t max)
+{
+	const char *p = str;
+	bool query = false;
+	size_t count = 0;
+
+	while (p && *p) {
+		struct dm_team_card card = { 0 };
+		uint32_t dice = 0;
+		uint32_t number = 0;
+		size_t digits = 0;
+		size_t setlen = 0;
+		bool valid;
+
+		while (dm_is_space(*p))
+			p++;
+
+		for (digits = 0; dm_is_digit(*p); digits++)
+			dice = dice * 10 + (*p++ - '0');
+		valid = digits > 0 && digits <= 3 && dice <= UINT8_MAX;
+
+		//separator between the dice count and the card, normally 'x'
+		if (valid && *p && *p != ';' && *p != '&' && *p != '=')
+			p++;
+		else
+			valid = false;
+
+		for (digits = 0; dm_is_digit(*p); digits++)
+			number = number * 10 + (*p++ - '0');
+		valid = valid && digits > 0 && digits <= 3 && number > 0;
+
+		while (dm_is_alnum(*p)) {
+			if (setlen < DM_SET_CODE_MAX - 1)
+				card.set[setlen++] = *p;
+			else
+				valid = false;
+			p++;
+		}
+		valid = valid && setlen > 0;
+
+		//anything else before the delimiter spoils the token
+		while (*p && *p != ';' && *p != '&' && *p != '=') {
+			if (!dm_is_space(*p))
+				valid = false;
+			p++;
+		}
+
+		if (*p == '=') {
+			if (!query) {
+				//the list starts after the first '=' of a link
+				query = true;
+				count = 0;
+				p++;
+				continue;
+			}
+			valid = false;
+		}
+
+		if (valid && count < max) {
+			card.dice = (uint8_t)dice;
+			card.number = (uint16_t)number;
+			out[count++] = card;
+		}
+
+		if (*p == '&' && query)
+			break;
+		if (*p)
+			p++;
+	}
+
+	return count;
+}
+
+static void dm_source_free_file_list(struct dm_source *context)
+{
+	for (size_t i = 0; i < context->files.num; i++)
+		bfree(context->files.array[i]);
+	for (size_t i = 0; i < context->dice.num; i++)
+		bfree(context->dice.array[i]);
+	da_resize(context->files, 0);
+	da_resize(context->dice, 0);
+}
+
+static void dm_source_card_url(struct dm_source *context, const struct dm_team_card *card,
+		struct dstr *url)
+{
+	dstr_printf(url, "%s/Image.php?set=%s&cardnum=%u&res=l",
+			context->cardservice, card->set, card->number);
+}
+
+//builds the card's image path and dice strip key, downloading the image if it's missing
+static void dm_source_card_paths(struct dm_source *context, const struct dm_team_card *card,
+		char **file, char **dice)
+{
+	struct dstr path = { 0 };
+	struct dstr url = { 0 };
+
+	dstr_printf(&path, "%s/%u%s.jpg", context->imagefolder, card->number, card->set);
+	//downlaod files if they don't exist, or check them for changes on refresh
+	bool cached = dm_disk_exists(path.array);
+	if (!cached || context->revalidate) {
+		dm_source_card_url(context, card, &url);
+		dm_source_request(context, url.array, path.array, cached);
+	}
+	*file = path.array;
+
+	//the dice count is rendered from the built-in glyphs, nothing to fetch
+	struct dstr dicepath = { 0 };
+	dm_dice_strip_key(&dicepath, card->dice, context->dice_height,
+			context->dice_color, context->dice_background, context->dice_bold);
+	*dice = dicepath.array;
+
+	dstr_free(&url);
+}
+
+//points every dice strip at the current glyph style
+static void dm_source_restyle_dice(struct dm_source *context)
+{
+	struct dstr key = { 0 };
+	for (size_t i = 0; i < context->dice.num && i < context->team.num; i++) {
+		struct dm_team_card *card = &context->team.array[i];
+		dm_dice_strip_key(&key, card->dice, context->dice_height,
+				context->dice_color, context->dice_background, context->dice_bold);
+		bfree(context->dice.array[i]);
+		context->dice.array[i] = bstrdup(key.array);
+	}
+	dstr_free(&key);
+}
+
+static void dm_source_add_card(struct dm_source *context, const struct dm_team_card *card)
+{
+	char *file;
+	char *dice;
+	dm_source_card_paths(context, card, &file, &dice);
+	da_push_back(context->files, &file);
+	da_push_back(context->dice, &dice);
+}
+
+bool updateFileList(struct dm_source *context)
+{
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS];
+	char *tbstring = context->tbstring;
+
+	dm_source_free_file_list(context);
+	da_resize(context->team, 0);
+
+	os_mkdir(context->imagefolder);
+	//anything parked from the previous team string is stale now
+	dm_source_clear_pending(context);
+
+	if (!tbstring || !*tbstring)
+		return false;
+
+	profile_start(dm_profile_file_list);
+	debug("loading texture '%s'", tbstring);
+	profile_start(dm_profile_parse);
+	size_t count = dm_parse_team(tbstring, cards, DM_TEAM_MAX_CARDS);
+	profile_end(dm_profile_parse);
+
+	profile_start(dm_profile_request);
+	for (size_t i = 0; i < count; i++) {
+		da_push_back(context->team, &cards[i]);
+		dm_source_add_card(context, &cards[i]);
+	}
+
+	context->fetch_generation = dm_fetch_generation();
+	context->waiting = dm_source_count_missing(context);
+	profile_end(dm_profile_request);
+	profile_end(dm_profile_file_list);
+	return true;
+}
+
+//solid texture drawn in place of images that are still downloading
+static gs_texture_t *dm_create_placeholder(uint32_t cx, uint32_t cy)
+{
+	uint32_t *pixels = bmalloc(cx * cy * sizeof(uint32_t));
+	for (uint32_t i = 0; i < cx * cy; i++)
+		pixels[i] = 0xFF303030;
+
+	const uint8_t *data = (const uint8_t *)pixels;
+	gs_texture_t *tex = dm_texture_create(cx, cy, GS_BGRA, data);
+	bfree(pixels);
+	return tex;
+}
+
+//a transparent texture of at least cx x cy, it only ever grows.  expects the
+//graphics context.
+static gs_texture_t *dm_source_zeros(struct dm_source *context, uint32_t cx, uint32_t cy)
+{
+	uint32_t zx = context->zeros ? gs_texture_get_width(context->zeros) : 0;
+	uint32_t zy = context->zeros ? gs_texture_get_height(context->zeros) : 0;
+	if (cx <= zx && cy <= zy)
+		return context->zeros;
+
+	if (cx < zx)
+		cx = zx;
+	if (cy < zy)
+		cy = zy;
+	uint8_t *pixels = bzalloc((size_t)cx * cy * sizeof(uint32_t));
+	if (context->zeros)
+		gs_texture_destroy(context->zeros);
+	context->zeros = dm_texture_create(cx, cy, GS_BGRA, pixels);
+	bfree(pixels);
+	return context->zeros;
+}
+
+//blanks a part of a reused texture that the new team won't draw over
+static void dm_source_clear_region(struct dm_source *context, gs_texture_t *dst, uint32_t x, uint32_t y,
+	uint32_t cx, uint32_t cy)
+{
+	if (!cx || !cy)
+		return;
+	dm_copy_texture_region(dst, x, y, dm_source_zeros(context, cx, cy), 0, 0, cx, cy);
+}
+
+//tournament sources keep the texture a team was drawn into for the next
+//team, anything else frees it.  expects the graphics context.
+static void dm_source_retire_texture(struct dm_source *context, gs_texture_t **spare, gs_texture_t *texture)
+{
+	if (*spare)
+		gs_texture_destroy(*spare);
+	*spare = NULL;
+	if (context->teams.num)
+		*spare = texture;
+	else if (texture)
+		gs_texture_destroy(texture);
+}
+
+//hands back the kept texture if it's the size asked for, otherwise frees it.
+//expects the graphics context.
+static gs_texture_t *dm_source_take_spare(gs_texture_t **spare, uint32_t cx, uint32_t cy)
+{
+	gs_texture_t *texture = *spare;
+	*spare = NULL;
+	if (texture && gs_texture_get_width(texture) == cx && gs_texture_get_height(texture) == cy)
+		return texture;
+	if (texture)
+		gs_texture_destroy(texture);
+	return NULL;
+}
+
+static void dm_source_free_spares(struct dm_source *context)
+{
+	dm_enter_graphics();
+	dm_source_retire_texture(context, &context->spare_combo, NULL);
+	dm_source_retire_texture(context, &context->spare_atlas, NULL);
+	if (context->zeros)
+		gs_texture_destroy(context->zeros);
+	context->zeros = NULL;
+	dm_leave_graphics();
+}
+
+/* ------------------------------------------------------------------------- */
+/* layouts for the composed views                                            */
+
+/*
+ * A layout is a json descriptor.  Slots are placed on a grid of card cells,
+ * each cell being one card plus its dice strip:
+ *
+ *   x = col * card width + xmargins * margin   (from the right edge if
+ *                                               "align" is "right")
+ *   y = row * (card height + dice height) + ymargins * margin
+ *
+ * xmargins/ymargins default to col/row.  "columns" generates one slot per
+ * card instead of listing them.  "width" and "height" give the canvas as
+ * {"cards", "dice", "margins"} counts, width may use "aspect" to scale the
+ * card and dice part of the height instead.  Left out they fit the slots.
+ */
+
+struct dm_layout_extent {
+	bool fit;
+	double aspect;
+	int cards;
+	int dice;
+	int margins;
+};
+
+struct dm_layout_slot {
+	int col;
+	int row;
+	int xmargins;
+	int ymargins;
+	bool right;
+};
+
+struct dm_layout {
+	char *name;
+	int columns;
+	DARRAY(struct dm_layout_slot) slots;
+	struct dm_layout_extent width;
+	struct dm_layout_extent height;
+};
+
+static const struct {
+	const char *name;
+	const char *json;
+} dm_builtin_layouts[] = {
+	{ "Playmat View",
+	  "{\"width\": {\"aspect\": 1.7777778, \"margins\": 4},"
+	  " \"height\": {\"cards\": 3, \"dice\": 3, \"margins\": 3},"
+	  " \"slots\": ["
+	  "  {\"col\": 0, \"row\": 1},"
+	  "  {\"col\": 1, \"row\": 1, \"xmargins\": 2},"
+	  "  {\"col\": 1, \"row\": 1, \"xmargins\": 2, \"align\": \"right\"},"
+	  "  {\"col\": 0, \"row\": 1, \"align\": \"right\"},"
+	  "  {\"col\": 0, \"row\": 2},"
+	  "  {\"col\": 1, \"row\": 2, \"xmargins\": 2},"
+	  "  {\"col\": 1, \"row\": 2, \"xmargins\": 2, \"align\": \"right\"},"
+	  "  {\"col\": 0, \"row\": 2, \"align\": \"right\"},"
+	  "  {\"col\": 1, \"row\": 0, \"xmargins\": 2},"
+	  "  {\"col\": 1, \"row\": 0, \"xmargins\": 2, \"align\": \"right\"}]}" },
+	{ "Creator View",
+	  "{\"columns\": 5,"
+	  " \"width\": {\"cards\": 5, \"margins\": 4},"
+	  " \"height\": {\"cards\": 2, \"dice\": 2, \"margins\": 1}}" },
+	{ "Horizontal Row",
+	  "{\"columns\": 10,"
+	  " \"width\": {\"cards\": 10, \"margins\": 9},"
+	  " \"height\": {\"cards\": 1, \"dice\": 1}}" },
+};
+
+#define DM_BUILTIN_LAYOUT_COUNT (sizeof(dm_builtin_layouts) / sizeof(dm_builtin_layouts[0]))
+
+static struct dm_layout *dm_builtin_layout_cache[DM_BUILTIN_LAYOUT_COUNT];
+
+static void dm_layout_read_extent(obs_data_t *data, const char *name, struct dm_layout_extent *extent)
+{
+	obs_data_t *obj = obs_data_get_obj(data, name);
+	memset(extent, 0, sizeof(*extent));
+	extent->fit = obj == NULL;
+	if (obj) {
+		extent->aspect = obs_data_get_double(obj, "aspect");
+		extent->cards = (int)obs_data_get_int(obj, "cards");
+		extent->dice = (int)obs_data_get_int(obj, "dice");
+		extent->margins = (int)obs_data_get_int(obj, "margins");
+		obs_data_release(obj);
+	}
+}
+
+//no view needs more cells or margins than this, anything past it is a typo
+//that would make a canvas too big for the gpu
+#define DM_LAYOUT_MAX_CELLS 64
+#define DM_LAYOUT_MAX_ASPECT 16.0
+
+static bool dm_layout_check(const char *name, const char *extent, const char *what, long long value)
+{
+	if (value >= 0 && value <= DM_LAYOUT_MAX_CELLS)
+		return true;
+	module_log(LOG_WARNING, "layout '%s': %s%s%s %lld is out of range (0 to %d)", name,
+			extent ? extent : "", extent ? " " : "", what, value, DM_LAYOUT_MAX_CELLS);
+	return false;
+}
+
+static bool dm_layout_check_extent(const char *name, const char *what, const struct dm_layout_extent *extent)
+{
+	if (extent->fit)
+		return true;
+	if (extent->aspect < 0.0 || extent->aspect > DM_LAYOUT_MAX_ASPECT) {
+		module_log(LOG_WARNING, "layout '%s': %s aspect %g is out of range", name, what, extent->aspect);
+		return false;
+	}
+	if (!dm_layout_check(name, what, "cards", extent->cards) || !dm_layout_check(name, what, "dice", extent->dice) ||
+			!dm_layout_check(name, what, "margins", extent->margins))
+		return false;
+	//a canvas with no cards in it has nothing to show the slots on
+	if (extent->cards == 0 && extent->aspect == 0.0) {
+		module_log(LOG_WARNING, "layout '%s': %s holds no cards", name, what);
+		return false;
+	}
+	return true;
+}
+
+//NULL if any count is negative or out of range, a bad custom layout is
+//refused as a whole rather than drawn partly off the canvas
+static struct dm_layout *dm_layout_create(obs_data_t *data, const char *name)
+{
+	struct dm_layout *layout = bzalloc(sizeof(struct dm_layout));
+	bool valid = true;
+	layout->name = bstrdup(name);
+	long long columns = obs_data_get_int(data, "columns");
+	valid &= dm_layout_check(name, NULL, "columns", columns);
+	layout->columns = (int)columns;
+	dm_layout_read_extent(data, "width", &layout->width);
+	dm_layout_read_extent(data, "height", &layout->height);
+	valid &= dm_layout_check_extent(name, "width", &layout->width);
+	valid &= dm_layout_check_extent(name, "height", &layout->height);
+
+	obs_data_array_t *slots = obs_data_get_array(data, "slots");
+	size_t count = slots ? obs_data_array_count(slots) : 0;
+	for (size_t i = 0; i < count && valid; i++) {
+		obs_data_t *item = obs_data_array_item(slots, i);
+		long long col = obs_data_get_int(item, "col");
+		long long row = obs_data_get_int(item, "row");
+		long long xmargins = obs_data_has_user_value(item, "xmargins") ?
+			obs_data_get_int(item, "xmargins") : col;
+		long long ymargins = obs_data_has_user_value(item, "ymargins") ?
+			obs_data_get_int(item, "ymargins") : row;
+		valid = dm_layout_check(name, NULL, "col", col) && dm_layout_check(name, NULL, "row", row) &&
+			dm_layout_check(name, NULL, "xmargins", xmargins) &&
+			dm_layout_check(name, NULL, "ymargins", ymargins);
+
+		struct dm_layout_slot *slot = da_push_back_new(layout->slots);
+		slot->col = (int)col;
+		slot->row = (int)row;
+		slot->xmargins = (int)xmargins;
+		slot->ymargins = (int)ymargins;
+		slot->right = strcmp(obs_data_get_string(item, "align"), "right") == 0;
+		obs_data_release(item);
+	}
+	obs_data_array_release(slots);
+
+	if (!valid) {
+		da_free(layout->slots);
+		bfree(layout->name);
+		bfree(layout);
+		return NULL;
+	}
+	return layout;
+}
+
+static void dm_layout_destroy(struct dm_layout *layout)
+{
+	if (!layout)
+		return;
+	da_free(layout->slots);
+	bfree(layout->name);
+	bfree(layout);
+}
+
+//user layouts are loaded from a json file, NULL if it can't be read or has no slots
+static struct dm_layout *dm_layout_load(const char *path)
+{
+	if (!path || !*path)
+		return NULL;
+
+	obs_data_t *data = obs_data_create_from_json_file(path);
+	if (!data)
+		return NULL;
+
+	struct dm_layout *layout = dm_layout_create(data, path);
+	obs_data_release(data);
+	if (layout && !layout->columns && !layout->slots.num) {
+		dm_layout_destroy(layout);
+		return NULL;
+	}
+	return layout;
+}
+
+static void dm_layouts_init(void)
+{
+	for (size_t i = 0; i < DM_BUILTIN_LAYOUT_COUNT; i++) {
+		obs_data_t *data = obs_data_create_from_json(dm_builtin_layouts[i].json);
+		dm_builtin_layout_cache[i] = dm_layout_create(data, dm_builtin_layouts[i].name);
+		obs_data_release(data);
+	}
+}
+
+static void dm_layouts_free(void)
+{
+	for (size_t i = 0; i < DM_BUILTIN_LAYOUT_COUNT; i++) {
+		dm_layout_destroy(dm_builtin_layout_cache[i]);
+		dm_builtin_layout_cache[i] = NULL;
+	}
+}
+
+static const struct dm_layout *dm_builtin_layout(const char *format)
+{
+	for (size_t i = 0; i < DM_BUILTIN_LAYOUT_COUNT; i++) {
+		if (strcmp(dm_builtin_layouts[i].name, format) == 0)
+			return dm_builtin_layout_cache[i];
+	}
+	return NULL;
+}
+
+//the slot for card i, grid layouts fill in the caller's scratch slot
+static const struct dm_layout_slot *dm_layout_get_slot(const struct dm_layout *layout, size_t i, struct dm_layout_slot *grid)
+{
+	if (!layout->columns)
+		return &layout->slots.array[i];
+
+	grid->col = (int)(i % layout->columns);
+	grid->row = (int)(i / layout->columns);
+	grid->xmargins = grid->col;
+	grid->ymargins = grid->row;
+	grid->right = false;
+	return grid;
+}
+
+static bool dm_layout_key_equal(const struct dm_layout_key *a, const struct dm_layout_key *b)
+{
+	return a->layout == b->layout && a->count == b->count &&
+		a->cardwidth == b->cardwidth && a->cardheight == b->cardheight &&
+		a->diceheight == b->diceheight && a->margin == b->margin;
+}
+
+static uint32_t dm_layout_extent_size(const struct dm_layout_extent *extent, uint32_t card, uint32_t dice, uint32_t margin)
+{
+	return extent->cards * card + extent->dice * dice + extent->margins * margin;
+}
+
+//turns the layout into the rebuild's flat slot table for the current card
+//size.  the table on screen is only copied when it was compiled for the same
+//layout, card count and sizes, and it's never touched until the swap.
+static void dm_source_compile_layout(struct dm_source *context, uint32_t cardwidth, uint32_t cardheight, uint32_t diceheight)
+{
+	struct dm_rebuild *r = &context->rebuild;
+	const struct dm_layout *layout = context->layout;
+	struct dm_layout_key key;
+	uint32_t margin = context->cardmargins;
+	struct dm_layout_slot grid;
+
+	key.layout = layout;
+	key.count = context->files.num;
+	key.cardwidth = cardwidth;
+	key.cardheight = cardheight;
+	key.diceheight = diceheight;
+	key.margin = margin;
+	r->key = key;
+	if (context->slots.num && dm_layout_key_equal(&key, &context->layout_key)) {
+		da_copy(r->slots, context->slots);
+		r->width = context->width;
+		r->height = context->height;
+		return;
+	}
+
+	size_t count = context->files.num;
+	if (!layout->columns && layout->slots.num < count)
+		count = layout->slots.num;
+
+	//canvas sizes that aren't given just fit the slots
+	uint32_t width = dm_layout_extent_size(&layout->width, cardwidth, 0, margin);
+	uint32_t height = dm_layout_extent_size(&layout->height, cardheight, diceheight, margin);
+	if (layout->width.aspect > 0.0) {
+		uint32_t content = dm_layout_extent_size(&layout->height, cardheight, diceheight, 0);
+		width = (uint32_t)(content * layout->width.aspect) + layout->width.margins * margin;
+	}
+	if (layout->width.fit || layout->height.fit) {
+		uint32_t fitwidth = 0;
+		uint32_t fitheight = 0;
+		for (size_t i = 0; i < count; i++) {
+			const struct dm_layout_slot *src = dm_layout_get_slot(layout, i, &grid);
+			uint32_t right = (src->col + 1) * cardwidth + src->xmargins * margin;
+			uint32_t bottom = (src->row + 1) * (cardheight + diceheight) + src->ymargins * margin;
+			if (right > fitwidth)
+				fitwidth = right;
+			if (bottom > fitheight)
+				fitheight = bottom;
+		}
+		if (layout->width.fit)
+			width = fitwidth;
+		if (layout->height.fit)
+			height = fitheight;
+	}
+
+	da_resize(r->slots, 0);
+	size_t dropped = 0;
+	for (size_t i = 0; i < count; i++) {
+		const struct dm_layout_slot *src = dm_layout_get_slot(layout, i, &grid);
+		uint64_t offset = (uint64_t)src->col * cardwidth + (uint64_t)src->xmargins * margin;
+		uint64_t top = (uint64_t)src->row * (cardheight + diceheight) + (uint64_t)src->ymargins * margin;
+
+		//a slot past the canvas edge would be copied outside the texture
+		if (offset + cardwidth > width || top + cardheight + diceheight > height) {
+			dropped++;
+			continue;
+		}
+
+		struct dm_slot *slot = da_push_back_new(r->slots);
+		slot->card = i;
+		slot->cx = cardwidth;
+		slot->cy = cardheight;
+		slot->x = (uint32_t)(src->right ? width - offset - cardwidth : offset);
+		slot->y = (uint32_t)top;
+		slot->dicex = slot->x;
+		slot->dicey = slot->y + cardheight;
+	}
+	if (dropped)
+		module_log(LOG_WARNING, "layout '%s': %zu of %zu cards fall outside the %ux%u canvas and are not shown",
+				layout->name, dropped, count, width, height);
+
+	r->width = width;
+	r->height = height;
+}
+
+//dice strips are drawn at most as wide as the card above them, a narrow
+//card would otherwise have its strip run into the next slot or off the canvas
+static inline uint32_t dm_slot_dice_width(const struct dm_slot *slot, const struct dm_image *dice)
+{
+	return dice->facewidth < slot->cx ? dice->facewidth : slot->cx;
+}
+
+/* ------------------------------------------------------------------------- */
+/* per-source stats                                                          */
+
+//how often the stats summary is written to the log while the source is shown
+#define DM_STATS_LOG_INTERVAL_NS (300 * 1000000000ULL)
+//how often the copy shown in the properties panel is refreshed
+#define DM_STATS_SNAPSHOT_INTERVAL_NS 1000000000ULL
+
+//dm_image_acquire at the source's scale, counted into its stats
+static struct dm_image *dm_source_acquire(struct dm_source *context, const char *path, bool compressed)
+{
+	uint64_t start = os_gettime_ns();
+	bool hit = false;
+	struct dm_image *image = dm_image_acquire(path, context->scale_shift, compressed, &hit);
+
+	if (hit) {
+		context->stats.hits++;
+	}
+	else if (image) {
+		context->stats.misses++;
+		context->stats.decode_ns += os_gettime_ns() - start;
+	}
+	return image;
+}
+
+static struct dm_image *dm_source_image(struct dm_source *context, const char *path)
+{
+	return dm_source_acquire(context, path, false);
+}
+
+//cards the source only ever draws as sprites can come from the compressed
+//tier, anything copied into a combo texture or atlas has to stay rgba
+static bool dm_source_card_compressed(struct dm_source *context)
+{
+	bool sprites = context->layout ? context->directrender : !context->atlas;
+	return context->gpucompress && sprites;
+}
+
+static struct dm_image *dm_source_card_image(struct dm_source *context, const char *path)
+{
+	return dm_source_acquire(context, path, dm_source_card_compressed(context));
+}
+
+//adds whatever finished downloading since the last check to the stats
+static void dm_source_collect_downloads(struct dm_source *context)
+{
+	for (size_t i = context->fetching.num; i > 0; i--) {
+		struct stat st;
+		if (os_stat(context->fetching.array[i - 1], &st) != 0)
+			continue;
+		context->stats.downloaded += (uint64_t)st.st_size;
+		bfree(context->fetching.array[i - 1]);
+		da_erase(context->fetching, i - 1);
+	}
+}
+
+static void dm_source_free_fetching(struct dm_source *context)
+{
+	for (size_t i = 0; i < context->fetching.num; i++)
+		bfree(context->fetching.array[i]);
+	da_free(context->fetching);
+}
+
+static size_t dm_texture_bytes(gs_texture_t *texture)
+{
+	if (!texture)
+		return 0;
+	return (size_t)gs_texture_get_width(texture) *
+		gs_texture_get_height(texture) *
+		gs_get_format_bpp(gs_texture_get_color_format(texture)) / 8;
+}
+
+static void dm_source_format_stats(struct dm_source *context, struct dstr *out, const char *separator)
+{
+	struct dm_source_stats *stats = &context->stats;
+	uint64_t lookups = stats->hits + stats->misses;
+
+	dm_enter_graphics();
+	size_t combo = dm_texture_bytes(context->comboTexture);
+	size_t atlas = dm_texture_bytes(context->atlas);
+	dm_leave_graphics();
+
+	dstr_printf(out, "image cache: %llu hits, %llu misses (%.0f%% hit)%s",
+		(unsigned long long)stats->hits, (unsigned long long)stats->misses,
+		lookups ? 100.0 * stats->hits / lookups : 0.0, separator);
+	dstr_catf(out, "decode: %.1f ms total, %.2f ms per miss%s",
+		stats->decode_ns / 1000000.0,
+		stats->misses ? stats->decode_ns / 1000000.0 / stats->misses : 0.0, separator);
+	dstr_catf(out, "downloaded: %.1f KB%s", stats->downloaded / 1024.0, separator);
+	dstr_catf(out, "combo texture: %.1f MB, atlas: %.1f MB%s",
+		combo / (1024.0 * 1024.0), atlas / (1024.0 * 1024.0), separator);
+	dm_bc1_format_report(out, separator);
+	if (context->teams.num) {
+		size_t preloaded = 0;
+		for (size_t i = 0; i < context->preload_images.num; i++)
+			preloaded += context->preload_images.array[i] != NULL;
+		dstr_catf(out, "%steams: %zu, %zu of %zu unique images preloaded", separator,
+			context->teams.num, preloaded, context->preload_paths.num);
+	}
+}
+
+//refreshes the panel's copy about once a second and logs every few minutes
+static void dm_source_update_stats(struct dm_source *context, uint64_t now)
+{
+	struct dstr text = { 0 };
+
+	if (now - context->stats.last_snapshot >= DM_STATS_SNAPSHOT_INTERVAL_NS) {
+		context->stats.last_snapshot = now;
+		dm_source_format_stats(context, &text, "\n");
+		pthread_mutex_lock(&context->stats.mutex);
+		bfree(context->stats.snapshot);
+		context->stats.snapshot = text.array;
+		pthread_mutex_unlock(&context->stats.mutex);
+		dstr_init(&text);
+	}
+
+	if (now - context->stats.last_log < DM_STATS_LOG_INTERVAL_NS)
+		return;
+	context->stats.last_log = now;
+
+	dm_source_format_stats(context, &text, ", ");
+	info("stats: %s", text.array);
+	dstr_free(&text);
+}
+
+/* ------------------------------------------------------------------------- */
+/* cycle cards atlas                                                         */
+
+//largest texture we'll ask for, anything bigger falls back to per-card textures
+#define DM_ATLAS_MAX_SIZE 8192
+
+static void dm_source_free_atlas(struct dm_source *context)
+{
+	dm_enter_graphics();
+	if (context->atlas) {
+		gs_texture_destroy(context->atlas);
+		context->atlas = NULL;
+	}
+	dm_leave_graphics();
+	da_resize(context->frames, 0);
+}
+
+//frees the atlas, or in tournament mode keeps it for the next team to reuse
+static void dm_source_retire_atlas(struct dm_source *context)
+{
+	dm_enter_graphics();
+	if (context->atlas)
+		dm_source_retire_texture(context, &context->spare_atlas, context->atlas);
+	context->atlas = NULL;
+	dm_leave_graphics();
+	da_resize(context->frames, 0);
+}
+
+static void dm_source_show_frame(struct dm_source *context)
+{
+	struct dm_frame *frame = &context->frames.array[context->currentFrame];
+	context->width = frame->cx;
+	context->height = frame->cy;
+}
+
+//sizes card i's atlas cells from the image headers, faces is 2 for a flip
+//card.  returns false if a placeholder stands in for the card or its strip.
+static bool dm_source_atlas_cell(struct dm_source *context, size_t i, struct dm_frame *cell, int *faces)
+{
+	uint32_t facewidth, faceheight;
+	uint32_t dicewidth = 0, diceheight = 0;
+	bool cardfound = dm_image_size(context->files.array[i], &facewidth, &faceheight, context->scale_shift);
+	bool dicefound = context->showdicecount &&
+		dm_image_size(context->dice.array[i], &dicewidth, &diceheight, context->scale_shift);
+
+	if (!cardfound) {
+		facewidth = DM_PLACEHOLDER_CX >> context->scale_shift;
+		faceheight = DM_PLACEHOLDER_CY >> context->scale_shift;
+	}
+	*faces = 1;
+	if (facewidth > faceheight) {
+		facewidth /= 2;
+		*faces = 2;
+	}
+
+	cell->facewidth = facewidth;
+	cell->faceheight = faceheight;
+	cell->cx = facewidth;
+	cell->cy = faceheight;
+	if (context->showdicecount) {
+		if (dicewidth > cell->cx)
+			cell->cx = dicewidth;
+		cell->cy += dicefound ? diceheight : DM_PLACEHOLDER_DICE_CY >> context->scale_shift;
+	}
+	return cardfound && (!context->showdicecount || dicefound);
+}
+
+//draws one face and its strip into its cell, in the graphics context.  clear
+//is for a cell something else was drawn in that the new face may not cover.
+static void dm_source_draw_frame(struct dm_source *context, const struct dm_frame *frame, bool clear)
+{
+	struct dm_image *card = dm_source_image(context, context->files.array[frame->card]);
+	struct dm_image *strip = NULL;
+	if (context->showdicecount)
+		strip = dm_source_image(context, context->dice.array[frame->card]);
+
+	if (clear && (frame->facewidth < frame->cx ||
+			(frame->faceheight < frame->cy &&
+			 (!strip || strip->cx < frame->cx || frame->faceheight + strip->cy < frame->cy))))
+		dm_source_clear_region(context, context->atlas, frame->x, frame->y, frame->cx, frame->cy);
+	if (card)
+		dm_copy_texture_region(context->atlas, frame->x, frame->y, dm_image_face(card, frame->face),
+				0, 0, frame->facewidth, frame->faceheight);
+	else {
+		gs_texture_t *placeholder = dm_create_placeholder(frame->facewidth, frame->faceheight);
+		dm_copy_texture_region(context->atlas, frame->x, frame->y, placeholder,
+				0, 0, frame->facewidth, frame->faceheight);
+		gs_texture_destroy(placeholder);
+	}
+	if (strip)
+		dm_copy_texture_region(context->atlas, frame->x, frame->y + frame->faceheight,
+				dm_image_face(strip, 0), 0, 0, strip->cx, strip->cy);
+
+	dm_image_release(card);
+	dm_image_release(strip);
+}
+
+//packs every face of every card, each with its dice strip underneath, into
+//one texture so cycling is just a change of sub-rectangle.  returns false if
+//the team doesn't fit, the caller then falls back to per-card textures.
+static bool dm_source_build_atlas(struct dm_source *context)
+{
+	size_t count = context->files.num;
+	uint32_t atlaswidth = 0;
+	uint32_t atlasheight = 0;
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t rowheight = 0;
+	bool fits = true;
+
+	dm_source_retire_atlas(context);
+	context->placeholder_shown = false;
+	if (count < 1)
+		return true;
+
+	//shelf pack the cells left to right, top to bottom, using header sizes
+	for (size_t i = 0; i < count && fits; i++) {
+		struct dm_frame cell;
+		int faces;
+		if (!dm_source_atlas_cell(context, i, &cell, &faces))
+			context->placeholder_shown = true;
+		uint32_t cellwidth = cell.cx;
+		uint32_t cellheight = cell.cy;
+
+		for (int face = 0; face < faces; face++) {
+			if (x + cellwidth > DM_ATLAS_MAX_SIZE) {
+				x = 0;
+				y += rowheight;
+				rowheight = 0;
+			}
+			if (cellwidth > DM_ATLAS_MAX_SIZE || y + cellheight > DM_ATLAS_MAX_SIZE) {
+				fits = false;
+				break;
+			}
+
+			struct dm_frame *frame = da_push_back_new(context->frames);
+			frame->card = i;
+			frame->face = face;
+			frame->x = x;
+			frame->y = y;
+			frame->cx = cellwidth;
+			frame->cy = cellheight;
+			frame->facewidth = cell.facewidth;
+			frame->faceheight = cell.faceheight;
+
+			x += cellwidth;
+			if (cellheight > rowheight)
+				rowheight = cellheight;
+			if (x > atlaswidth)
+				atlaswidth = x;
+			if (y + rowheight > atlasheight)
+				atlasheight = y + rowheight;
+		}
+	}
+
+	if (fits) {
+		dm_enter_graphics();
+		context->atlas = dm_source_take_spare(&context->spare_atlas, atlaswidth, atlasheight);
+		bool reused = context->atlas != NULL;
+		if (!reused)
+			context->atlas = dm_texture_create_gdi(atlaswidth, atlasheight);
+		//the last team's cells may show around a narrow face or strip
+		for (size_t f = 0; f < context->frames.num; f++)
+			dm_source_draw_frame(context, &context->frames.array[f], reused);
+		dm_leave_graphics();
+
+		if (context->currentFrame >= context->frames.num)
+			context->currentFrame = 0;
+		dm_source_show_frame(context);
+	}
+	else {
+		da_resize(context->frames, 0);
+		context->placeholder_shown = false;
+	}
+	return fits;
+}
+
+/* ------------------------------------------------------------------------- */
+/* cycle cards prefetch buffers, used when the team doesn't go in an atlas   */
+
+static void dm_source_clear_buffer(struct dm_buffer *buffer)
+{
+	dm_image_release(buffer->image);
+	dm_image_release(buffer->dice);
+	buffer->image = NULL;
+	buffer->dice = NULL;
+	if (buffer->blank) {
+		dm_enter_graphics();
+		gs_texture_destroy(buffer->blank);
+		dm_leave_graphics();
+		buffer->blank = NULL;
+	}
+}
+
+static void dm_source_free_buffers(struct dm_source *context)
+{
+	for (int i = 0; i < 2; i++)
+		dm_source_clear_buffer(&context->buffers[i]);
+	context->back_ready = false;
+	context->prefetch_due = false;
+}
+
+//requests a card whose file is gone, counted as waiting so the prefetches
+//until it lands don't ask again
+static void dm_source_refetch_card(struct dm_source *context, size_t card)
+{
+	struct dstr url = { 0 };
+	const char *path = context->files.array[card];
+
+	if (card >= context->team.num || dm_disk_exists(path))
+		return;
+
+	warn("card '%s' is missing from the cache, fetching it again", path);
+	dm_source_card_url(context, &context->team.array[card], &url);
+	dm_source_request(context, url.array, path, false);
+	context->fetch_generation = dm_fetch_generation();
+	context->waiting++;
+	dstr_free(&url);
+}
+
+//gets one face of a card and its dice strip resident for the buffer.  the
+//new images are acquired before the old ones are let go so a flip to the
+//other face of the same card never touches the cache.
+static void dm_source_prepare_buffer(struct dm_source *context, struct dm_buffer *buffer, size_t card, int face)
+{
+	profile_start(dm_profile_buffer);
+	struct dm_image *image = dm_source_card_image(context, context->files.array[card]);
+	struct dm_image *dice = NULL;
+	if (context->showdicecount)
+		dice = dm_source_image(context, context->dice.array[card]);
+	dm_source_clear_buffer(buffer);
+
+	uint32_t facewidth = image ? image->facewidth : DM_PLACEHOLDER_CX >> context->scale_shift;
+	uint32_t faceheight = image ? image->cy : DM_PLACEHOLDER_CY >> context->scale_shift;
+	bool flip = image && image->faces == 2;
+	if (!flip)
+		face = 0;
+
+	uint32_t cx = facewidth;
+	uint32_t cy = faceheight;
+	if (context->showdicecount) {
+		uint32_t dicewidth = dice ? dice->cx : facewidth;
+		if (dicewidth > cx)
+			cx = dicewidth;
+		cy += dice ? dice->cy : DM_PLACEHOLDER_DICE_CY >> context->scale_shift;
+	}
+
+	dm_enter_graphics();
+	if (image)
+		dm_image_face(image, face);
+	else
+		buffer->blank = dm_create_placeholder(facewidth, faceheight);
+	if (dice)
+		dm_image_face(dice, 0);
+	dm_leave_graphics();
+
+	buffer->image = image;
+	buffer->dice = dice;
+	buffer->card = card;
+	buffer->face = face;
+	buffer->flip = flip;
+	buffer->facewidth = facewidth;
+	buffer->faceheight = faceheight;
+	buffer->cx = cx;
+	buffer->cy = cy;
+	buffer->placeholder = !image || (context->showdicecount && !dice);
+	profile_end(dm_profile_buffer);
+
+	//a missing card is normal while it downloads, otherwise it went
+	//missing from the cache since and only it is fetched again
+	if (!image && context->waiting == 0)
+		dm_source_refetch_card(context, card);
+}
+
+static void dm_source_render_buffer(struct dm_source *context, gs_effect_t *effect)
+{
+	struct dm_buffer *front = &context->buffers[context->front];
+	gs_eparam_t *param = gs_effect_get_param_by_name(effect, "image");
+	gs_texture_t *face = front->image ? front->image->textures[front->face] : front->blank;
+
+	//compressed faces are padded out to whole blocks, only the card is drawn
+	if (face) {
+		gs_effect_set_texture(param, face);
+		gs_draw_sprite_subregion(face, 0, 0, 0, front->facewidth, front->faceheight);
+	}
+	if (front->dice && front->dice->textures[0]) {
+		gs_matrix_push();
+		gs_matrix_translate3f(0.0f, (float)front->faceheight, 0.0f);
+		gs_effect_set_texture(param, front->dice->textures[0]);
+		gs_draw_sprite(front->dice->textures[0], 0, front->dice->cx, front->dice->cy);
+		gs_matrix_pop();
+	}
+}
+
+static void dm_source_show_buffer(struct dm_source *context)
+{
+	struct dm_buffer *front = &context->buffers[context->front];
+	context->width = front->cx;
+	context->height = front->cy;
+	context->placeholder_shown = front->placeholder;
+}
+
+//decodes and uploads whatever follows the card on screen into the back buffer
+static void dm_source_prefetch(struct dm_source *context)
+{
+	struct dm_buffer *front = &context->buffers[context->front];
+	struct dm_buffer *back = &context->buffers[context->front ^ 1];
+	size_t card = front->card;
+	int face = 0;
+
+	if (front->flip && front->face == 0 && card < context->files.num)
+		face = 1;
+	else
+		card = (card + 1) % context->files.num;
+
+	dm_source_prepare_buffer(context, back, card, face);
+	context->back_ready = true;
+	context->prefetch_due = false;
+}
+
+//the card change itself is only a swap, the next prefetch waits a tick so it
+//doesn't land on the same frame
+static void dm_source_swap_buffers(struct dm_source *context)
+{
+	if (context->files.num < 1)
+		return;
+	if (!context->back_ready)
+		dm_source_prefetch(context);
+
+	context->front ^= 1;
+	context->back_ready = false;
+	context->prefetch_due = true;
+	dm_source_show_buffer(context);
+}
+
+//which face of a flip card the composed views show this step
+static inline int dm_source_slot_face(const struct dm_source *context, const struct dm_slot *slot)
+{
+	return slot->flip && context->currentIndex % 2 == 0 ? 1 : 0;
+}
+
+static void dm_source_release_slot_images(struct dm_source *context)
+{
+	for (size_t i = 0; i < context->slotcards.num; i++)
+		dm_image_release(context->slotcards.array[i]);
+	for (size_t i = 0; i < context->slotdice.num; i++)
+		dm_image_release(context->slotdice.array[i]);
+	da_resize(context->slotcards, 0);
+	da_resize(context->slotdice, 0);
+
+	if (context->placeholder) {
+		dm_enter_graphics();
+		gs_texture_destroy(context->placeholder);
+		context->placeholder = NULL;
+		dm_leave_graphics();
+	}
+}
+
+static void dm_source_render_direct(struct dm_source *context, gs_effect_t *effect)
+{
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	//the two are swapped in together, this only guards against a table
+	//that was reset without its images
+	size_t count = context->slots.num < context->slotcards.num ? context->slots.num : context->slotcards.num;
+
+	for (size_t i = 0; i < count; i++) {
+		struct dm_slot *slot = &context->slots.array[i];
+		struct dm_image *card = context->slotcards.array[i];
+		struct dm_image *dice = context->slotdice.array[i];
+
+		gs_matrix_push();
+		gs_matrix_translate3f((float)slot->x, (float)slot->y, 0.0f);
+		if (card && card->textures[0]) {
+			gs_texture_t *face = card->textures[dm_source_slot_face(context, slot)];
+			gs_effect_set_texture(image, face);
+			gs_draw_sprite_subregion(face, 0, 0, 0, card->facewidth, card->cy);
+		}
+		else if (context->placeholder) {
+			gs_effect_set_texture(image, context->placeholder);
+			gs_draw_sprite(context->placeholder, 0, slot->cx, slot->cy);
+		}
+		gs_matrix_pop();
+
+		if (dice && dice->textures[0]) {
+			gs_matrix_push();
+			gs_matrix_translate3f((float)slot->dicex, (float)slot->dicey, 0.0f);
+			gs_effect_set_texture(image, dice->textures[0]);
+			gs_draw_sprite_subregion(dice->textures[0], 0, 0, 0, dm_slot_dice_width(slot, dice), dice->cy);
+			gs_matrix_pop();
+		}
+	}
+}
+
+//turns every flip card in the composed view over by copying its other face
+//into its slot, nothing else in the combo texture is touched
+static void dm_source_refresh_flips(struct dm_source *context)
+{
+	dm_enter_graphics();
+	for (size_t i = 0; i < context->flipslots.num; i++) {
+		struct dm_slot *slot = &context->slots.array[context->flipslots.array[i]];
+		struct dm_image *card = dm_source_image(context, context->files.array[slot->card]);
+		if (!card)
+			continue;
+
+		dm_copy_texture_region(context->comboTexture, slot->x, slot->y,
+				dm_image_face(card, dm_source_slot_face(context, slot)), 0, 0, card->facewidth, card->cy);
+		dm_image_release(card);
+	}
+	dm_leave_graphics();
+}
+
+//largest power of two a view of width x height can shrink by and still have
+//a pixel for every canvas pixel when the source is fitted to the canvas
+static int dm_output_shift(uint32_t width, uint32_t height)
+{
+	struct obs_video_info ovi;
+	int shift = 0;
+
+	if (!width || !height || !obs_get_video_info(&ovi))
+		return 0;
+
+	double scale = (double)ovi.base_width / width;
+	if ((double)ovi.base_height / height < scale)
+		scale = (double)ovi.base_height / height;
+	while (shift < DM_SCALE_MAX_SHIFT && scale * (double)(2 << shift) <= 1.0)
+		shift++;
+	return shift;
+}
+
+/* ------------------------------------------------------------------------- */
+/* amortized rebuilds of the composed views                                  */
+
+/*
+ * A Playmat or Creator rebuild is tens of probes, decodes, uploads and copies,
+ * far more than fits in one frame.  updateTextures only starts one, and
+ * dm_source_rebuild_run then takes it a step at a time until the frame's
+ * budget is spent, picking up where it left off on the next tick.  Card art
+ * is decoded on the decoder threads as soon as the slots are laid out, a
+ * step waiting on a decode ends the tick's share rather than blocking it.
+ * The old composite stays on screen, with the slot table it was drawn for,
+ * until the new one is complete and everything is swapped in at once.  A
+ * restart doesn't lose much, finished decodes and uploads stay in the image
+ * cache.
+ */
+
+#define DM_REBUILD_DEFAULT_BUDGET_MS 4
+
+static void dm_swap_darray(struct darray *a, struct darray *b)
+{
+	struct darray tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+static void dm_decode_job_release(struct dm_decode_job *job)
+{
+	if (!job || os_atomic_dec_long(&job->refs) > 0)
+		return;
+	dm_image_release(job->image);
+	os_event_destroy(job->done);
+	bfree(job->path);
+	bfree(job);
+}
+
+static void dm_decode_job_run(void *param)
+{
+	struct dm_decode_job *job = param;
+	uint64_t start = os_gettime_ns();
+	job->image = dm_image_acquire(job->path, job->shift, job->compressed, &job->hit);
+	job->ns = os_gettime_ns() - start;
+	os_event_signal(job->done);
+	dm_decode_job_release(job);
+}
+
+static void dm_source_release_jobs(struct dm_rebuild *r)
+{
+	for (size_t i = 0; i < r->jobs.num; i++)
+		dm_decode_job_release(r->jobs.array[i]);
+	da_resize(r->jobs, 0);
+}
+
+//queues a decode of every slot's card, slots showing the same card share one
+static void dm_source_rebuild_queue(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+	bool compressed = dm_source_card_compressed(context);
+
+	for (size_t i = 0; i < r->slots.num; i++) {
+		const char *path = context->files.array[r->slots.array[i].card];
+		struct dm_decode_job *job = NULL;
+		for (size_t j = 0; j < i && !job; j++)
+			if (strcmp(r->jobs.array[j]->path, path) == 0)
+				job = r->jobs.array[j];
+		if (job) {
+			os_atomic_inc_long(&job->refs);
+			da_push_back(r->jobs, &job);
+			continue;
+		}
+
+		job = bzalloc(sizeof(struct dm_decode_job));
+		job->path = bstrdup(path);
+		job->shift = context->scale_shift;
+		job->compressed = compressed;
+		job->refs = 2;
+		os_event_init(&job->done, OS_EVENT_TYPE_MANUAL);
+		da_push_back(r->jobs, &job);
+		dm_decoders_queue(dm_decode_job_run, job);
+	}
+}
+
+static void dm_source_cancel_rebuild(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+
+	//a decode still running lets go of its job when it's done
+	dm_source_release_jobs(r);
+	dm_image_release(r->card);
+	dm_image_release(r->dice);
+	r->card = NULL;
+	r->dice = NULL;
+	for (size_t i = 0; i < r->slotcards.num; i++)
+		dm_image_release(r->slotcards.array[i]);
+	for (size_t i = 0; i < r->slotdice.num; i++)
+		dm_image_release(r->slotdice.array[i]);
+	da_resize(r->slotcards, 0);
+	da_resize(r->slotdice, 0);
+	da_resize(r->flipslots, 0);
+
+	if (r->texture || r->placeholder) {
+		dm_enter_graphics();
+		//whatever it had drawn is blanked slot by slot when it's reused
+		if (r->texture && !context->spare_combo) {
+			dm_source_retire_texture(context, &context->spare_combo, r->texture);
+			context->spare_key = r->key;
+		}
+		else if (r->texture)
+			gs_texture_destroy(r->texture);
+		if (r->placeholder)
+			gs_texture_destroy(r->placeholder);
+		dm_leave_graphics();
+		r->texture = NULL;
+		r->placeholder = NULL;
+	}
+	r->stage = DM_REBUILD_IDLE;
+}
+
+static void dm_source_free_rebuild(struct dm_source *context)
+{
+	dm_source_cancel_rebuild(context);
+	da_free(context->rebuild.jobs);
+	da_free(context->rebuild.slots);
+	da_free(context->rebuild.flipslots);
+	da_free(context->rebuild.slotcards);
+	da_free(context->rebuild.slotdice);
+}
+
+//sizes come from the file headers, cards are only decoded when composed
+static void dm_source_rebuild_probe(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+
+	if (r->next < context->files.num) {
+		uint32_t cx, cy;
+		if (dm_image_size(context->files.array[r->next++], &cx, &cy, 0)) {
+			if (cy > r->maxheight)
+				r->maxheight = cy;
+			//check for flip card
+			if (cx > cy) {
+				cx /= 2;
+				context->hasFlipCard = true;
+			}
+			if (cx > r->maxwidth)
+				r->maxwidth = cx;
+		}
+		return;
+	}
+
+	//nothing downloaded yet, lay out placeholders at the usual card size
+	if (r->maxheight == 0)
+		r->maxheight = DM_PLACEHOLDER_CY;
+	if (r->maxwidth == 0)
+		r->maxwidth = DM_PLACEHOLDER_CX;
+
+	r->diceheight = 0;
+	if (context->showdicecount) {
+		uint32_t dicewidth;
+		if (!dm_image_size(context->dice.array[0], &dicewidth, &r->diceheight, 0))
+			r->diceheight = DM_PLACEHOLDER_DICE_CY;
+	}
+	r->stage = DM_REBUILD_LAYOUT;
+}
+
+//compiles the new slot table into the rebuild, the one on screen stays put
+static void dm_source_rebuild_layout(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+
+	//lay out at full size first to see how much of it the canvas can show
+	context->scale_shift = 0;
+	if (context->scaletooutput) {
+		dm_source_compile_layout(context, r->maxwidth, r->maxheight, r->diceheight);
+		context->scale_shift = dm_output_shift(r->width, r->height);
+		r->maxwidth >>= context->scale_shift;
+		r->maxheight >>= context->scale_shift;
+		r->diceheight >>= context->scale_shift;
+	}
+	dm_source_compile_layout(context, r->maxwidth, r->maxheight, r->diceheight);
+
+	dm_enter_graphics();
+	r->reused = false;
+	if (!context->directrender) {
+		//the last team's texture if it was laid out the same, only its
+		//slots are drawn over
+		if (dm_layout_key_equal(&context->spare_key, &r->key))
+			r->texture = dm_source_take_spare(&context->spare_combo, r->width, r->height);
+		r->reused = r->texture != NULL;
+		if (!r->reused)
+			r->texture = dm_texture_create_gdi(r->width, r->height);
+	}
+	dm_leave_graphics();
+
+	dm_source_rebuild_queue(context);
+	r->next = 0;
+	r->index = context->currentIndex;
+	r->stage = r->slots.num ? DM_REBUILD_DECODE : DM_REBUILD_SWAP;
+}
+
+//takes the slot's card from its decode, false if that hasn't finished and
+//wait isn't set
+static bool dm_source_rebuild_decode(struct dm_source *context, bool wait)
+{
+	struct dm_rebuild *r = &context->rebuild;
+	struct dm_slot *slot = &r->slots.array[r->next];
+	struct dm_decode_job *job = r->jobs.array[r->next];
+
+	if (wait)
+		os_event_wait(job->done);
+	else if (os_event_try(job->done) != 0)
+		return false;
+
+	r->card = dm_image_addref(job->image);
+	//counted as if the slot had looked it up itself
+	if (job->counted && job->image) {
+		context->stats.hits++;
+	}
+	else if (job->hit) {
+		context->stats.hits++;
+	}
+	else if (job->image) {
+		context->stats.misses++;
+		context->stats.decode_ns += job->ns;
+	}
+	job->counted = true;
+	//every card with the same count shares one rendered strip
+	if (context->showdicecount)
+		r->dice = dm_source_image(context, context->dice.array[slot->card]);
+
+	slot->flip = r->card && r->card->faces == 2;
+	if (slot->flip)
+		da_push_back(r->flipslots, &r->next);
+	r->stage = DM_REBUILD_UPLOAD;
+	return true;
+}
+
+static void dm_source_rebuild_upload(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+
+	dm_enter_graphics();
+	dm_image_face(r->card, 0);
+	dm_image_face(r->dice, 0);
+	dm_leave_graphics();
+	r->stage = DM_REBUILD_COPY;
+}
+
+static void dm_source_rebuild_copy(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+	struct dm_slot *slot = &r->slots.array[r->next];
+
+	//only made once a card turns out to be missing
+	if (!r->card && !r->placeholder) {
+		dm_enter_graphics();
+		r->placeholder = dm_create_placeholder(r->maxwidth, r->maxheight);
+		dm_leave_graphics();
+	}
+
+	if (context->directrender) {
+		//direct render draws from the slot's images, it only keeps them
+		da_push_back(r->slotcards, &r->card);
+		da_push_back(r->slotdice, &r->dice);
+	}
+	else {
+		dm_enter_graphics();
+		//the last team's slot may show around a smaller card or strip
+		bool bare = r->card && (r->card->facewidth < slot->cx || r->card->cy < slot->cy);
+		if (r->diceheight)
+			bare |= !r->dice || r->dice->cy < r->diceheight || dm_slot_dice_width(slot, r->dice) < slot->cx;
+		if (r->reused && bare)
+			dm_source_clear_region(context, r->texture, slot->x, slot->y, slot->cx, slot->cy + r->diceheight);
+		if (r->card) {
+			dm_copy_texture_region(r->texture, slot->x, slot->y,
+					dm_image_face(r->card, dm_source_slot_face(context, slot)), 0, 0, r->card->facewidth, r->card->cy);
+		}
+		else {
+			dm_copy_texture_region(r->texture, slot->x, slot->y, r->placeholder, 0, 0, slot->cx, slot->cy);
+		}
+		if (r->dice)
+			dm_copy_texture_region(r->texture, slot->dicex, slot->dicey, dm_image_face(r->dice, 0), 0, 0,
+					dm_slot_dice_width(slot, r->dice), r->dice->cy);
+		dm_leave_graphics();
+		dm_image_release(r->card);
+		dm_image_release(r->dice);
+	}
+	r->card = NULL;
+	r->dice = NULL;
+
+	r->next++;
+	r->stage = r->next < r->slots.num ? DM_REBUILD_DECODE : DM_REBUILD_SWAP;
+}
+
+//puts the finished view on screen in place of the old one
+static void dm_source_rebuild_swap(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+	size_t sprites = 0;
+
+	dm_source_release_slot_images(context);
+	dm_enter_graphics();
+	if (context->comboTexture) {
+		dm_source_retire_texture(context, &context->spare_combo, context->comboTexture);
+		context->spare_key = context->layout_key;
+	}
+	context->comboTexture = r->texture;
+	r->texture = NULL;
+	if (context->directrender) {
+		//only drawn for slots whose card hasn't downloaded yet
+		context->placeholder = r->placeholder;
+		r->placeholder = NULL;
+	}
+	else if (r->placeholder) {
+		gs_texture_destroy(r->placeholder);
+		r->placeholder = NULL;
+	}
+	dm_leave_graphics();
+
+	dm_source_release_jobs(r);
+	dm_swap_darray(&r->slots.da, &context->slots.da);
+	context->layout_key = r->key;
+	dm_swap_darray(&r->flipslots.da, &context->flipslots.da);
+	dm_swap_darray(&r->slotcards.da, &context->slotcards.da);
+	dm_swap_darray(&r->slotdice.da, &context->slotdice.da);
+	da_resize(r->flipslots, 0);
+	da_resize(r->slotcards, 0);
+	da_resize(r->slotdice, 0);
+	context->width = r->width;
+	context->height = r->height;
+	r->stage = DM_REBUILD_IDLE;
+
+	//flips that came due while it was being built
+	if (context->comboTexture && context->flipslots.num && context->currentIndex != r->index)
+		dm_source_refresh_flips(context);
+
+	for (size_t i = 0; i < context->slotcards.num; i++)
+		sprites += 1 + (context->slotdice.array[i] != NULL);
+	if (context->directrender)
+		debug("direct render: %zu sprites per frame, no %ux%u combo texture (%.1f MB)",
+				sprites, context->width, context->height,
+				(double)context->width * context->height * 4 / (1024.0 * 1024.0));
+	else
+		debug("combo texture: 1 sprite per frame, %ux%u (%.1f MB)",
+				context->width, context->height,
+				(double)context->width * context->height * 4 / (1024.0 * 1024.0));
+	debug("rebuilt %zu slots over %u ticks in %llu us", context->slots.num, r->ticks,
+			(unsigned long long)((os_gettime_ns() - r->start) / 1000));
+}
+
+//false if the step is waiting on a decode and wait isn't set
+static bool dm_source_rebuild_step(struct dm_source *context, bool wait)
+{
+	struct dm_rebuild *r = &context->rebuild;
+	const char *scope = context->directrender ? dm_profile_direct : dm_profile_compose;
+	bool done = true;
+
+	switch (r->stage) {
+	case DM_REBUILD_PROBE:
+		profile_start(dm_profile_probe);
+		dm_source_rebuild_probe(context);
+		profile_end(dm_profile_probe);
+		break;
+	case DM_REBUILD_LAYOUT:
+		profile_start(dm_profile_layout);
+		dm_source_rebuild_layout(context);
+		profile_end(dm_profile_layout);
+		break;
+	case DM_REBUILD_DECODE:
+		profile_start(scope);
+		done = dm_source_rebuild_decode(context, wait);
+		profile_end(scope);
+		break;
+	case DM_REBUILD_UPLOAD:
+		profile_start(scope);
+		dm_source_rebuild_upload(context);
+		profile_end(scope);
+		break;
+	case DM_REBUILD_COPY:
+		profile_start(scope);
+		dm_source_rebuild_copy(context);
+		profile_end(scope);
+		break;
+	case DM_REBUILD_SWAP:
+		dm_source_rebuild_swap(context);
+		break;
+	case DM_REBUILD_IDLE:
+		break;
+	}
+	return done;
+}
+
+//runs rebuild steps until the budget is spent or one is waiting on a
+//decode, always at least one so it gets somewhere.  a budget of 0 waits
+//for the decodes and finishes it in one go.
+static void dm_source_rebuild_run(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+	uint64_t start = os_gettime_ns();
+
+	if (r->stage == DM_REBUILD_IDLE)
+		return;
+
+	profile_start(dm_profile_rebuild);
+	r->ticks++;
+	do {
+		if (!dm_source_rebuild_step(context, !context->rebuild_budget_ns))
+			break;
+	} while (r->stage != DM_REBUILD_IDLE &&
+		 (!context->rebuild_budget_ns || os_gettime_ns() - start < context->rebuild_budget_ns));
+	profile_end(dm_profile_rebuild);
+}
+
+static void dm_source_start_rebuild(struct dm_source *context)
+{
+	struct dm_rebuild *r = &context->rebuild;
+
+	dm_source_cancel_rebuild(context);
+	r->next = 0;
+	r->maxwidth = 0;
+	r->maxheight = 0;
+	r->ticks = 0;
+	r->start = os_gettime_ns();
+	r->stage = DM_REBUILD_PROBE;
+}
+
+void updateTextures(struct dm_source *context) {
+	profile_start(dm_profile_textures);
+	context->hasFlipCard = false;
+	dm_source_cancel_rebuild(context);
+	if (context->layout)
+	{
+		if (context->files.num < 1) {
+			dm_enter_graphics();
+			if (context->comboTexture != NULL) {
+				gs_texture_destroy(context->comboTexture);
+				context->comboTexture = NULL;
+			}
+			dm_leave_graphics();
+			da_resize(context->flipslots, 0);
+			dm_source_release_slot_images(context);
+			goto done;
+		}
+
+		//the old view stays on screen while the tick builds the new one
+		dm_source_start_rebuild(context);
+		dm_source_rebuild_run(context);
+	}
+	else{
+		//left over from one of the composed views
+		if (context->comboTexture != NULL) {
+			dm_enter_graphics();
+			gs_texture_destroy(context->comboTexture);
+			context->comboTexture = NULL;
+			dm_leave_graphics();
+		}
+		dm_source_release_slot_images(context);
+		if (context->files.num < 1)
+			goto done;
+
+		//cycled cards are sized from the first one
+		context->scale_shift = 0;
+		if (context->scaletooutput) {
+			uint32_t cx = DM_PLACEHOLDER_CX;
+			uint32_t cy = DM_PLACEHOLDER_CY;
+			uint32_t dicewidth, diceheight = 0;
+			dm_image_size(context->files.array[0], &cx, &cy, 0);
+			if (cx > cy)
+				cx /= 2;
+			if (context->showdicecount &&
+			    !dm_image_size(context->dice.array[0], &dicewidth, &diceheight, 0))
+				diceheight = DM_PLACEHOLDER_DICE_CY;
+			context->scale_shift = dm_output_shift(cx, cy + diceheight);
+		}
+
+		if (context->cycleatlas && !context->atlas_unfit) {
+			profile_start(dm_profile_atlas);
+			bool fits = dm_source_build_atlas(context);
+			profile_end(dm_profile_atlas);
+			if (fits)
+				goto done;
+			//don't try again until the team changes
+			context->atlas_unfit = true;
+		}
+		//no atlas, keep the card on screen and the next one in a pair of buffers
+		struct dm_buffer *front = &context->buffers[context->front];
+		size_t card = front->card;
+		int face = front->face;
+		if (card >= context->files.num) {
+			card = 0;
+			face = 0;
+		}
+		dm_source_prepare_buffer(context, front, card, face);
+		dm_source_show_buffer(context);
+		context->back_ready = false;
+		context->prefetch_due = true;
+	}
+
+done:
+	profile_end(dm_profile_textures);
+}
+
+/* ------------------------------------------------------------------------- */
+/* tournament teams                                                          */
+
+/*
+ * A source can hold a list of named teams, one per line as
+ * "<name>: <team builder string>", and show one of them at a time.  Every
+ * card of every team is kept decoded and uploaded through the shared image
+ * cache, one reference per unique path, so teams that share cards don't
+ * cost anything extra and switching only recomposes from resident textures.
+ * Hotkeys run on their own thread, they only count presses and the tick
+ * does the switch.
+ */
+
+static void dm_source_load(struct dm_source *context);
+
+static void dm_source_free_teams(struct dm_source *context)
+{
+	for (size_t i = 0; i < context->teams.num; i++) {
+		bfree(context->teams.array[i].name);
+		bfree(context->teams.array[i].tbstring);
+	}
+	da_resize(context->teams, 0);
+}
+
+static void dm_source_parse_teams(struct dm_source *context, const char *text)
+{
+	dm_source_free_teams(context);
+
+	const char *line = text;
+	while (line && *line) {
+		const char *end = strchr(line, '\n');
+		size_t len = end ? (size_t)(end - line) : strlen(line);
+		while (len && dm_is_space(line[len - 1]))
+			len--;
+		while (len && dm_is_space(*line)) {
+			line++;
+			len--;
+		}
+
+		if (len && context->teams.num == DM_TOURNAMENT_MAX_TEAMS) {
+			warn("only the first %d teams are used", DM_TOURNAMENT_MAX_TEAMS);
+			break;
+		}
+		if (len) {
+			struct dm_team_entry team = { 0 };
+			//links have "://" but never ": ", so that splits off the name
+			const char *split = NULL;
+			for (size_t i = 0; i + 1 < len && !split; i++)
+				if (line[i] == ':' && line[i + 1] == ' ')
+					split = line + i;
+			if (split) {
+				const char *value = split + 2;
+				team.name = bstrdup_n(line, split - line);
+				team.tbstring = bstrdup_n(value, len - (value - line));
+			}
+			else {
+				struct dstr name = { 0 };
+				dstr_printf(&name, "Team %zu", context->teams.num + 1);
+				team.name = name.array;
+				team.tbstring = bstrdup_n(line, len);
+			}
+			da_push_back(context->teams, &team);
+		}
+		line = end ? end + 1 : NULL;
+	}
+}
+
+//the teams setting as it's written in the properties, for storing changes
+static void dm_source_format_teams(struct dm_source *context, struct dstr *out)
+{
+	dstr_copy(out, "");
+	for (size_t i = 0; i < context->teams.num; i++)
+		dstr_catf(out, "%s%s: %s", i ? "\n" : "", context->teams.array[i].name,
+				context->teams.array[i].tbstring);
+}
+
+static void dm_source_release_preload(struct dm_source *context)
+{
+	for (size_t i = 0; i < context->preload_images.num; i++) {
+		dm_image_release(context->preload_images.array[i]);
+		context->preload_images.array[i] = NULL;
+	}
+	context->preload_next = 0;
+}
+
+static void dm_source_free_preload(struct dm_source *context)
+{
+	dm_source_release_preload(context);
+	for (size_t i = 0; i < context->preload_paths.num; i++)
+		bfree(context->preload_paths.array[i]);
+	da_resize(context->preload_paths, 0);
+	da_resize(context->preload_images, 0);
+}
+
+//lists every unique card and dice strip path of every team, requesting
+//downloads for any that are missing.  nothing is decoded here, the tick
+//does that a few at a time.
+static void dm_source_preload_teams(struct dm_source *context)
+{
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS];
+
+	dm_source_free_preload(context);
+	if (!context->teams.num || !context->imagefolder)
+		return;
+
+	for (size_t t = 0; t < context->teams.num; t++) {
+		size_t count = dm_parse_team(context->teams.array[t].tbstring, cards, DM_TEAM_MAX_CARDS);
+		for (size_t i = 0; i < count; i++) {
+			char *paths[2];
+			dm_source_card_paths(context, &cards[i], &paths[0], &paths[1]);
+			for (int p = 0; p < 2; p++) {
+				bool found = false;
+				for (size_t j = 0; j < context->preload_paths.num && !found; j++)
+					found = strcmp(context->preload_paths.array[j], paths[p]) == 0;
+				if (found) {
+					bfree(paths[p]);
+					continue;
+				}
+				struct dm_image *none = NULL;
+				da_push_back(context->preload_paths, &paths[p]);
+				da_push_back(context->preload_images, &none);
+			}
+		}
+	}
+	context->preload_shift = context->scale_shift;
+	context->preload_generation = dm_fetch_generation();
+	debug("preloading %zu unique images for %zu teams",
+			context->preload_paths.num, context->teams.num);
+}
+
+//decodes and uploads preloaded images until the budget is spent.  whatever
+//hadn't downloaded yet is retried once the worker has finished something.
+static void dm_source_preload_run(struct dm_source *context, uint64_t start)
+{
+	if (!context->preload_paths.num)
+		return;
+
+	//variants are per scale, a rescaled view needs the other set
+	if (context->preload_shift != context->scale_shift) {
+		dm_source_release_preload(context);
+		context->preload_shift = context->scale_shift;
+	}
+	if (context->preload_next >= context->preload_paths.num) {
+		if (context->preload_generation == dm_fetch_generation())
+			return;
+		context->preload_generation = dm_fetch_generation();
+		context->preload_next = 0;
+	}
+
+	while (context->preload_next < context->preload_paths.num) {
+		size_t i = context->preload_next++;
+		if (context->preload_images.array[i])
+			continue;
+
+		const char *path = context->preload_paths.array[i];
+		if (!dm_is_glyph_strip(path) && !dm_disk_exists(path))
+			continue;
+
+		struct dm_image *image = dm_source_card_image(context, path);
+		if (image) {
+			dm_enter_graphics();
+			dm_image_face(image, 0);
+			dm_leave_graphics();
+		}
+		context->preload_images.array[i] = image;
+
+		if (context->rebuild_budget_ns && os_gettime_ns() - start >= context->rebuild_budget_ns)
+			break;
+	}
+}
+
+//the team builder string the source shows, the active team's in tournament mode
+static const char *dm_source_active_tbstring(struct dm_source *context, const char *tbstring)
+{
+	if (!context->teams.num)
+		return tbstring;
+	if (context->activeteam >= context->teams.num)
+		context->activeteam = context->teams.num - 1;
+	return context->teams.array[context->activeteam].tbstring;
+}
+
+//shows another team, its cards are already resident so this is a parse and
+//a recompose.  the choice reaches the properties when dm_source_save runs.
+static void dm_source_switch_team(struct dm_source *context, size_t team)
+{
+	if (team >= context->teams.num || team == context->activeteam)
+		return;
+
+	pthread_mutex_lock(&context->team_mutex);
+	context->activeteam = team;
+	bfree(context->tbstring);
+	context->tbstring = bstrdup(context->teams.array[team].tbstring);
+	pthread_mutex_unlock(&context->team_mutex);
+	info("switching to team '%s'", context->teams.array[team].name);
 
-	DWORD dwBytesWritten = 0;
-	WriteFile(hFile, (LPSTR)&bmfHeader, sizeof(BITMAPFILEHEADER), &dwBytesWritten, NULL);
-	WriteFile(hFile, (LPSTR)&bi, sizeof(BITMAPINFOHEADER), &dwBytesWritten, NULL);
-	WriteFile(hFile, (LPSTR)lpBitmap, dwBmpSize, &dwBytesWritten, NULL);
+	struct dm_gfx_counts start;
+	dm_gfx_snapshot(&start);
+	dm_source_load(context);
+	dm_gfx_log(context, "switch team", &start);
+}
 
-	//Unlock and Free the DIB from the heap
-	GlobalUnlock(hDIB);
-	GlobalFree(hDIB);
+static void dm_source_take_team_step(struct dm_source *context)
+{
+	long step = os_atomic_set_long(&context->team_next, 0) - os_atomic_set_long(&context->team_prev, 0);
+	long count = (long)context->teams.num;
+	if (!step || !count)
+		return;
+	long team = ((long)context->activeteam + step % count + count) % count;
+	dm_source_switch_team(context, (size_t)team);
+}
 
-	//Close the handle for the file that was created
-	CloseHandle(hFile);
+static void dm_source_next_team_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+	struct dm_source *context = data;
+	//the tick takes the press, the hotkey thread mustn't touch the team list
+	if (pressed)
+		os_atomic_inc_long(&context->team_next);
+}
 
-	//SelectObject(hMemDC, hOldBrush);
-	SelectObject(hDC, hOldFont);
-	SelectObject(hDC, hOldBitmap);
+static void dm_source_prev_team_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+	struct dm_source *context = data;
+	if (pressed)
+		os_atomic_inc_long(&context->team_prev);
+}
 
-	//DeleteObject(hBrush);
-	DeleteObject(hFont);
-	DeleteObject(hBitmap);
-	DeleteDC(hMemDC);
+/* ------------------------------------------------------------------------- */
+/* live team control file                                                    */
 
-	ReleaseDC(NULL, hDC);
+/*
+ * A local script changes the team mid-match by rewriting a json control
+ * file, for example
+ *
+ *   {"seq": 7, "deltas": [
+ *       {"op": "dice", "card": 3, "dice": 2},
+ *       {"op": "swap", "card": 5, "code": "2x12abc"}]}
+ *
+ * Cards are numbered from 1 in team order.  "dice" sets a card's dice count
+ * and "swap" replaces the card with a team builder token.  The file is read
+ * and parsed on the task queue twice a second, the tick only applies what a
+ * read found.  Deltas are applied once per change of contents, or
+ * once per higher seq when it has one, so a writer can repeat a delta by
+ * bumping seq.  Only the slots showing a changed card are redrawn, and the
+ * team builder string setting is rewritten to match.
+ */
 
-	return true;
-}
+#define DM_CONTROL_POLL_INTERVAL 0.5f
 
-size_t callbackfunction(void *ptr, size_t size, size_t nmemb, void* userdata)
+//one control file, read on the task queue.  a read in progress holds a
+//reference, so the source can let go of it at any time.
+struct dm_control {
+	volatile long refs;
+	char *path;
+	volatile bool reading;
+	//only touched by the reads, which never overlap
+	char *text;
+	long long seq;
+	//deltas read but not applied yet, taken by the tick
+	pthread_mutex_t mutex;
+	obs_data_array_t *ready;
+};
+
+static struct dm_control *dm_control_create(const char *path)
 {
-	FILE* stream = (FILE*)userdata;
-	if (!stream)
-	{
-		printf("!!! No stream\n");
-		return 0;
+	struct dm_control *control = bzalloc(sizeof(struct dm_control));
+	if (pthread_mutex_init(&control->mutex, NULL) != 0) {
+		bfree(control);
+		return NULL;
 	}
+	control->refs = 1;
+	control->path = bstrdup(path);
+	control->seq = -1;
+	return control;
+}
 
-	size_t written = fwrite((FILE*)ptr, size, nmemb, stream);
-	return written;
+static void dm_control_release(struct dm_control *control)
+{
+	if (!control || os_atomic_dec_long(&control->refs) > 0)
+		return;
+	obs_data_array_release(control->ready);
+	pthread_mutex_destroy(&control->mutex);
+	bfree(control->path);
+	bfree(control->text);
+	bfree(control);
 }
 
-bool download_jpeg(char* url, char* destination)
+//queues the deltas for the tick, after any it hasn't taken yet
+static void dm_control_push(struct dm_control *control, obs_data_array_t *deltas)
 {
-	FILE* fp = fopen(destination, "wb");
-	if (!fp)
-	{
-		printf("!!! Failed to create file on the disk\n");
-		return false;
+	pthread_mutex_lock(&control->mutex);
+	if (!control->ready) {
+		control->ready = deltas;
+		deltas = NULL;
+	}
+	else {
+		size_t count = obs_data_array_count(deltas);
+		for (size_t i = 0; i < count; i++) {
+			obs_data_t *delta = obs_data_array_item(deltas, i);
+			obs_data_array_push_back(control->ready, delta);
+			obs_data_release(delta);
+		}
 	}
+	pthread_mutex_unlock(&control->mutex);
+	obs_data_array_release(deltas);
+}
 
-	CURL* curlCtx = curl_easy_init();
-	curl_easy_setopt(curlCtx, CURLOPT_URL, url);
-	curl_easy_setopt(curlCtx, CURLOPT_WRITEDATA, fp);
-	curl_easy_setopt(curlCtx, CURLOPT_WRITEFUNCTION, callbackfunction);
-	curl_easy_setopt(curlCtx, CURLOPT_FOLLOWLOCATION, 1);
+//the task: reads and parses the file, the deltas of a change are queued
+static void dm_control_read(void *param)
+{
+	struct dm_control *control = param;
 
-	CURLcode rc = curl_easy_perform(curlCtx);
-	if (rc)
-	{
-		printf("!!! Failed to download: %s\n", url);
-		return false;
-	}
+	//compared by contents, file times are too coarse for a fast writer
+	char *text = os_quick_read_utf8_file(control->path);
+	if (text && (!control->text || strcmp(text, control->text) != 0)) {
+		bfree(control->text);
+		control->text = text;
+		text = NULL;
 
-	long res_code = 0;
-	curl_easy_getinfo(curlCtx, CURLINFO_RESPONSE_CODE, &res_code);
-	if (!((res_code == 200 || res_code == 201) && rc != CURLE_ABORTED_BY_CALLBACK))
-	{
-		printf("!!! Response code: %d\n", res_code);
-		return false;
+		obs_data_t *data = obs_data_create_from_json(control->text);
+		bool fresh = data != NULL;
+		if (!data)
+			module_log(LOG_WARNING, "control: '%s' isn't valid json", control->path);
+		else if (obs_data_has_user_value(data, "seq")) {
+			long long seq = obs_data_get_int(data, "seq");
+			fresh = seq > control->seq;
+			if (fresh)
+				control->seq = seq;
+		}
+		if (fresh)
+			dm_control_push(control, obs_data_get_array(data, "deltas"));
+		obs_data_release(data);
 	}
 
-	curl_easy_cleanup(curlCtx);
+	bfree(text);
+	os_atomic_set_bool(&control->reading, false);
+	dm_control_release(control);
+}
 
-	fclose(fp);
+//redraws card i's cells in the atlas, returns false if it needs a repack
+//because the card is a placeholder or its cells would change size
+static bool dm_source_refresh_atlas(struct dm_source *context, size_t i)
+{
+	struct dm_frame cell;
+	int faces;
+	if (!dm_source_atlas_cell(context, i, &cell, &faces))
+		return false;
+
+	int found = 0;
+	for (size_t f = 0; f < context->frames.num; f++) {
+		struct dm_frame *frame = &context->frames.array[f];
+		if (frame->card != i)
+			continue;
+		if (frame->cx != cell.cx || frame->cy != cell.cy ||
+		    frame->facewidth != cell.facewidth || frame->faceheight != cell.faceheight)
+			return false;
+		found++;
+	}
+	if (found != faces)
+		return false;
 
+	dm_enter_graphics();
+	for (size_t f = 0; f < context->frames.num; f++)
+		if (context->frames.array[f].card == i)
+			dm_source_draw_frame(context, &context->frames.array[f], true);
+	dm_leave_graphics();
 	return true;
 }
 
-bool updateFileList(struct dm_source *context)
+//redraws whatever shows card i after its image or dice strip changed
+static void dm_source_refresh_card(struct dm_source *context, size_t i)
 {
-	bool updated = false;
-	char *tbstring = context->tbstring;
-	int fileCount = context->files.num;
-	if (fileCount > 0) {
-		darray_erase_range(sizeof(context->files), &context->files.da, 0, fileCount);
-		darray_erase_range(sizeof(context->dice), &context->dice.da, 0, fileCount);
-	}
-
-	int status = mkdir(context->imagefolder);
-
-	if (tbstring && *tbstring) {
-		debug("loading texture '%s'", tbstring);
-		int i = 0;
-		char *token;
-
-		const char s[2] = ";";
-		const char e[2] = "=";
-		int count = 0;
-		int ecount = 0;
-		for (int j = 0; j < strlen(tbstring); j++) {
-			if (tbstring[j] == ';') count++;
-			else if (tbstring[j] == '=') ecount++;
-		}
-
-		struct dstr dcardlist = { 0 };
-		//copy the list so we don't alter it
-		dstr_copy(&dcardlist, tbstring);
-		if (ecount > 0) {
-			char* cardsString = dstr_find(&dcardlist, e);
-			dstr_copy(&dcardlist, "");
-			for (int t = 1; t < strlen(cardsString); t++) {
-				if (cardsString[t] == '&')
-					break;
-				dstr_cat_ch(&dcardlist, cardsString[t]);
+	if (!context->layout) {
+		//redrawn in its own cells if they're still the right size, a new
+		//dice count always is since every strip of a height is the same size
+		if (context->atlas) {
+			if (!dm_source_refresh_atlas(context, i)) {
+				dm_source_free_atlas(context);
+				updateTextures(context);
 			}
+			return;
+		}
+		struct dm_buffer *front = &context->buffers[context->front];
+		if (front->card == i && (front->image || front->blank)) {
+			dm_source_prepare_buffer(context, front, i, front->face);
+			dm_source_show_buffer(context);
 		}
-		token = strtok(dcardlist.array, s);
+		//the card in the back buffer may be the old one
+		context->back_ready = false;
+		context->prefetch_due = true;
+		return;
+	}
 
-		while (token != NULL)
-		{
-			struct dstr dcard = { 0 };
-			struct dstr dpath = { 0 };
-			struct dstr dice = { 0 };
-			char* folderpath = context->imagefolder;
-			dstr_copy(&dpath, folderpath);
-			dstr_cat_ch(&dpath, '/');
-			//dstr_copy(&dice, "Dice: ");
-			dstr_cat_ch(&dice, token[0]);
+	//the slot table on screen isn't the one being built, start over
+	bool direct = context->directrender && context->slotcards.num == context->slots.num;
+	if (context->rebuild.stage != DM_REBUILD_IDLE || (!direct && !context->comboTexture)) {
+		updateTextures(context);
+		return;
+	}
 
-			for (int c = 2; c < strlen(token); c++) {
-				dstr_cat_ch(&dcard, token[c]);
-			}
-			dstr_cat(&dpath, dcard.array);
-			dstr_cat(&dpath, ".jpg");
+	struct dm_image *card = dm_source_card_image(context, context->files.array[i]);
+	struct dm_image *dice = NULL;
+	if (context->showdicecount)
+		dice = dm_source_image(context, context->dice.array[i]);
 
-			da_push_back(context->files, &dpath.array);
+	//a card of another size would move the layout, only a rebuild can do that
+	for (size_t j = 0; j < context->slots.num; j++) {
+		struct dm_slot *slot = &context->slots.array[j];
+		if (slot->card == i && card && (card->facewidth != slot->cx || card->cy != slot->cy)) {
+			dm_image_release(card);
+			dm_image_release(dice);
+			updateTextures(context);
+			return;
+		}
+	}
 
-			//downlaod files if they don't exist
-			FILE* fp = fopen(dpath.array, "r");
-			if (fp) {
-				fclose(fp);
-			}
-			else {
-				struct dstr url = { 0 };
-				int cnum;
-				char set[10];
-				if (dcard.array != NULL) {
-					sscanf(dcard.array, "%d%s", &cnum, set);
-					//todo can we regex  the check set
-					char* buffer;
-					if (strlen(set) < 8) {
-						dstr_copy(&url, "http://dicecoalition.com/cardservice/Image.php?set=");
-						dstr_cat(&url, set);
-						dstr_cat(&url, "&cardnum=");
-						char numString[5];
-						if (cnum > 0 && cnum < 1000) {
-							itoa(cnum, numString, 10);
-							dstr_cat(&url, numString);
-							dstr_cat(&url, "&res=l");
-							download_jpeg(url.array, dpath.array);
-						}
-
-					}
-				}
-				dstr_free(&url);
-			}
-			//create Dice text BMP if it doesn't exist
-			struct dstr diceImage = { 0 };
-			dstr_copy(&diceImage, folderpath);
-			dstr_cat_ch(&diceImage, '/');
-			dstr_cat(&diceImage, "Dice");
-			dstr_cat(&diceImage, dice.array);
-			dstr_cat(&diceImage, ".jpg");
-			FILE* fpdice = fopen(diceImage.array, "r");
-			if (fpdice) {
-				fclose(fpdice);
-			}
-			else {
-				struct dstr diceurl = { 0 };
-				int cnum;
-				char set[10];
-				if (dice.array != NULL) {
-					dstr_copy(&diceurl, "http://dicecoalition.com/cardservice/Cards/Dice");
-					dstr_cat(&diceurl, dice.array);
-					dstr_cat(&diceurl, ".jpg");
-					download_jpeg(diceurl.array, diceImage.array);
-				}
-				//TODO: Was trying to generate image on the fly.  Let's just download one instead
-				/*
-				struct dstr diceText = { 0 };
-				dstr_copy(&diceText, "Dice: ");
-				dstr_cat(&diceText, dice.array);
-				const WCHAR fileName[100];
-				int nChars = MultiByteToWideChar(CP_ACP, 0, diceImage.array, -1, NULL, 0);
-				MultiByteToWideChar(CP_ACP, 0, diceImage.array, -1, (LPWSTR)fileName, nChars);
-				const WCHAR diceString[10];
-				nChars = MultiByteToWideChar(CP_ACP, 0, diceText.array, -1, NULL, 0);
-				MultiByteToWideChar(CP_ACP, 0, diceText.array, -1, (LPWSTR)diceString, nChars);
+	dm_enter_graphics();
+	for (size_t j = 0; j < context->slots.num; j++) {
+		struct dm_slot *slot = &context->slots.array[j];
+		if (slot->card != i)
+			continue;
 
-				ConvertCharToBitmap(fileName, diceString, 368, 50, 40);
-				*/
-				dstr_free(&diceurl);
-			}
+		slot->flip = card && card->faces == 2;
+		if (card)
+			dm_image_face(card, dm_source_slot_face(context, slot));
+		if (dice)
+			dm_image_face(dice, 0);
+
+		if (direct) {
+			if (!card && !context->placeholder)
+				context->placeholder = dm_create_placeholder(slot->cx, slot->cy);
+			dm_image_release(context->slotcards.array[j]);
+			dm_image_release(context->slotdice.array[j]);
+			//the slot holds its own references
+			context->slotcards.array[j] = dm_source_card_image(context, context->files.array[i]);
+			context->slotdice.array[j] = dice ? dm_source_image(context, context->dice.array[i]) : NULL;
+			continue;
+		}
 
-			da_push_back(context->dice, &diceImage.array);
-			//dstr_free(&diceImage);
-			//dstr_free(&dcard);
-			//dstr_free(&dpath);
-			//dstr_free(&dice);
-			i++;
-			token = strtok(NULL, s);
+		if (card) {
+			dm_copy_texture_region(context->comboTexture, slot->x, slot->y,
+					dm_image_face(card, dm_source_slot_face(context, slot)), 0, 0, card->facewidth, card->cy);
 		}
-		updated = true;
+		else {
+			gs_texture_t *placeholder = dm_create_placeholder(slot->cx, slot->cy);
+			dm_copy_texture_region(context->comboTexture, slot->x, slot->y, placeholder, 0, 0, slot->cx, slot->cy);
+			gs_texture_destroy(placeholder);
+		}
+		if (dice)
+			dm_copy_texture_region(context->comboTexture, slot->dicex, slot->dicey, dm_image_face(dice, 0), 0, 0,
+					dm_slot_dice_width(slot, dice), dice->cy);
 	}
-	return updated;
+	dm_leave_graphics();
+	dm_image_release(card);
+	dm_image_release(dice);
 
+	da_resize(context->flipslots, 0);
+	for (size_t j = 0; j < context->slots.num; j++)
+		if (context->slots.array[j].flip)
+			da_push_back(context->flipslots, &j);
+	context->hasFlipCard = context->flipslots.num > 0;
 }
 
-void updateTextures(struct dm_source *context) {
-	context->hasFlipCard = false;
-	static bool flipcard = false;
-	if (strcmp(context->format, "Cycle Cards") != 0)//context->useplaymatlayout || context->usecreatorview)
-	{		
-		obs_enter_graphics();
-		gs_image_file_free(&context->image);
-		gs_image_file_free(&context->diceimage);
-		if (context->comboTexture != NULL) {
-			gs_texture_destroy(context->comboTexture);
-			context->comboTexture = NULL;
+//applies one delta to the team, returns true if a card changed
+static bool dm_source_apply_delta(struct dm_source *context, obs_data_t *delta)
+{
+	const char *op = obs_data_get_string(delta, "op");
+	long long index = obs_data_get_int(delta, "card");
+	if (index < 1 || (size_t)index > context->team.num) {
+		warn("control: the team has no card %lld", index);
+		return false;
+	}
+
+	size_t i = (size_t)index - 1;
+	struct dm_team_card card = context->team.array[i];
+	if (strcmp(op, "dice") == 0) {
+		long long dice = obs_data_get_int(delta, "dice");
+		if (dice < 0 || dice > UINT8_MAX) {
+			warn("control: bad dice count %lld for card %lld", dice, index);
+			return false;
 		}
-		obs_leave_graphics();
-
-		int maxheight = 0;
-		int maxwidth = 0;
-		obs_enter_graphics();
-		for (int i = 0; i < context->files.num; i++)
-		{
-			char* file = context->files.array[i];
-			gs_image_file_init(&context->image, file);
-			
-			if (context->image.cy > maxheight)
-				maxheight = context->image.cy;
-			int width = context->image.cx;
-			//check for flip card
-			if (context->image.cx > context->image.cy) {
-				width = width / 2;
-				context->hasFlipCard = true;
-			}
-			if (width > maxwidth)
-				maxwidth = width;
-			
-			gs_image_file_free(&context->image);
-		}
-
-		obs_leave_graphics();
-		char* file = context->files.array[0];
-		gs_image_file_init(&context->image, file);
-
-		obs_enter_graphics();
-		gs_image_file_init_texture(&context->image);
-		obs_leave_graphics();
-
-		obs_enter_graphics();
-		uint32_t diceheight = 0;
-		if (context->showdicecount)
-		{
-			gs_image_file_init(&context->diceimage, context->dice.array[0]);
-
-			obs_enter_graphics();
-			gs_image_file_init_texture(&context->diceimage);
-			obs_leave_graphics();
-			diceheight = context->diceimage.cy;			
-		}
-		//uint32_t height = context->image.cy * 3;
-		uint32_t height = maxheight + diceheight;
-		uint32_t width = maxwidth * 10 + context->cardmargins * 9;
-		
-
-		if (context->useplaymatlayout) {
-			height = maxheight * 3;
-			height += diceheight * 3;
-			width = height / 0.5625;
-			height += (context->cardmargins * 3);			
-			width += (context->cardmargins * 4);
-		}
-		else if (context->usecreatorview) {
-			height = maxheight * 2 + context->cardmargins + diceheight * 2;
-			width = maxwidth * 5 + context->cardmargins * 4;
-		}
-		context->width = width;
-		context->height = height;
-		context->comboTexture = gs_texture_create_gdi(width, height);
-		uint32_t cardwidth = context->image.cx;
-		//check if this is a flip card
-		if (context->image.cx > context->image.cy)
-			cardwidth = cardwidth / 2;
-		uint32_t firstCardY = 0;
-		if (context->useplaymatlayout)
-			firstCardY = context->image.cy;
-		if (firstCardY != 0)
-			firstCardY += context->cardmargins;
-		gs_copy_texture_region(context->comboTexture, 0, firstCardY, context->image.texture, 0, 0, cardwidth, context->image.cy);
-		if (context->showdicecount)
-		{
-			gs_copy_texture_region(context->comboTexture, 0, firstCardY + context->image.cy, context->diceimage.texture, 0, 0, context->diceimage.cx, context->diceimage.cy);
-			gs_image_file_free(&context->diceimage);
-		}
-		
-		obs_leave_graphics();
-		for (int i = 1; i < context->files.num; i++)
-		{
-			file = context->files.array[i];
-			if (file == NULL)
-				warn("Image list is empty");
-			else {
-				
-				gs_image_file_t cardimage;
-				gs_image_file_init(&cardimage, file);
-
-				obs_enter_graphics();
-				gs_image_file_init_texture(&cardimage);
-				obs_leave_graphics();
-
-				uint32_t xloc = 0;
-				uint32_t yloc = 0;
-				cardwidth = cardimage.cx;
-				uint32_t cardheight = cardimage.cy;
-				if (cardimage.cx > cardimage.cy)
-					cardwidth = cardwidth / 2;
-				if (context->useplaymatlayout) {
-
-					//tried to get all clever with this but got to be a pain in the ass  with all the different cases...
-					// so now just 10 different if statements cause i'm a lazy POS.
-					if (i == 0) {
-						xloc = 0;
-						yloc = cardheight + context->cardmargins + diceheight;
-					}
-					else if (i == 1) {
-						xloc = cardwidth + context->cardmargins * 2;
-						yloc = cardheight + context->cardmargins + diceheight;
-					}
-					else if (i == 2) {
-						xloc = width - cardwidth * 2 - context->cardmargins * 2;
-						yloc = cardheight + context->cardmargins + diceheight;
-					}
-					else if (i == 3) {
-						xloc = width - cardwidth;
-						yloc = cardheight + context->cardmargins + diceheight;
-					}
-					else if (i == 4) {
-						xloc = 0;
-						yloc = cardheight *2 + context->cardmargins*2 + diceheight*2;
-					}
-					else if (i == 5) {
-						xloc = cardwidth + context->cardmargins * 2;
-						yloc = cardheight *2 + context->cardmargins * 2 + diceheight*2;
-					}
-					else if (i == 6) {
-						xloc = width - cardwidth * 2 - context->cardmargins * 2;
-						yloc = cardheight *2 + context->cardmargins * 2 + diceheight*2;
-					}
-					else if (i == 7) {
-						xloc = width - cardwidth;
-						yloc = cardheight * 2 + context->cardmargins * 2 + diceheight*2;
-					}
-					else if (i == 8) {
-						xloc = cardwidth + context->cardmargins * 2;
-						yloc = 0;
-					}
-					else if (i == 9) {
-						xloc = width - cardwidth * 2 - context->cardmargins * 2;
-						yloc = 0;
-					}
-					/*
-					else {
-						xloc = cardwidth * (i % 4);
-						if (i % 4 > 1)
-							xloc = width - (cardwidth + (cardwidth * (i % 2)));
-						yloc = cardimage.cy + (cardimage.cy * (i / 4));
-						if (xloc != 0) {
-							if (i % 4 > 1)
-								xloc -= (context->cardmargins * (i % 2));
-							else
-								xloc += (context->cardmargins * (i % 2));
-						}						
-					}
-					*/
-					
-						
-				}
-				else if (context->usecreatorview) {
-					xloc = (cardwidth) * (i % 5);
-					yloc = (cardimage.cy) * (i / 5);
-					if (xloc != 0 && xloc != cardwidth * 5)
-						xloc += (context->cardmargins * (i % 5));
-					if (yloc != 0)
-						yloc += context->cardmargins *(i / 5) + diceheight * (i/5);
-				}
-				else {
-					xloc = cardwidth * i + context->cardmargins*i;
-					yloc = 0;
-				}
-				//gs_copy_texture_region(context->comboTexture, 0, context->image.cy, context->image.texture, 0, 0, context->image.cx, context->image.cy);
-				obs_enter_graphics();
-				uint32_t srcxloc = 0;
-				if (cardimage.cx > cardimage.cy && context->currentIndex%2 == 0)
-					srcxloc = cardimage.cx / 2;
-				gs_copy_texture_region(context->comboTexture, xloc, yloc, cardimage.texture, srcxloc, 0, cardwidth, cardimage.cy);
-
-				gs_image_file_free(&cardimage);
-				obs_leave_graphics();
-				if (context->showdicecount)
-				{
-					gs_image_file_init(&context->diceimage, context->dice.array[i]);
-					if (!context->diceimage.loaded)
-						warn("failed to load texture '%s'", context->dice.array[0]);
-
-					obs_enter_graphics();
-					gs_image_file_init_texture(&context->diceimage);
-					obs_leave_graphics();
-
-					obs_enter_graphics();
-
-					gs_copy_texture_region(context->comboTexture, xloc, yloc+cardheight, context->diceimage.texture, 0, 0, context->diceimage.cx, context->diceimage.cy);
-					gs_image_file_free(&context->diceimage);
-					obs_leave_graphics();
-
-										
-				}
-			}
+		card.dice = (uint8_t)dice;
+	}
+	else if (strcmp(op, "swap") == 0) {
+		const char *code = obs_data_get_string(delta, "code");
+		if (dm_parse_team(code, &card, 1) != 1) {
+			warn("control: bad card '%s' for card %lld", code, index);
+			return false;
 		}
-		
 	}
-	else{
-		if (context->files.num < 1)
-			return;
-		char* file = context->files.array[context->currentIndex];
-		if (file == NULL)
-			warn("Image list is empty");
-		else {
-			obs_enter_graphics();
-			gs_image_file_free(&context->image);
-			gs_image_file_free(&context->diceimage);
-			if (context->comboTexture != NULL) {
-				gs_texture_destroy(context->comboTexture);
-				context->comboTexture = NULL;
-			}
-			obs_leave_graphics();
-			
-			gs_image_file_init(&context->image, file);
+	else {
+		warn("control: unknown op '%s'", op);
+		return false;
+	}
 
-			context->height = context->image.cy;
-			context->width = context->image.cx;
+	struct dm_team_card *old = &context->team.array[i];
+	if (card.dice == old->dice && card.number == old->number && strcmp(card.set, old->set) == 0)
+		return false;
 
-			obs_enter_graphics();
-			gs_image_file_init_texture(&context->image);
-			gs_texture_t * intermediateTexture;
-			if (context->width > context->height)	
-				intermediateTexture = gs_texture_create_gdi(context->width/2, context->height);
-			else
-				intermediateTexture = gs_texture_create_gdi(context->width, context->height);
-			obs_leave_graphics();
-			
-			//check for flip card and only draw one half of it
-			if (context->width > context->height) {
-				context->width = context->width / 2;
-				int xloc = 0;
-				if (!flipcard)
-					flipcard = true;
-				else {
-					xloc = context->width;
-					flipcard = false;
-				}				
-				obs_enter_graphics();
-				gs_copy_texture_region(intermediateTexture, 0, 0, context->image.texture, xloc, 0, context->width, context->height);
-				obs_leave_graphics();
-			}
-			else {
-				obs_enter_graphics();
-				gs_copy_texture_region(intermediateTexture, 0, 0, context->image.texture, 0, 0, context->width, context->height);
-				obs_leave_graphics();
-			}
-			if (!context->image.loaded) {
-				warn("failed to load texture '%s'", file);
-				//file list may of gotten corrupted by a bad update.  Try to re-parse
-				updateFileList(context);
-			}
-			if (context->showdicecount)
-			{
-				gs_image_file_init(&context->diceimage, context->dice.array[context->currentIndex]);
+	char *file;
+	char *dice;
+	*old = card;
+	dm_source_card_paths(context, &card, &file, &dice);
+	bfree(context->files.array[i]);
+	bfree(context->dice.array[i]);
+	context->files.array[i] = file;
+	context->dice.array[i] = dice;
+
+	debug("control: card %lld is now %ux%u%s", index, card.dice, card.number, card.set);
+	dm_source_refresh_card(context, i);
+	return true;
+}
 
-				obs_enter_graphics();
-				gs_image_file_init_texture(&context->diceimage);
-				obs_leave_graphics();
+//keeps the changed team as the team builder string, dm_source_save writes it
+//to the settings later so the video thread never touches them
+static void dm_source_store_team(struct dm_source *context)
+{
+	struct dstr str = { 0 };
+	dstr_copy(&str, "");
+	for (size_t i = 0; i < context->team.num; i++) {
+		struct dm_team_card *card = &context->team.array[i];
+		dstr_catf(&str, "%s%ux%u%s", i ? ";" : "", card->dice, card->number, card->set);
+	}
 
-				obs_enter_graphics();
+	pthread_mutex_lock(&context->team_mutex);
+	bfree(context->tbstring);
+	context->tbstring = str.array;
+	if (context->teams.num) {
+		//in tournament mode the change belongs to the active team's line
+		struct dm_team_entry *team = &context->teams.array[context->activeteam];
+		bfree(team->tbstring);
+		team->tbstring = bstrdup(context->tbstring);
+		dstr_init(&str);
+		dm_source_format_teams(context, &str);
+		bfree(context->teamstext);
+		context->teamstext = str.array;
+	}
+	pthread_mutex_unlock(&context->team_mutex);
+}
 
-				context->comboTexture = gs_texture_create_gdi(context->diceimage.cx, context->image.cy + context->diceimage.cy);
+static void dm_source_apply_deltas(struct dm_source *context, obs_data_array_t *deltas)
+{
+	struct dm_gfx_counts start;
+	dm_gfx_snapshot(&start);
+	profile_start(dm_profile_control);
+	size_t count = obs_data_array_count(deltas);
+	bool changed = false;
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *delta = obs_data_array_item(deltas, i);
+		changed |= dm_source_apply_delta(context, delta);
+		obs_data_release(delta);
+	}
+	obs_data_array_release(deltas);
 
-				gs_copy_texture_region(context->comboTexture, 0, 0, intermediateTexture, 0, 0, context->width, context->height);
-				gs_copy_texture_region(context->comboTexture, 0, context->height, context->diceimage.texture, 0, 0, context->diceimage.cx, context->diceimage.cy);
-				obs_leave_graphics();				
-				context->height += context->diceimage.cy;
-				
-				if (!context->diceimage.loaded)
-					warn("failed to load texture '%s'", context->dice.array[0]);
-			}
-			else {
-				obs_enter_graphics();
-				context->comboTexture = gs_texture_create_gdi(context->width, context->height);
-				gs_copy_texture_region(context->comboTexture, 0, 0, intermediateTexture, 0, 0, context->width, context->height);
-				obs_leave_graphics();
+	if (changed) {
+		dm_source_store_team(context);
+		context->fetch_generation = dm_fetch_generation();
+		context->waiting = dm_source_count_missing(context);
+	}
+	profile_end(dm_profile_control);
+	dm_gfx_log(context, "control", &start);
+}
 
-			}
-			obs_enter_graphics();
-			gs_texture_destroy(intermediateTexture);
-			obs_leave_graphics();
-		}
-		if (flipcard)
-			context->currentIndex--;
+//applies what the last read of the control file found and queues the next
+//read once it's due.  the file is never touched on the video thread.
+static void dm_source_poll_control(struct dm_source *context, float seconds)
+{
+	struct dm_control *control = context->control;
+	if (!control || !context->team.num)
+		return;
+
+	pthread_mutex_lock(&control->mutex);
+	obs_data_array_t *deltas = control->ready;
+	control->ready = NULL;
+	pthread_mutex_unlock(&control->mutex);
+	if (deltas)
+		dm_source_apply_deltas(context, deltas);
+
+	context->control_elapsed += seconds;
+	if (context->control_elapsed < DM_CONTROL_POLL_INTERVAL)
+		return;
+	context->control_elapsed = 0.0f;
+
+	//a slow read is let finish, the next one waits for it
+	if (!os_atomic_set_bool(&control->reading, true)) {
+		os_atomic_inc_long(&control->refs);
+		dm_tasks_queue(dm_control_read, control);
 	}
 }
 
+//live sources, the shared image cache is emptied when the last one goes
+static volatile long dm_source_count = 0;
+
 static const char *dm_source_get_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -650,74 +6655,265 @@ static const char *dm_source_get_name(void *unused)
 
 static void dm_source_load(struct dm_source *context)
 {
-	char *tbstring = context->tbstring;
 	context->currentIndex = 0;
-	obs_enter_graphics();
-	gs_image_file_free(&context->image);
-	gs_image_file_free(&context->diceimage);
-	obs_leave_graphics();
+	context->currentFrame = 0;
+	//the team or its layout may have changed, repack on the next rebuild
+	dm_source_retire_atlas(context);
+	context->atlas_unfit = false;
+	dm_source_free_buffers(context);
+	context->front = 0;
+	context->buffers[0].card = 0;
+	context->buffers[0].face = 0;
+
+	uint64_t start = os_gettime_ns();
+	long decoded = os_atomic_load_long(&dm_gfx.decodes);
+	long mapped = os_atomic_load_long(&dm_images.mapped);
 
 	bool updated = updateFileList(context);
 	if (updated) {
 		updateTextures(context);
 	}
 
+	debug("team loaded in %llu us, %ld cards decoded, %ld mapped from bundles",
+		(unsigned long long)((os_gettime_ns() - start) / 1000),
+		os_atomic_load_long(&dm_gfx.decodes) - decoded,
+		os_atomic_load_long(&dm_images.mapped) - mapped);
 }
 
 static void dm_source_unload(struct dm_source *context)
 {
-	obs_enter_graphics();
-	gs_image_file_free(&context->image);
-	gs_image_file_free(&context->diceimage);
+	dm_enter_graphics();
 	if (context->comboTexture != NULL) {		
 		gs_texture_destroy(context->comboTexture);
 		context->comboTexture = NULL;
 	}
-	obs_leave_graphics();
+	dm_leave_graphics();
+	dm_source_cancel_rebuild(context);
+	dm_source_free_atlas(context);
+	dm_source_free_spares(context);
+	dm_source_free_buffers(context);
+	dm_source_release_slot_images(context);
+	dm_source_release_preload(context);
+}
+
+//gpu memory this source would keep alive in standby
+static size_t dm_source_resident_bytes(struct dm_source *context)
+{
+	size_t bytes = 0;
+	dm_enter_graphics();
+	bytes += dm_texture_bytes(context->comboTexture);
+	bytes += dm_texture_bytes(context->atlas);
+	bytes += dm_texture_bytes(context->spare_combo);
+	bytes += dm_texture_bytes(context->spare_atlas);
+	bytes += dm_texture_bytes(context->zeros);
+	dm_leave_graphics();
+	for (int i = 0; i < 2; i++) {
+		if (context->buffers[i].image)
+			bytes += context->buffers[i].image->pixel_bytes;
+		if (context->buffers[i].dice)
+			bytes += context->buffers[i].dice->pixel_bytes;
+	}
+	for (size_t i = 0; i < context->slotcards.num; i++)
+		if (context->slotcards.array[i])
+			bytes += context->slotcards.array[i]->pixel_bytes;
+	for (size_t i = 0; i < context->slotdice.num; i++)
+		if (context->slotdice.array[i])
+			bytes += context->slotdice.array[i]->pixel_bytes;
+	for (size_t i = 0; i < context->preload_images.num; i++)
+		if (context->preload_images.array[i])
+			bytes += context->preload_images.array[i]->pixel_bytes;
+	return bytes;
+}
+
+//rebuilds the textures from the cards that are already parsed and cached,
+//for settings that change how the team is drawn but not what's in it
+static void dm_source_recompose(struct dm_source *context)
+{
+	dm_source_free_atlas(context);
+	context->atlas_unfit = false;
+	dm_source_free_buffers(context);
+	if (context->files.num)
+		updateTextures(context);
+}
+
+//keeps an owned copy of a string setting, returns true if it changed
+static bool dm_setting_changed(char **value, const char *setting)
+{
+	if (*value && strcmp(*value, setting) == 0)
+		return false;
+	bfree(*value);
+	*value = bstrdup(setting);
+	return true;
 }
 
 static void dm_source_update(void *data, obs_data_t *settings)
 {
 	struct dm_source *context = data;
-	char* tbstring = (char*)obs_data_get_string(settings, "tbstring");
-	char* imagefolder = (char*)obs_data_get_string(settings, "imagefolder");
+	const char* tbstring = obs_data_get_string(settings, "tbstring");
+	const char* imagefolder = obs_data_get_string(settings, "imagefolder");
 	uint32_t speed = (uint32_t)obs_data_get_int(settings, "speed");
 	bool dicecount = (bool)obs_data_get_bool(settings, "dicecount");
 	//bool playmat = (bool)obs_data_get_bool(settings, "useplaymat");
 	//bool creator = (bool)obs_data_get_bool(settings, "usecreatorview");
 	uint32_t margins = (uint32_t)obs_data_get_int(settings, "margins");
-	char* format = obs_data_get_string(settings, "format");
-	context->format = format;
-	context->imagefolder = imagefolder;
-	context->tbstring = tbstring;
+	const char* format = obs_data_get_string(settings, "format");
+	const char* cardservice = obs_data_get_string(settings, "cardservice");
+	uint32_t maxdownloads = (uint32_t)obs_data_get_int(settings, "maxdownloads");
+	uint32_t cachebudget = (uint32_t)obs_data_get_int(settings, "cachebudget");
+	uint32_t diskbudget = (uint32_t)obs_data_get_int(settings, "diskbudget");
+	bool cycleatlas = obs_data_get_bool(settings, "cycleatlas");
+	bool directrender = obs_data_get_bool(settings, "directrender");
+	bool scaletooutput = obs_data_get_bool(settings, "scaletooutput");
+	bool gpucompress = obs_data_get_bool(settings, "gpucompress");
+	const char* layoutfile = obs_data_get_string(settings, "layoutfile");
+	const char* controlfile = obs_data_get_string(settings, "controlfile");
+	uint32_t diceheight = (uint32_t)obs_data_get_int(settings, "dicesize");
+	uint32_t dicecolor = (uint32_t)obs_data_get_int(settings, "dicecolor");
+	uint32_t dicebackground = (uint32_t)obs_data_get_int(settings, "dicebackground");
+	bool dicebold = strcmp(obs_data_get_string(settings, "dicefont"), "Bold") == 0;
+	bool persistent = obs_data_get_bool(settings, "persistent");
+	uint32_t standbybudget = (uint32_t)obs_data_get_int(settings, "standbybudget");
+	uint32_t rebuildbudget = (uint32_t)obs_data_get_int(settings, "rebuildbudget");
+	const char* teams = obs_data_get_string(settings, "teams");
+	long long activeteam = obs_data_get_int(settings, "activeteam");
+
+	//the tick may have moved the team on since the settings were last
+	//saved, so only team settings the user changed since the last update
+	//replace what it's showing
+	bool teamschanged = dm_setting_changed(&context->settings_teams, teams);
+	bool userteam = dm_setting_changed(&context->settings_tbstring, tbstring);
+	pthread_mutex_lock(&context->team_mutex);
+	//a tournament team list takes the place of the team builder string
+	if (teamschanged && dm_setting_changed(&context->teamstext, teams))
+		dm_source_parse_teams(context, teams);
+	if (teamschanged || context->settings_activeteam != activeteam) {
+		context->settings_activeteam = activeteam;
+		context->activeteam = activeteam > 0 ? (size_t)activeteam - 1 : 0;
+	}
+	if (!context->teams.num && !userteam && !teamschanged && context->tbstring)
+		tbstring = context->tbstring;
+	else
+		tbstring = dm_source_active_tbstring(context, tbstring);
+
+	//only redo the stages a change actually affects: the team needs a
+	//re-parse (and downloads for new cards), the look needs a recompose
+	//from cached images, and speed is just the timer
+	bool reload = !context->loaded;
+	reload |= dm_setting_changed(&context->tbstring, tbstring);
+	pthread_mutex_unlock(&context->team_mutex);
+	reload |= dm_setting_changed(&context->imagefolder, imagefolder);
+	reload |= dm_setting_changed(&context->cardservice, cardservice);
+
+	bool recompose = dm_setting_changed(&context->format, format);
+	recompose |= dm_setting_changed(&context->layoutfile, layoutfile);
+	recompose |= context->showdicecount != dicecount;
+	recompose |= context->cycleatlas != cycleatlas;
+	recompose |= context->directrender != directrender;
+	recompose |= context->scaletooutput != scaletooutput;
+	recompose |= context->gpucompress != gpucompress;
+	recompose |= context->layout && context->cardmargins != margins;
+	bool restyle = context->dice_height != diceheight || context->dice_color != dicecolor ||
+		context->dice_background != dicebackground || context->dice_bold != dicebold;
+	recompose |= restyle;
+
+	dm_fetch_set_max_transfers(maxdownloads);
+	dm_images_set_budget(cachebudget);
+	dm_disk_set_budget(diskbudget);
 	context->speed = speed;
 	context->showdicecount = dicecount;
-	if (strcmp(format, "Cycle Cards") == 0) {
-		context->useplaymatlayout = false;
-		context->usecreatorview = false;
+	context->cycleatlas = cycleatlas;
+	context->directrender = directrender;
+	context->scaletooutput = scaletooutput;
+	context->gpucompress = gpucompress;
+	context->cardmargins = margins;
+	context->dice_height = diceheight;
+	context->dice_color = dicecolor;
+	context->dice_background = dicebackground;
+	context->dice_bold = dicebold;
+	context->persistent = persistent;
+	context->standby_budget = (size_t)standbybudget * 1024 * 1024;
+	context->rebuild_budget_ns = (uint64_t)rebuildbudget * 1000000;
+
+	//every team's cards are listed again for the new folder, service or style
+	if (teamschanged || reload || restyle)
+		dm_source_preload_teams(context);
+
+	//a new control file is read from scratch on the next poll
+	if (dm_setting_changed(&context->controlfile, controlfile)) {
+		dm_control_release(context->control);
+		context->control = *controlfile ? dm_control_create(controlfile) : NULL;
 	}
-	else if (strcmp(format, "Playmat View") == 0) {
-		context->useplaymatlayout = true;
-		context->usecreatorview = false;
+
+	//custom layouts are re-read when the file is edited
+	struct stat st;
+	time_t layoutmtime = 0;
+	bool custom = strcmp(format, "Custom Layout") == 0;
+	if (custom && os_stat(layoutfile, &st) == 0)
+		layoutmtime = st.st_mtime;
+	if (custom && layoutmtime != context->layout_mtime)
+		recompose = true;
+
+	if (context->standby && !persistent) {
+		context->standby = false;
+		context->standby_stale = false;
+		dm_source_unload(context);
 	}
-	else if(strcmp(format, "Creator View") == 0) {
-		context->useplaymatlayout = false;
-		context->usecreatorview = true;
+
+	//a hidden source in standby doesn't rebuild, the change is applied on show
+	if (context->standby && (recompose || reload)) {
+		context->standby_stale = true;
+		return;
 	}
-	else {
-		context->useplaymatlayout = false;
-		context->usecreatorview = false;
+
+	if (recompose || reload) {
+		//composed views get their slots from a layout, cycle cards has none
+		context->layout = NULL;
+		dm_layout_destroy(context->customlayout);
+		context->customlayout = NULL;
+		context->layout_mtime = layoutmtime;
+		if (custom) {
+			context->customlayout = dm_layout_load(layoutfile);
+			context->layout = context->customlayout;
+			if (!context->layout)
+				warn("failed to load layout '%s'", layoutfile);
+		}
+		else if (strcmp(format, "Cycle Cards") != 0) {
+			context->layout = dm_builtin_layout(format);
+		}
+		if (!context->layout && strcmp(format, "Cycle Cards") != 0)
+			context->layout = dm_builtin_layout("Horizontal Row");
+		//recompile the slot table on the next rebuild, the one on screen
+		//stays in use until it's swapped out
+		memset(&context->layout_key, 0, sizeof(context->layout_key));
 	}
-	//context->useplaymatlayout = playmat;
-	//context->usecreatorview = creator;
-	context->cardmargins = margins;
-	dm_source_load(data);
+
+	struct dm_gfx_counts start;
+	dm_gfx_snapshot(&start);
+	if (reload) {
+		context->loaded = true;
+		dm_source_load(data);
+	}
+	else if (recompose) {
+		if (restyle)
+			dm_source_restyle_dice(context);
+		dm_source_recompose(context);
+	}
+	dm_gfx_log(context, reload ? "reload" : "recompose", &start);
 }
 
 static void *dm_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct dm_source *context = bzalloc(sizeof(struct dm_source));
 	context->src = source;
+	context->stats.last_log = os_gettime_ns();
+	pthread_mutex_init(&context->stats.mutex, NULL);
+	pthread_mutex_init(&context->team_mutex, NULL);
+	os_atomic_inc_long(&dm_source_count);
+
+	obs_hotkey_register_source(source, "dm_source.next_team", obs_module_text("Next Team"),
+			dm_source_next_team_hotkey, context);
+	obs_hotkey_register_source(source, "dm_source.prev_team", obs_module_text("Previous Team"),
+			dm_source_prev_team_hotkey, context);
 
 	dm_source_update(context, settings);
 
@@ -728,8 +6924,44 @@ static void dm_source_destroy(void *data)
 {
 	struct dm_source *context = data;
 	dm_source_unload(context);
+	dm_source_free_rebuild(context);
+	dm_source_free_preload(context);
+	da_free(context->preload_paths);
+	da_free(context->preload_images);
+	dm_source_free_teams(context);
+	da_free(context->teams);
+	dm_source_clear_pending(context);
+	da_free(context->pending);
+	dm_source_free_file_list(context);
+	da_free(context->files);
+	da_free(context->dice);
+	da_free(context->team);
+	da_free(context->frames);
+	da_free(context->slots);
+	da_free(context->flipslots);
+	da_free(context->slotcards);
+	da_free(context->slotdice);
+	dm_source_free_fetching(context);
+	dm_layout_destroy(context->customlayout);
+	bfree(context->tbstring);
+	bfree(context->imagefolder);
+	bfree(context->format);
+	bfree(context->cardservice);
+	bfree(context->layoutfile);
+	bfree(context->controlfile);
+	dm_control_release(context->control);
+	bfree(context->teamstext);
+	bfree(context->settings_tbstring);
+	bfree(context->settings_teams);
+	pthread_mutex_destroy(&context->team_mutex);
+	pthread_mutex_destroy(&context->stats.mutex);
+	bfree(context->stats.snapshot);
 	if (context)
 		bfree(context);
+	if (os_atomic_dec_long(&dm_source_count) == 0) {
+		dm_images_purge();
+		dm_disk_flush();
+	}
 	/*
 	if (context->tbstring)
 		bfree(context->tbstring);
@@ -744,6 +6976,52 @@ static void dm_source_destroy(void *data)
 	//	bfree(context);
 }
 
+//checks every cached card of the team against the server
+static void dm_source_refresh_cached(struct dm_source *context)
+{
+	//damaged files are dropped first so they're fetched whole, not revalidated
+	for (size_t i = 0; i < context->files.num; i++) {
+		if (!dm_disk_verify(context->files.array[i]))
+			dm_disk_invalidate(context->files.array[i]);
+	}
+
+	//changed cards come back through the normal download path
+	context->revalidate = true;
+	updateFileList(context);
+	context->revalidate = false;
+}
+
+static bool dm_source_refresh_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	struct dm_source *context = data;
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+
+	//the file list belongs to the video thread, the next tick refreshes it
+	os_atomic_set_bool(&context->refresh_requested, true);
+	return false;
+}
+
+static bool dm_source_bundle_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	struct dm_source *context = data;
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+
+	dm_bundle_build(context->imagefolder);
+	return false;
+}
+
+static bool dm_source_encode_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	struct dm_source *context = data;
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+
+	dm_bc1_build(context->imagefolder);
+	return false;
+}
+
 static obs_properties_t *dm_source_properties(void *data)
 {
 	struct dm_source *s = data;
@@ -752,6 +7030,8 @@ static obs_properties_t *dm_source_properties(void *data)
 	obs_properties_t *props = obs_properties_create();
 
 	obs_properties_add_text(props, "tbstring", obs_module_text("Team Builder String"), OBS_TEXT_DEFAULT);
+	obs_properties_add_text(props, "teams", obs_module_text("Tournament Teams (One \"Name: Team\" Per Line)"), OBS_TEXT_MULTILINE);
+	obs_properties_add_int(props, "activeteam", obs_module_text("Active Team"), 1, DM_TOURNAMENT_MAX_TEAMS, 1);
 	obs_properties_add_path(props, "imagefolder", obs_module_text("Image Folder"), OBS_PATH_DIRECTORY, NULL, "c:/temp/cards");
 
 	obs_property_t *f = obs_properties_add_list(props, "format", obs_module_text("Display Format"), OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
@@ -759,14 +7039,50 @@ static obs_properties_t *dm_source_properties(void *data)
 	obs_property_list_add_string(f, "Playmat View", obs_module_text("Playmat View"));
 	obs_property_list_add_string(f, "Creator View", obs_module_text("Creator View"));
 	obs_property_list_add_string(f, "Horizontal Row", obs_module_text("Horizontal Row"));
+	obs_property_list_add_string(f, "Custom Layout", obs_module_text("Custom Layout"));
+	obs_properties_add_bool(props, "directrender", obs_module_text("Draw Cards Directly (No Combo Texture)"));
+	obs_properties_add_path(props, "layoutfile", obs_module_text("Layout File"), OBS_PATH_FILE, "Layout files (*.json)", NULL);
+	obs_properties_add_path(props, "controlfile", obs_module_text("Team Control File"), OBS_PATH_FILE, "Control files (*.json)", NULL);
 
 	obs_properties_add_int(props, "speed", obs_module_text("Cycle Speed (s)"), 0, 4096, 1);
 	obs_properties_add_bool(props, "dicecount", obs_module_text("Show Dice Count"));
+	obs_property_t *font = obs_properties_add_list(props, "dicefont", obs_module_text("Dice Count Weight"), OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(font, "Regular", obs_module_text("Regular"));
+	obs_property_list_add_string(font, "Bold", obs_module_text("Bold"));
+	obs_properties_add_int(props, "dicesize", obs_module_text("Dice Count Height"), 8, 256, 1);
+	obs_properties_add_color(props, "dicecolor", obs_module_text("Dice Count Color"));
+	obs_properties_add_color(props, "dicebackground", obs_module_text("Dice Count Background"));
+	obs_properties_add_bool(props, "cycleatlas", obs_module_text("Pack Cycle Cards Into Atlas"));
+	obs_properties_add_bool(props, "scaletooutput", obs_module_text("Downscale Cards To Canvas Size"));
+	obs_properties_add_bool(props, "gpucompress", obs_module_text("Compress Card Textures (BC1, Direct Render And Cycle Cards)"));
 	
 	//obs_properties_add_bool(props, "useplaymat", obs_module_text("Use Playmat Layout"));
 	//obs_properties_add_bool(props, "usecreatorview", obs_module_text("Use Creator View"));
 
 	obs_properties_add_int(props, "margins", obs_module_text("Card Margin"), 0, 1000, 1);
+	obs_properties_add_text(props, "cardservice", obs_module_text("Card Service URL"), OBS_TEXT_DEFAULT);
+	obs_properties_add_int(props, "maxdownloads", obs_module_text("Parallel Downloads"), 1, DM_FETCH_MAX_TRANSFERS, 1);
+	obs_properties_add_int(props, "cachebudget", obs_module_text("Image Cache Budget (MB)"), 16, 4096, 16);
+	obs_properties_add_int(props, "diskbudget", obs_module_text("Disk Cache Budget (MB, 0 = Unlimited)"), 0, 65536, 64);
+	obs_properties_add_int(props, "rebuildbudget", obs_module_text("Rebuild Time Per Frame (ms, 0 = All At Once)"), 0, 33, 1);
+	obs_properties_add_bool(props, "persistent", obs_module_text("Keep Loaded While Hidden"));
+	obs_properties_add_int(props, "standbybudget", obs_module_text("Hidden Memory Budget (MB)"), 1, 1024, 1);
+	obs_properties_add_button(props, "refresh", obs_module_text("Refresh Cached Cards"), dm_source_refresh_clicked);
+	obs_properties_add_button(props, "bundle", obs_module_text("Pack Cached Cards Into Bundles"), dm_source_bundle_clicked);
+	obs_properties_add_button(props, "encode", obs_module_text("Compress Cached Cards (BC1)"), dm_source_encode_clicked);
+
+	//an info line isn't saved with the settings, the text is the copy the
+	//video thread last made
+	struct dstr stats = { 0 };
+	dstr_copy(&stats, obs_module_text("Statistics"));
+	dstr_cat(&stats, ":\n");
+	if (s) {
+		pthread_mutex_lock(&s->stats.mutex);
+		dstr_cat(&stats, s->stats.snapshot ? s->stats.snapshot : obs_module_text("Not Shown Yet"));
+		pthread_mutex_unlock(&s->stats.mutex);
+	}
+	obs_properties_add_text(props, "stats", stats.array, OBS_TEXT_INFO);
+	dstr_free(&stats);
 
 	return props;
 }
@@ -775,33 +7091,30 @@ static void dm_source_render(void *data, gs_effect_t *effect)
 {
 	struct dm_source *context = data;
 
-	if (!context->image.texture)
+	if (context->atlas && context->frames.num) {
+		struct dm_frame *frame = &context->frames.array[context->currentFrame];
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+			context->atlas);
+		gs_draw_sprite_subregion(context->atlas, 0, frame->x, frame->y,
+			frame->cx, frame->cy);
 		return;
-	if (!context->useplaymatlayout && !context->usecreatorview) {
-		if (!context->showdicecount) {
-			gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-				context->comboTexture);
-			gs_draw_sprite(context->comboTexture, 0,
-				context->width, context->height);
-		}
-		else {
-			gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-				context->comboTexture);
-			gs_draw_sprite(context->comboTexture, 0,
-				context->width, context->height);
-		}
 	}
-	else
-	{
-		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
-			context->comboTexture);
-		//uint32_t width = context->image.cx * 4 + context->playmatgap;
-		//uint32_t height = context->image.cy * 3;
-		uint32_t height = context->height;
-		uint32_t width = context->width;
-		gs_draw_sprite(context->comboTexture, 0,
-			width, height);
+	if (strcmp(context->format, "Cycle Cards") == 0) {
+		dm_source_render_buffer(context, effect);
+		return;
 	}
+	//whichever kind of view was last swapped in, until a rebuild replaces it
+	if (context->layout && context->slotcards.num) {
+		dm_source_render_direct(context, effect);
+		return;
+	}
+	if (!context->comboTexture)
+		return;
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+		context->comboTexture);
+	gs_draw_sprite(context->comboTexture, 0,
+		context->width, context->height);
 }
 
 static uint32_t dm_source_getwidth(void *data)
@@ -846,25 +7159,77 @@ static void dm_source_defaults(obs_data_t *settings)
 	obs_data_set_default_string(settings, "imagefolder", "c:/temp/cards");
 	obs_data_set_default_int(settings, "speed", 10);
 	obs_data_set_default_bool(settings, "dicecount", false);
+	obs_data_set_default_string(settings, "dicefont", "Bold");
+	obs_data_set_default_int(settings, "dicesize", DM_DICE_DEFAULT_HEIGHT);
+	obs_data_set_default_int(settings, "dicecolor", DM_DICE_DEFAULT_COLOR);
+	obs_data_set_default_int(settings, "dicebackground", DM_DICE_DEFAULT_BACKGROUND);
+	obs_data_set_default_bool(settings, "cycleatlas", true);
+	obs_data_set_default_bool(settings, "directrender", false);
+	obs_data_set_default_bool(settings, "scaletooutput", false);
+	obs_data_set_default_bool(settings, "gpucompress", false);
 	//obs_data_set_default_bool(settings, "useplaymat", false);
 	//obs_data_set_default_bool(settings, "usecreatorview", false);
 	obs_data_set_default_int(settings, "margins", 0);
 	obs_data_set_default_string(settings, "format", "Cycle Cards");
+	obs_data_set_default_string(settings, "cardservice", DM_DEFAULT_CARDSERVICE);
+	obs_data_set_default_int(settings, "maxdownloads", DM_FETCH_DEFAULT_TRANSFERS);
+	obs_data_set_default_int(settings, "cachebudget", DM_IMAGE_DEFAULT_BUDGET_MB);
+	obs_data_set_default_int(settings, "diskbudget", DM_DISK_DEFAULT_BUDGET_MB);
+	obs_data_set_default_int(settings, "rebuildbudget", DM_REBUILD_DEFAULT_BUDGET_MS);
+	obs_data_set_default_int(settings, "activeteam", 1);
+	obs_data_set_default_bool(settings, "persistent", false);
+	obs_data_set_default_int(settings, "standbybudget", DM_STANDBY_DEFAULT_BUDGET_MB);
+}
+
+//libobs saves settings on the ui thread, the same one that applies the
+//properties, so the team the tick moved to is written back from here
+static void dm_source_save(void *data, obs_data_t *settings)
+{
+	struct dm_source *context = data;
+	pthread_mutex_lock(&context->team_mutex);
+	if (context->teams.num) {
+		obs_data_set_string(settings, "teams", context->teamstext);
+		obs_data_set_int(settings, "activeteam", (long long)context->activeteam + 1);
+	}
+	else if (context->tbstring) {
+		obs_data_set_string(settings, "tbstring", context->tbstring);
+	}
+	pthread_mutex_unlock(&context->team_mutex);
 }
 
 static void dm_source_show(void *data)
 {
 	struct dm_source *context = data;
 	context->visible = true;
-	//if (!context->persistent)
-	dm_source_load(context);
+	if (!context->standby) {
+		dm_source_load(context);
+		return;
+	}
+
+	//everything is still resident, only catch up on settings changed while hidden
+	context->standby = false;
+	if (context->standby_stale) {
+		context->standby_stale = false;
+		context->loaded = false;
+		obs_data_t *settings = obs_source_get_settings(context->src);
+		dm_source_update(context, settings);
+		obs_data_release(settings);
+	}
 }
 
 static void dm_source_hide(void *data)
 {
 	struct dm_source *context = data;
 	context->visible = false;
-	//if (!context->persistent)
+	if (context->persistent) {
+		size_t bytes = dm_source_resident_bytes(context);
+		if (bytes <= context->standby_budget) {
+			debug("keeping %zu bytes resident while hidden", bytes);
+			context->standby = true;
+			return;
+		}
+		debug("%zu bytes is over the standby budget, unloading", bytes);
+	}
 	dm_source_unload(context);
 }
 
@@ -873,19 +7238,83 @@ static void dm_source_tick(void *data, float seconds)
 	struct dm_source *context = data;
 	if (context->visible) {
 		uint64_t frame_time = obs_get_video_frame_time();
+		struct dm_gfx_counts start;
+		dm_gfx_snapshot(&start);
+		profile_start(dm_profile_tick);
+
+		if (os_atomic_set_bool(&context->refresh_requested, false))
+			dm_source_refresh_cached(context);
+
+		//swap in cards as the download worker finishes them
+		profile_start(dm_profile_downloads);
+		if (context->pending.num)
+			dm_source_flush_pending(context);
+		if (context->waiting && context->fetch_generation != dm_fetch_generation()) {
+			context->fetch_generation = dm_fetch_generation();
+			dm_source_collect_downloads(context);
+			size_t missing = dm_source_count_missing(context);
+			if (missing < context->waiting) {
+				context->waiting = missing;
+				//cycle mode only needs a rebuild if the card on screen was missing
+				if (strcmp(context->format, "Cycle Cards") != 0 || context->placeholder_shown)
+					updateTextures(context);
+			}
+		}
+		profile_end(dm_profile_downloads);
+
+		dm_source_poll_control(context, seconds);
+
+		dm_source_take_team_step(context);
+
+		//a composed view being rebuilt gets this frame's share of the work,
+		//other teams' cards are preloaded once it's done
+		dm_source_rebuild_run(context);
+		if (context->rebuild.stage == DM_REBUILD_IDLE)
+			dm_source_preload_run(context, os_gettime_ns());
+
+		//the decode for the next card happens a tick after the last swap
+		if (context->prefetch_due && !context->atlas && context->files.num) {
+			profile_start(dm_profile_prefetch);
+			dm_source_prefetch(context);
+			profile_end(dm_profile_prefetch);
+		}
 
 		context->update_time_elapsed += seconds;
 		//don't update playmat or creator views unless they have a flipcard
 		if (context->update_time_elapsed >= context->speed){
-			if (((context->useplaymatlayout || context->usecreatorview) && context->hasFlipCard) || (strcmp(context->format, "Cycle Cards") == 0)) {
+			profile_start(dm_profile_advance);
+			if (context->atlas && context->frames.num) {
+				//every face is already in the atlas, just move to the next one
+				context->update_time_elapsed = 0;
+				context->currentFrame++;
+				if (context->currentFrame >= context->frames.num)
+					context->currentFrame = 0;
+				dm_source_show_frame(context);
+			}
+			else if (strcmp(context->format, "Cycle Cards") == 0) {
+				context->update_time_elapsed = 0;
+				dm_source_swap_buffers(context);
+			}
+			else if (context->layout && context->hasFlipCard) {
 				context->update_time_elapsed = 0;
 					context->currentIndex++;
 					if (context->currentIndex >= context->files.num)
 						context->currentIndex = 0;
-					updateTextures(context);
+					//direct render picks the face at draw time, and a
+					//rebuild catches up on flips when it swaps in
+					bool direct = context->directrender && context->slotcards.num;
+					bool rebuilding = context->rebuild.stage != DM_REBUILD_IDLE;
+					if (!direct && !rebuilding && context->comboTexture && context->flipslots.num)
+						dm_source_refresh_flips(context);
+					else if (!direct && !rebuilding)
+						updateTextures(context);
 			}
+			profile_end(dm_profile_advance);
 		}
 		context->last_time = frame_time;
+		profile_end(dm_profile_tick);
+		dm_gfx_log(context, "tick", &start);
+		dm_source_update_stats(context, os_gettime_ns());
 	}
 }
 
@@ -899,6 +7328,7 @@ struct obs_source_info dm_source_info = {
 	.create = dm_source_create,
 	.destroy = dm_source_destroy,
 	.update = dm_source_update,
+	.save = dm_source_save,
 	.get_defaults = dm_source_defaults,
 	.show = dm_source_show,
 	.hide = dm_source_hide,
@@ -915,7 +7345,25 @@ OBS_MODULE_USE_DEFAULT_LOCALE("dm-source", "en-US")
 
 bool obs_module_load(void)
 {
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+	dm_layouts_init();
+	dm_images_init();
+	dm_disk_init();
+	dm_tasks_init();
+	dm_decoders_init();
+	dm_fetch_init();
 	obs_register_source(&dm_source_info);
 	return true;
 }
 
+void obs_module_unload(void)
+{
+	dm_fetch_free();
+	dm_decoders_free();
+	dm_tasks_free();
+	dm_disk_free();
+	dm_images_free();
+	dm_layouts_free();
+	curl_global_cleanup();
+}
+
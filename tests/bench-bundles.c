@@ -0,0 +1,165 @@
+/*
+ * Startup of eight teams from a cold image cache, first from the loose card
+ * jpegs and then from per-set bundles, and a rebuild of the bundles while a
+ * card from them is still mapped, which must leave the mapped copy intact.
+ *
+ * bench-bundles [--quick]
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+#define TEAMS 8
+#define TEAM_CARDS 10
+
+static const char *sets[] = {"avx", "bff", "xfc", "wol", "aou", "dxm"};
+
+static void make_teams(struct dstr *teams)
+{
+	for (int t = 0; t < TEAMS; t++) {
+		dstr_init(&teams[t]);
+		for (int c = 0; c < TEAM_CARDS; c++) {
+			int number = 1 + (t * 37 + c * 11) % 140;
+			dstr_catf(&teams[t], "%s%dx%d%s", c ? ";" : "", c % 4 + 1, number,
+				sets[(t + c) % (sizeof(sets) / sizeof(sets[0]))]);
+		}
+	}
+}
+
+struct load {
+	double ms;
+	long decodes;
+	long mapped;
+};
+
+//shows every team once and times the first frames until its view is built
+static struct load load_teams(const char *folder, struct dstr *teams, struct stub_timings *times)
+{
+	struct load total = { 0 };
+
+	for (int t = 0; t < TEAMS; t++) {
+		struct harness_source h;
+		struct stub_gfx_counts before, after;
+
+		dm_images_purge();
+		stub_gfx_get(&before);
+		long mapped = os_atomic_load_long(&dm_images.mapped);
+		uint64_t start = os_gettime_ns();
+
+		harness_create(&h, "bundles", harness_settings(folder, teams[t].array, "Playmat View"));
+		dm_source_show(h.context);
+		harness_settle(&h, 10000);
+
+		uint64_t ns = os_gettime_ns() - start;
+		stub_gfx_get(&after);
+		stub_timings_add(times, ns);
+		total.ms += ns / 1e6;
+		total.decodes += after.decodes - before.decodes;
+		total.mapped += os_atomic_load_long(&dm_images.mapped) - mapped;
+
+		dm_source_hide(h.context);
+		harness_destroy(&h);
+	}
+	return total;
+}
+
+static size_t count_generations(const char *folder, const char *set)
+{
+	size_t count = 0;
+	os_dir_t *dir = os_opendir(folder);
+	struct os_dirent *ent;
+	while (dir && (ent = os_readdir(dir)) != NULL)
+		count += dm_bundle_is_generation(ent->d_name, set);
+	if (dir)
+		os_closedir(dir);
+	return count;
+}
+
+//re-packs a set while one of its cards is mapped from the old generation
+static void repack_while_mapped(const char *folder, const char *card, const char *other)
+{
+	struct dstr path = { 0 };
+	size_t sets;
+
+	dm_images_purge();
+	dstr_printf(&path, "%s/%s", folder, card);
+	struct dm_image *held = dm_image_acquire(path.array, 0, false, NULL);
+	STUB_CHECK(held && held->bundle);
+	char *old_file = bstrdup(held->bundle->file);
+	size_t size = held->pixel_bytes;
+	uint8_t *copy = bmemdup(held->pixels, size);
+
+	STUB_CHECK(dm_bundle_build_folder(folder, &sets) > 0);
+
+	//the old generation is still mapped, same bytes as before
+	STUB_CHECK(memcmp(held->pixels, copy, size) == 0);
+	STUB_CHECK(count_generations(folder, "bff") == 1);
+
+	//other cards of the set come from the new generation
+	dstr_printf(&path, "%s/%s", folder, other);
+	struct dm_image *fresh = dm_image_acquire(path.array, 0, false, NULL);
+	STUB_CHECK(fresh && fresh->bundle && fresh->bundle != held->bundle);
+	STUB_CHECK(strcmp(fresh->bundle->file, old_file) != 0);
+	STUB_CHECK(held->bundle->detached);
+	printf("re-packed while mapped: %s -> %s\n", strrchr(old_file, '/') + 1,
+		strrchr(fresh->bundle->file, '/') + 1);
+
+	dm_image_release(fresh);
+	dm_image_release(held);
+	bfree(copy);
+	bfree(old_file);
+	dstr_free(&path);
+}
+
+int main(int argc, char **argv)
+{
+	struct dstr teams[TEAMS];
+	struct stub_timings loose_times = { 0 };
+	struct stub_timings bundle_times = { 0 };
+	size_t sets;
+
+	//already quick, the flag is taken for the same command line as the others
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+
+	harness_module_load();
+	char *folder = stub_temp_dir("dm-bundles");
+	STUB_CHECK(folder);
+	make_teams(teams);
+	size_t cards = 0;
+	for (int t = 0; t < TEAMS; t++)
+		cards += harness_write_cards(folder, teams[t].array, NULL, 0);
+	//two more of one set for the re-pack
+	cards += harness_write_cards(folder, "1x75bff;1x1bff", NULL, 0);
+
+	printf("%d teams of %d cards, %ux%u art\n", TEAMS, TEAM_CARDS, HARNESS_CARD_CX, HARNESS_CARD_CY);
+	struct load loose = load_teams(folder, teams, &loose_times);
+	printf("  loose jpegs  %8.1f ms  %4ld decodes  %4ld mapped\n", loose.ms, loose.decodes, loose.mapped);
+	stub_timings_print(&loose_times, "per team");
+
+	uint64_t start = os_gettime_ns();
+	size_t bundled = dm_bundle_build_folder(folder, &sets);
+	printf("  build        %8.1f ms  %zu cards into %zu sets\n", (os_gettime_ns() - start) / 1e6,
+		bundled, sets);
+	STUB_CHECK(bundled > 0 && bundled <= cards);
+
+	struct load bundles = load_teams(folder, teams, &bundle_times);
+	printf("  bundles      %8.1f ms  %4ld decodes  %4ld mapped  (%.1fx)\n", bundles.ms, bundles.decodes,
+		bundles.mapped, loose.ms / bundles.ms);
+	stub_timings_print(&bundle_times, "per team");
+	STUB_CHECK(bundles.decodes == 0);
+	STUB_CHECK(bundles.mapped == loose.decodes);
+
+	repack_while_mapped(folder, "75bff.jpg", "1bff.jpg");
+	harness_check_graphics();
+
+	for (int t = 0; t < TEAMS; t++)
+		dstr_free(&teams[t]);
+	stub_timings_free(&loose_times);
+	stub_timings_free(&bundle_times);
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
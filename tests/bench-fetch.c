@@ -0,0 +1,147 @@
+/*
+ * Cold fetch of a ten card team against a local stand-in for the card
+ * service, first the way the plugin used to download (a new handle per card,
+ * one after another), then through the download worker at several transfer
+ * caps, and a refresh of the cached team that the server answers with 304s.
+ * Dice counts are drawn from the built-in glyphs, so only card art is fetched.
+ *
+ * bench-fetch [--latency MS] [--quick]
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+#include "mock-server.h"
+
+static const char *team = "4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol;"
+			  "1x44dxm;3x59avx;2x88bff;1x120wol;4x7xfc";
+#define TEAM_CARDS 10
+
+static size_t discard_body(char *ptr, size_t size, size_t nmemb, void *data)
+{
+	UNUSED_PARAMETER(ptr);
+	UNUSED_PARAMETER(data);
+	return size * nmemb;
+}
+
+//what updateFileList did before the worker, one blocking easy handle per card
+static uint64_t run_serial(struct mock_server *srv)
+{
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS];
+	size_t count = dm_parse_team(team, cards, DM_TEAM_MAX_CARDS);
+	struct dstr url = { 0 };
+
+	uint64_t start = os_gettime_ns();
+	for (size_t i = 0; i < count; i++) {
+		CURL *curl = curl_easy_init();
+		dstr_printf(&url, "%s/Image.php?set=%s&cardnum=%u&res=l", mock_server_url(srv),
+				cards[i].set, cards[i].number);
+		curl_easy_setopt(curl, CURLOPT_URL, url.array);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_body);
+		STUB_CHECK(curl_easy_perform(curl) == CURLE_OK);
+		curl_easy_cleanup(curl);
+	}
+	uint64_t ns = os_gettime_ns() - start;
+
+	dstr_free(&url);
+	return ns;
+}
+
+static bool fetch_idle(void)
+{
+	pthread_mutex_lock(&dm_fetch.mutex);
+	bool idle = dm_fetch.count == 0 && dm_fetch.inflight.num == 0;
+	pthread_mutex_unlock(&dm_fetch.mutex);
+	return idle;
+}
+
+//frames at a real pace until the team is on screen, or the server has
+//answered every refresh
+static uint64_t run_until(struct harness_source *h, struct mock_server *srv, long not_modified)
+{
+	struct mock_server_counts counts;
+	uint64_t start = os_gettime_ns();
+
+	for (int frame = 0; frame < 60 * 60; frame++) {
+		harness_frame(h, 1.0f / 60.0f);
+		mock_server_counts(srv, &counts);
+		bool done = h->context->waiting == 0 && h->context->pending.num == 0 &&
+			    h->context->rebuild.stage == DM_REBUILD_IDLE && fetch_idle();
+		if (done && counts.not_modified >= not_modified)
+			return os_gettime_ns() - start;
+		os_sleep_ms(1);
+	}
+
+	STUB_CHECK(!"the team never finished downloading");
+	return 0;
+}
+
+static void run_worker(struct mock_server *srv, long transfers, uint64_t serial_ns)
+{
+	struct mock_server_counts before, cold, refreshed;
+	struct harness_source h;
+	char *folder = stub_temp_dir("dm-fetch");
+	STUB_CHECK(folder);
+
+	dm_images_purge();
+	obs_data_t *settings = harness_settings(folder, team, "Playmat View");
+	obs_data_set_string(settings, "cardservice", mock_server_url(srv));
+	obs_data_set_int(settings, "maxdownloads", transfers);
+
+	mock_server_counts(srv, &before);
+	harness_create(&h, "fetch", settings);
+	dm_source_show(h.context);
+	uint64_t cold_ns = run_until(&h, srv, 0);
+	mock_server_counts(srv, &cold);
+
+	//the button only flags the refresh, the next tick asks the server
+	dm_source_refresh_clicked(NULL, NULL, h.context);
+	STUB_CHECK(cold.not_modified == before.not_modified);
+	uint64_t refresh_ns = run_until(&h, srv, cold.not_modified + TEAM_CARDS);
+	mock_server_counts(srv, &refreshed);
+
+	printf("  worker, %ld transfers   cold %8.1f ms (%4.2fx)  %2ld connections  "
+	       "refresh %8.1f ms  %2ld not modified\n",
+		transfers, cold_ns / 1e6, (double)serial_ns / (double)cold_ns,
+		cold.connections - before.connections, refresh_ns / 1e6,
+		refreshed.not_modified - cold.not_modified);
+	STUB_CHECK(cold.full - before.full == TEAM_CARDS);
+	STUB_CHECK(refreshed.not_modified - cold.not_modified == TEAM_CARDS);
+	STUB_CHECK(refreshed.full == cold.full);
+
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	dm_disk_flush();
+	stub_remove_dir(folder);
+	bfree(folder);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t latency = 50;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+			latency = (uint32_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--quick") == 0)
+			latency = 10;
+	}
+
+	harness_module_load();
+	struct mock_server *srv = mock_server_start();
+	STUB_CHECK(srv);
+	mock_server_set_latency(srv, latency);
+
+	printf("%d cards, %u ms server latency\n", TEAM_CARDS, latency);
+	uint64_t serial_ns = run_serial(srv);
+	printf("  serial, handle per card  cold %8.1f ms\n", serial_ns / 1e6);
+
+	static const long transfers[] = {1, 4, 8};
+	for (size_t i = 0; i < sizeof(transfers) / sizeof(transfers[0]); i++)
+		run_worker(srv, transfers[i], serial_ns);
+
+	obs_module_unload();
+	mock_server_stop(srv);
+	harness_check_graphics();
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
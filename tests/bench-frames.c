@@ -0,0 +1,142 @@
+/*
+ * Drives create, update, tick and render for every display format and
+ * reports what each step asked of the graphics api, and the distribution of
+ * frame times once a view is up.  Runs without a GPU, so times are CPU side
+ * only: decodes, copies and texture creation are counted, not executed.
+ *
+ * bench-frames [--frames N] [--quick]
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+struct scenario {
+	const char *label;
+	const char *format;
+	bool directrender;
+	bool cycleatlas;
+};
+
+static const struct scenario scenarios[] = {
+	{"Cycle Cards, atlas", "Cycle Cards", false, true},
+	{"Cycle Cards, buffers", "Cycle Cards", false, false},
+	{"Playmat View", "Playmat View", false, true},
+	{"Playmat View, direct", "Playmat View", true, true},
+	{"Creator View", "Creator View", false, true},
+	{"Creator View, direct", "Creator View", true, true},
+	{"Horizontal Row", "Horizontal Row", false, true},
+	{"Horizontal Row, direct", "Horizontal Row", true, true},
+};
+
+static const char *team = "4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol;"
+			  "1x44dxm;3x59avx;2x88bff;1x120wol;4x7xfc";
+static const uint16_t flips[] = {44, 120};
+
+struct op {
+	uint64_t start;
+	struct stub_gfx_counts gfx;
+};
+
+static void op_begin(struct op *op)
+{
+	stub_gfx_get(&op->gfx);
+	op->start = os_gettime_ns();
+}
+
+static void op_end(struct op *op, const char *name)
+{
+	uint64_t ns = os_gettime_ns() - op->start;
+	struct stub_gfx_counts now;
+	stub_gfx_get(&now);
+
+	printf("  %-26s %9.3f ms  %4ld decodes  %4ld textures  %5ld copies  %9.1f KB  %5ld locks\n",
+		name, ns / 1e6, now.decodes - op->gfx.decodes,
+		now.textures_created - op->gfx.textures_created, now.copies - op->gfx.copies,
+		(now.bytes_uploaded - op->gfx.bytes_uploaded) / 1024.0,
+		now.graphics_enters - op->gfx.graphics_enters);
+}
+
+static void run(const char *folder, const struct scenario *s, int frames)
+{
+	struct harness_source h;
+	struct stub_timings steady = { 0 };
+	struct op op;
+
+	//every scenario starts from a cold image cache
+	dm_images_purge();
+
+	printf("%s\n", s->label);
+	obs_data_t *settings = harness_settings(folder, team, s->format);
+	obs_data_set_bool(settings, "directrender", s->directrender);
+	obs_data_set_bool(settings, "cycleatlas", s->cycleatlas);
+	obs_data_set_int(settings, "speed", 1);
+
+	op_begin(&op);
+	harness_create(&h, s->label, settings);
+	op_end(&op, "create");
+
+	op_begin(&op);
+	dm_source_show(h.context);
+	op_end(&op, "show");
+
+	op_begin(&op);
+	int settle = harness_settle(&h, 10000);
+	op_end(&op, "first frames");
+	printf("  %-26s %6d frames\n", "rebuild spread over", settle);
+
+	op_begin(&op);
+	for (int i = 0; i < frames; i++) {
+		uint64_t start = os_gettime_ns();
+		harness_frame(&h, 1.0f / 60.0f);
+		stub_timings_add(&steady, os_gettime_ns() - start);
+	}
+	op_end(&op, "steady frames");
+	stub_timings_print(&steady, "frame time");
+
+	//a settings change that only moves the cards around
+	obs_data_set_int(settings, "margins", 4);
+	op_begin(&op);
+	harness_update(&h);
+	harness_settle(&h, 10000);
+	op_end(&op, "update margins");
+
+	op_begin(&op);
+	dm_source_hide(h.context);
+	op_end(&op, "hide");
+
+	op_begin(&op);
+	harness_destroy(&h);
+	op_end(&op, "destroy");
+
+	stub_timings_free(&steady);
+	harness_check_graphics();
+}
+
+int main(int argc, char **argv)
+{
+	int frames = 600;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--quick") == 0)
+			frames = 60;
+	}
+
+	harness_module_load();
+	char *folder = stub_temp_dir("dm-frames");
+	STUB_CHECK(folder);
+	harness_write_cards(folder, team, flips, sizeof(flips) / sizeof(flips[0]));
+
+	printf("%d steady frames per view, 10 cards, %ux%u art\n\n", frames,
+		HARNESS_CARD_CX, HARNESS_CARD_CY);
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+		run(folder, &scenarios[i], frames);
+
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	//everything the plugin allocated went back with the module
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
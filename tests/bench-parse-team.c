@@ -0,0 +1,121 @@
+/*
+ * Time to turn a team string into cards, dm_parse_team against the strtok
+ * and sscanf tokenizer updateFileList used before it.  Only the parsing is
+ * timed, paths and downloads are left out of both.
+ *
+ * bench-parse-team [--iterations N] [--quick]
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+static const char *inputs[][2] = {
+	{"10 cards", "4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol;1x44dxm;3x59avx;2x88bff;1x120wol;4x7xfc"},
+	{"10 card link", "https://dicecoalition.com/teambuilder/?team=4x75bff;2x78avx;3x12xfc;1x101aou;"
+			 "2x30wol;1x44dxm;3x59avx;2x88bff;1x120wol;4x7xfc&name=Heroes"},
+	{"2 cards", "4x75bff;2x78avx"},
+};
+
+//the old tokenizer, cut down to the parse: copy, pick the list out of a
+//link, strtok it and sscanf the number and set out of every token
+static size_t parse_strtok(const char *tbstring, struct dm_team_card *out, size_t max)
+{
+	struct dstr dcardlist = { 0 };
+	size_t count = 0;
+	int ecount = 0;
+
+	for (size_t j = 0; j < strlen(tbstring); j++)
+		if (tbstring[j] == '=')
+			ecount++;
+
+	dstr_copy(&dcardlist, tbstring);
+	if (ecount > 0) {
+		char *cardsString = bstrdup(strchr(tbstring, '='));
+		dstr_copy(&dcardlist, "");
+		for (size_t t = 1; t < strlen(cardsString); t++) {
+			if (cardsString[t] == '&')
+				break;
+			dstr_cat_ch(&dcardlist, cardsString[t]);
+		}
+		bfree(cardsString);
+	}
+
+	char *token = strtok(dcardlist.array, ";");
+	while (token != NULL && count < max) {
+		struct dstr dcard = { 0 };
+		struct dstr dice = { 0 };
+		dstr_cat_ch(&dice, token[0]);
+		for (size_t c = 2; c < strlen(token); c++)
+			dstr_cat_ch(&dcard, token[c]);
+
+		int cnum = 0;
+		char set[10] = { 0 };
+		if (dcard.array && sscanf(dcard.array, "%d%9s", &cnum, set) == 2 && strlen(set) < 8 &&
+				cnum > 0 && cnum < 1000) {
+			out[count].dice = (uint8_t)atoi(dice.array);
+			out[count].number = (uint16_t)cnum;
+			strcpy(out[count].set, set);
+			count++;
+		}
+		dstr_free(&dcard);
+		dstr_free(&dice);
+		token = strtok(NULL, ";");
+	}
+
+	dstr_free(&dcardlist);
+	return count;
+}
+
+typedef size_t (*parse_fn)(const char *, struct dm_team_card *, size_t);
+
+static double run(parse_fn parse, const char *input, int iterations, long *allocs)
+{
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS];
+	volatile size_t sink = 0;
+
+	long start_allocs = stub_alloc_count();
+	uint64_t start = os_gettime_ns();
+	for (int i = 0; i < iterations; i++)
+		sink += parse(input, cards, DM_TEAM_MAX_CARDS);
+	uint64_t ns = os_gettime_ns() - start;
+	*allocs = (stub_alloc_count() - start_allocs) / iterations;
+
+	(void)sink;
+	return (double)ns / iterations;
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 200000;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--quick") == 0)
+			iterations = 2000;
+	}
+
+	harness_module_load();
+	printf("%d parses per input\n", iterations);
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+		struct dm_team_card a[DM_TEAM_MAX_CARDS], b[DM_TEAM_MAX_CARDS];
+		long new_allocs, old_allocs;
+
+		//both read the input the same way before either is timed
+		size_t count = dm_parse_team(inputs[i][1], a, DM_TEAM_MAX_CARDS);
+		STUB_CHECK(parse_strtok(inputs[i][1], b, DM_TEAM_MAX_CARDS) == count);
+		for (size_t c = 0; c < count; c++)
+			STUB_CHECK(a[c].dice == b[c].dice && a[c].number == b[c].number &&
+					strcmp(a[c].set, b[c].set) == 0);
+
+		double old_ns = run(parse_strtok, inputs[i][1], iterations, &old_allocs);
+		double new_ns = run(dm_parse_team, inputs[i][1], iterations, &new_allocs);
+		printf("  %-14s strtok %8.1f ns %3ld allocs   dm_parse_team %8.1f ns %3ld allocs   %5.1fx\n",
+			inputs[i][0], old_ns, old_allocs, new_ns, new_allocs, old_ns / new_ns);
+		STUB_CHECK(new_allocs == 0);
+	}
+
+	obs_module_unload();
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
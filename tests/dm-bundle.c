@@ -0,0 +1,41 @@
+/*
+ * Builds the per-set card bundles for image folders without OBS running, the
+ * same way the Build Card Bundles button does.  Safe to run while OBS has the
+ * folder's bundles mapped, each build is a new generation.
+ *
+ * dm-bundle <image folder> [<image folder> ...]
+ */
+
+#include "../dm-source.c"
+#include "dm-stub.h"
+
+int main(int argc, char **argv)
+{
+	int failed = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <image folder> [<image folder> ...]\n", argv[0]);
+		return 2;
+	}
+
+	stub_set_log_level(LOG_WARNING);
+	if (!obs_module_load())
+		return 1;
+
+	for (int i = 1; i < argc; i++) {
+		uint64_t start = os_gettime_ns();
+		size_t sets;
+
+		if (!os_file_exists(argv[i])) {
+			fprintf(stderr, "%s: no such folder\n", argv[i]);
+			failed++;
+			continue;
+		}
+		size_t bundled = dm_bundle_build_folder(argv[i], &sets);
+		printf("%s: bundled %zu cards into %zu sets in %.1f ms\n", argv[i], bundled, sets,
+			(os_gettime_ns() - start) / 1e6);
+	}
+
+	obs_module_unload();
+	return failed ? 1 : 0;
+}
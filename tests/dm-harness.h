@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+ * Shared helpers for the tests and benchmarks.  Included after dm-source.c so
+ * they can reach the plugin's statics.
+ */
+
+#include "dm-stub.h"
+
+//nothing listens here, so a card that isn't on disk fails fast instead of
+//reaching the real card service
+#define HARNESS_DEAD_SERVICE "http://127.0.0.1:9"
+
+#define HARNESS_CARD_CX DM_PLACEHOLDER_CX
+#define HARNESS_CARD_CY DM_PLACEHOLDER_CY
+
+struct harness_source {
+	obs_source_t *source;
+	obs_data_t *settings;
+	struct dm_source *context;
+};
+
+static inline obs_data_t *harness_settings(const char *folder, const char *tbstring, const char *format)
+{
+	obs_data_t *settings = obs_data_create();
+	dm_source_defaults(settings);
+	obs_data_set_string(settings, "imagefolder", folder);
+	obs_data_set_string(settings, "tbstring", tbstring);
+	obs_data_set_string(settings, "format", format);
+	obs_data_set_string(settings, "cardservice", HARNESS_DEAD_SERVICE);
+	return settings;
+}
+
+//writes card art for every card of the team string, cards whose number is
+//in flips get a double width image with a back face
+static inline size_t harness_write_cards(const char *folder, const char *tbstring, const uint16_t *flips,
+		size_t flipcount)
+{
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS];
+	size_t count = dm_parse_team(tbstring, cards, DM_TEAM_MAX_CARDS);
+	struct dstr path = { 0 };
+
+	for (size_t i = 0; i < count; i++) {
+		bool flip = false;
+		for (size_t f = 0; f < flipcount; f++)
+			flip |= flips[f] == cards[i].number;
+
+		dstr_printf(&path, "%s/%u%s.jpg", folder, cards[i].number, cards[i].set);
+		STUB_CHECK(stub_write_jpeg(path.array, HARNESS_CARD_CX * (flip ? 2 : 1),
+				HARNESS_CARD_CY, cards[i].number));
+	}
+	dstr_free(&path);
+	return count;
+}
+
+static inline void harness_create(struct harness_source *h, const char *name, obs_data_t *settings)
+{
+	h->settings = settings;
+	h->source = stub_source_create(name, settings);
+	h->context = dm_source_create(settings, h->source);
+	STUB_CHECK(h->context);
+}
+
+static inline void harness_update(struct harness_source *h)
+{
+	dm_source_update(h->context, h->settings);
+}
+
+static inline void harness_destroy(struct harness_source *h)
+{
+	dm_source_destroy(h->context);
+	stub_source_destroy(h->source);
+	obs_data_release(h->settings);
+	memset(h, 0, sizeof(*h));
+}
+
+//one video frame the way libobs drives it, tick then render in the graphics context
+static inline void harness_frame(struct harness_source *h, float seconds)
+{
+	dm_source_tick(h->context, seconds);
+	obs_enter_graphics();
+	dm_source_render(h->context, NULL);
+	obs_leave_graphics();
+}
+
+//runs frames until a rebuild in progress is done, returns how many it took.
+//the decoder threads get a moment between frames, as they would between vsyncs
+static inline int harness_settle(struct harness_source *h, int max_frames)
+{
+	int frames = 0;
+	while (h->context->rebuild.stage != DM_REBUILD_IDLE && frames < max_frames) {
+		harness_frame(h, 1.0f / 60.0f);
+		os_sleep_ms(1);
+		frames++;
+	}
+	STUB_CHECK(h->context->rebuild.stage == DM_REBUILD_IDLE);
+	return frames;
+}
+
+static inline void harness_module_load(void)
+{
+	if (!getenv("DM_TEST_VERBOSE"))
+		stub_set_log_level(LOG_WARNING);
+	else
+		stub_set_log_level(LOG_DEBUG);
+	STUB_CHECK(obs_module_load());
+}
+
+static inline void harness_check_graphics(void)
+{
+	struct stub_gfx_counts gfx;
+	stub_gfx_get(&gfx);
+	STUB_CHECK(gfx.outside_graphics == 0);
+	STUB_CHECK(gfx.out_of_bounds == 0);
+}
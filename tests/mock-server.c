@@ -0,0 +1,299 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/crc32.h>
+
+#include "dm-stub.h"
+#include "mock-server.h"
+
+//same size as the art the real service hands out
+#define DM_MOCK_CARD_CX 368
+#define DM_MOCK_CARD_CY 515
+
+struct mock_body {
+	char *key;
+	uint8_t *data;
+	size_t size;
+	char etag[16];
+};
+
+struct mock_conn {
+	struct mock_server *srv;
+	pthread_t thread;
+	int fd;
+};
+
+struct mock_server {
+	int listen_fd;
+	pthread_t thread;
+	volatile bool stop;
+	char url[64];
+	pthread_mutex_t mutex;
+	//allocated one by one, connection threads hold on to them while sending
+	DARRAY(struct mock_body *) bodies;
+	DARRAY(struct mock_conn *) conns;
+	volatile long latency_ms;
+	volatile long chunk;
+	volatile long pause_ms;
+	volatile long connections;
+	volatile long requests;
+	volatile long full;
+	volatile long not_modified;
+};
+
+//card art is made once per card and served from memory after that
+static struct mock_body *mock_body_get(struct mock_server *srv, const char *set, uint32_t number)
+{
+	struct mock_body *body = NULL;
+	struct dstr key = { 0 };
+
+	dstr_printf(&key, "%u%s", number, set);
+	pthread_mutex_lock(&srv->mutex);
+	for (size_t i = 0; i < srv->bodies.num && !body; i++) {
+		if (strcmp(srv->bodies.array[i]->key, key.array) == 0)
+			body = srv->bodies.array[i];
+	}
+	if (!body) {
+		body = bzalloc(sizeof(*body));
+		da_push_back(srv->bodies, &body);
+		body->key = key.array;
+		key.array = NULL;
+		body->data = stub_encode_jpeg(DM_MOCK_CARD_CX, DM_MOCK_CARD_CY, number, &body->size);
+		snprintf(body->etag, sizeof(body->etag), "\"%08x\"",
+			 calc_crc32(0, body->data, body->size));
+	}
+	pthread_mutex_unlock(&srv->mutex);
+
+	dstr_free(&key);
+	return body;
+}
+
+static bool mock_send(int fd, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	while (size) {
+		ssize_t sent = send(fd, p, size, MSG_NOSIGNAL);
+		if (sent <= 0)
+			return false;
+		p += sent;
+		size -= (size_t)sent;
+	}
+	return true;
+}
+
+static const char *mock_query_value(const char *query, const char *name, char *out, size_t size)
+{
+	size_t len = strlen(name);
+	const char *p = query;
+
+	while (p && *p) {
+		if (strncmp(p, name, len) == 0 && p[len] == '=') {
+			size_t n = 0;
+			p += len + 1;
+			while (*p && *p != '&' && *p != ' ' && n + 1 < size)
+				out[n++] = *p++;
+			out[n] = 0;
+			return out;
+		}
+		p = strchr(p, '&');
+		if (p)
+			p++;
+	}
+	return NULL;
+}
+
+static bool mock_respond(struct mock_server *srv, int fd, const char *request)
+{
+	char set[16], number[16], path[256] = { 0 };
+	const char *inm = strcasestr(request, "\r\nIf-None-Match:");
+	struct dstr header = { 0 };
+	bool ok;
+
+	os_atomic_inc_long(&srv->requests);
+	sscanf(request, "GET %255s", path);
+
+	uint32_t latency = (uint32_t)os_atomic_load_long(&srv->latency_ms);
+	if (latency)
+		os_sleep_ms(latency);
+
+	const char *query = strchr(path, '?');
+	if (strncmp(path, "/Image.php?", 11) != 0 || !mock_query_value(query + 1, "set", set, sizeof(set)) ||
+	    !mock_query_value(query + 1, "cardnum", number, sizeof(number))) {
+		static const char missing[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+		return mock_send(fd, missing, sizeof(missing) - 1);
+	}
+
+	struct mock_body *body = mock_body_get(srv, set, (uint32_t)atoi(number));
+	const char *inm_end = inm ? strstr(inm + 2, "\r\n") : NULL;
+	const char *match = inm ? strstr(inm, body->etag) : NULL;
+	if (match && (!inm_end || match < inm_end)) {
+		os_atomic_inc_long(&srv->not_modified);
+		dstr_printf(&header, "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n\r\n", body->etag);
+		ok = mock_send(fd, header.array, header.len);
+		dstr_free(&header);
+		return ok;
+	}
+
+	os_atomic_inc_long(&srv->full);
+	dstr_printf(&header,
+		    "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n"
+		    "ETag: %s\r\n\r\n",
+		    body->size, body->etag);
+	ok = mock_send(fd, header.array, header.len);
+	dstr_free(&header);
+
+	size_t chunk = (size_t)os_atomic_load_long(&srv->chunk);
+	uint32_t pause = (uint32_t)os_atomic_load_long(&srv->pause_ms);
+	for (size_t sent = 0; ok && sent < body->size;) {
+		size_t n = chunk && chunk < body->size - sent ? chunk : body->size - sent;
+		ok = mock_send(fd, body->data + sent, n);
+		sent += n;
+		if (ok && chunk && pause && sent < body->size)
+			os_sleep_ms(pause);
+	}
+	return ok;
+}
+
+static void *mock_conn_thread(void *data)
+{
+	struct mock_conn *conn = data;
+	struct dstr buffer = { 0 };
+	char chunk[4096];
+
+	for (;;) {
+		char *end = buffer.array ? strstr(buffer.array, "\r\n\r\n") : NULL;
+		if (end) {
+			size_t used = (size_t)(end - buffer.array) + 4;
+			*end = 0;
+			if (!mock_respond(conn->srv, conn->fd, buffer.array))
+				break;
+			memmove(buffer.array, buffer.array + used, buffer.len - used + 1);
+			buffer.len -= used;
+			continue;
+		}
+
+		ssize_t got = recv(conn->fd, chunk, sizeof(chunk), 0);
+		if (got <= 0)
+			break;
+		dstr_ncat(&buffer, chunk, (size_t)got);
+	}
+
+	dstr_free(&buffer);
+	shutdown(conn->fd, SHUT_RDWR);
+	return NULL;
+}
+
+static void *mock_accept_thread(void *data)
+{
+	struct mock_server *srv = data;
+
+	while (!os_atomic_load_bool(&srv->stop)) {
+		int fd = accept(srv->listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		if (os_atomic_load_bool(&srv->stop)) {
+			close(fd);
+			break;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		os_atomic_inc_long(&srv->connections);
+
+		struct mock_conn *conn = bzalloc(sizeof(*conn));
+		conn->srv = srv;
+		conn->fd = fd;
+		pthread_mutex_lock(&srv->mutex);
+		da_push_back(srv->conns, &conn);
+		pthread_mutex_unlock(&srv->mutex);
+		pthread_create(&conn->thread, NULL, mock_conn_thread, conn);
+	}
+	return NULL;
+}
+
+struct mock_server *mock_server_start(void)
+{
+	struct mock_server *srv = bzalloc(sizeof(*srv));
+	struct sockaddr_in addr = { 0 };
+	socklen_t len = sizeof(addr);
+	int one = 1;
+
+	pthread_mutex_init(&srv->mutex, NULL);
+	srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(srv->listen_fd, 64) != 0 ||
+	    getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+		close(srv->listen_fd);
+		pthread_mutex_destroy(&srv->mutex);
+		bfree(srv);
+		return NULL;
+	}
+
+	snprintf(srv->url, sizeof(srv->url), "http://127.0.0.1:%u", ntohs(addr.sin_port));
+	pthread_create(&srv->thread, NULL, mock_accept_thread, srv);
+	return srv;
+}
+
+void mock_server_stop(struct mock_server *srv)
+{
+	if (!srv)
+		return;
+
+	os_atomic_set_bool(&srv->stop, true);
+	shutdown(srv->listen_fd, SHUT_RDWR);
+	close(srv->listen_fd);
+	pthread_join(srv->thread, NULL);
+
+	for (size_t i = 0; i < srv->conns.num; i++) {
+		struct mock_conn *conn = srv->conns.array[i];
+		shutdown(conn->fd, SHUT_RDWR);
+		pthread_join(conn->thread, NULL);
+		close(conn->fd);
+		bfree(conn);
+	}
+	for (size_t i = 0; i < srv->bodies.num; i++) {
+		bfree(srv->bodies.array[i]->key);
+		bfree(srv->bodies.array[i]->data);
+		bfree(srv->bodies.array[i]);
+	}
+	da_free(srv->conns);
+	da_free(srv->bodies);
+	pthread_mutex_destroy(&srv->mutex);
+	bfree(srv);
+}
+
+const char *mock_server_url(struct mock_server *srv)
+{
+	return srv->url;
+}
+
+void mock_server_set_latency(struct mock_server *srv, uint32_t ms)
+{
+	os_atomic_set_long(&srv->latency_ms, (long)ms);
+}
+
+void mock_server_set_throttle(struct mock_server *srv, size_t chunk, uint32_t pause_ms)
+{
+	os_atomic_set_long(&srv->chunk, (long)chunk);
+	os_atomic_set_long(&srv->pause_ms, (long)pause_ms);
+}
+
+void mock_server_counts(struct mock_server *srv, struct mock_server_counts *counts)
+{
+	counts->connections = os_atomic_load_long(&srv->connections);
+	counts->requests = os_atomic_load_long(&srv->requests);
+	counts->full = os_atomic_load_long(&srv->full);
+	counts->not_modified = os_atomic_load_long(&srv->not_modified);
+}
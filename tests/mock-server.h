@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ * A local stand-in for the card service.  Answers
+ * GET /Image.php?set=<set>&cardnum=<n>&res=l with generated card art over
+ * keep-alive HTTP/1.1, with an ETag it honours in If-None-Match.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mock_server;
+
+struct mock_server *mock_server_start(void);
+void mock_server_stop(struct mock_server *srv);
+
+//base url to use as the card service, without a trailing slash
+const char *mock_server_url(struct mock_server *srv);
+
+//added before every response, to stand in for the round trip to a real server
+void mock_server_set_latency(struct mock_server *srv, uint32_t ms);
+//sends bodies in chunks of this size with the given pause between them, 0 to send at once
+void mock_server_set_throttle(struct mock_server *srv, size_t chunk, uint32_t pause_ms);
+
+struct mock_server_counts {
+	long connections;
+	long requests;
+	long full;
+	long not_modified;
+};
+
+void mock_server_counts(struct mock_server *srv, struct mock_server_counts *counts);
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * Controls and counters of the headless libobs stub, for the tests and
+ * benchmarks.  Nothing in here exists in libobs.
+ */
+
+#include <obs-module.h>
+
+//what the plugin asked the graphics api for since the last reset
+struct stub_gfx_counts {
+	long textures_created;
+	long textures_destroyed;
+	long textures_live;
+	long long bytes_uploaded;
+	long copies;
+	long draws;
+	long decodes;
+	long graphics_enters;
+	//calls made outside obs_enter_graphics / obs_leave_graphics
+	long outside_graphics;
+	//copies or draws that reach past either texture
+	long out_of_bounds;
+};
+
+void stub_gfx_reset(void);
+void stub_gfx_get(struct stub_gfx_counts *counts);
+
+long stub_alloc_count(void);
+long stub_alloc_live(void);
+
+//prints plugin log lines of this level or more severe, LOG_WARNING by default
+void stub_set_log_level(int level);
+long stub_log_count(int level);
+
+void stub_set_video_size(uint32_t cx, uint32_t cy);
+
+//every texture upload takes this long, standing in for a slow driver
+void stub_set_upload_delay(uint32_t ms);
+//every image file decode takes this long, standing in for big card art
+void stub_set_decode_delay(uint32_t ms);
+//every obs_data_save_json_safe takes this long, standing in for a slow disk
+void stub_set_save_delay(uint32_t ms);
+
+//time spent in a profiler scope since the last reset, keyed on the name pointer
+void stub_profile_reset(void);
+bool stub_profile_get(const char *name, long *calls, uint64_t *ns);
+
+obs_source_t *stub_source_create(const char *name, obs_data_t *settings);
+void stub_source_destroy(obs_source_t *source);
+
+//presses a hotkey registered by any source, false if nothing has that name
+bool stub_hotkey_press(const char *name);
+
+//synthetic card art, a gradient that differs per seed
+uint8_t *stub_encode_jpeg(uint32_t cx, uint32_t cy, uint32_t seed, size_t *size);
+bool stub_write_jpeg(const char *path, uint32_t cx, uint32_t cy, uint32_t seed);
+
+//makes an empty directory under the system temp folder, returns it with bfree
+char *stub_temp_dir(const char *prefix);
+void stub_remove_dir(const char *path);
+
+//frame time distribution for the benchmarks
+struct stub_timings {
+	uint64_t *ns;
+	size_t num;
+	size_t capacity;
+};
+
+void stub_timings_add(struct stub_timings *t, uint64_t ns);
+void stub_timings_print(const struct stub_timings *t, const char *label);
+uint64_t stub_timings_percentile(struct stub_timings *t, double p);
+void stub_timings_free(struct stub_timings *t);
+
+#define STUB_CHECK(cond)                                                           \
+	do {                                                                       \
+		if (!(cond)) {                                                     \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,     \
+				__LINE__, #cond);                                  \
+			exit(1);                                                   \
+		}                                                                  \
+	} while (0)
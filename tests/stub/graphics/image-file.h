@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../obs-module.h"
+
+struct gs_image_file {
+	gs_texture_t *texture;
+	enum gs_color_format format;
+	uint32_t cx;
+	uint32_t cy;
+	bool loaded;
+	uint8_t *texture_data;
+};
+
+typedef struct gs_image_file gs_image_file_t;
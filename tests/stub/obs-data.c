@@ -0,0 +1,718 @@
+/*
+ * obs_data, settings with user and default values that load and save json.
+ */
+
+#include <ctype.h>
+#include <math.h>
+
+#include <obs-module.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+enum stub_type {
+	STUB_NONE,
+	STUB_STRING,
+	STUB_INT,
+	STUB_DOUBLE,
+	STUB_BOOL,
+	STUB_OBJ,
+	STUB_ARRAY,
+};
+
+struct stub_value {
+	enum stub_type type;
+	union {
+		char *str;
+		long long i;
+		double d;
+		bool b;
+		obs_data_t *obj;
+		obs_data_array_t *array;
+	};
+};
+
+struct stub_item {
+	char *name;
+	struct stub_value user;
+	struct stub_value def;
+	struct stub_item *next;
+};
+
+struct obs_data {
+	volatile long refs;
+	struct stub_item *first;
+	char *json;
+};
+
+struct obs_data_array {
+	volatile long refs;
+	obs_data_t **items;
+	size_t num;
+	size_t capacity;
+};
+
+static void stub_value_free(struct stub_value *value)
+{
+	if (value->type == STUB_STRING)
+		free(value->str);
+	else if (value->type == STUB_OBJ)
+		obs_data_release(value->obj);
+	else if (value->type == STUB_ARRAY)
+		obs_data_array_release(value->array);
+	memset(value, 0, sizeof(*value));
+}
+
+obs_data_t *obs_data_create(void)
+{
+	obs_data_t *data = calloc(1, sizeof(*data));
+	data->refs = 1;
+	return data;
+}
+
+void obs_data_addref(obs_data_t *data)
+{
+	if (data)
+		os_atomic_inc_long(&data->refs);
+}
+
+void obs_data_release(obs_data_t *data)
+{
+	if (!data || os_atomic_dec_long(&data->refs) > 0)
+		return;
+
+	for (struct stub_item *item = data->first, *next; item; item = next) {
+		next = item->next;
+		stub_value_free(&item->user);
+		stub_value_free(&item->def);
+		free(item->name);
+		free(item);
+	}
+	free(data->json);
+	free(data);
+}
+
+static struct stub_item *stub_find(obs_data_t *data, const char *name, bool create)
+{
+	struct stub_item **link = &data->first;
+
+	for (; *link; link = &(*link)->next) {
+		if (strcmp((*link)->name, name) == 0)
+			return *link;
+	}
+	if (!create)
+		return NULL;
+
+	*link = calloc(1, sizeof(**link));
+	(*link)->name = strdup(name);
+	return *link;
+}
+
+static const struct stub_value *stub_get(obs_data_t *data, const char *name)
+{
+	struct stub_item *item = data && name ? stub_find(data, name, false) : NULL;
+	if (!item)
+		return NULL;
+	if (item->user.type != STUB_NONE)
+		return &item->user;
+	if (item->def.type != STUB_NONE)
+		return &item->def;
+	return NULL;
+}
+
+static struct stub_value *stub_set(obs_data_t *data, const char *name, bool user)
+{
+	struct stub_item *item;
+
+	if (!data || !name)
+		return NULL;
+
+	item = stub_find(data, name, true);
+	stub_value_free(user ? &item->user : &item->def);
+	return user ? &item->user : &item->def;
+}
+
+void obs_data_erase(obs_data_t *data, const char *name)
+{
+	struct stub_item **link = &data->first;
+
+	for (; *link; link = &(*link)->next) {
+		if (strcmp((*link)->name, name) != 0)
+			continue;
+
+		struct stub_item *item = *link;
+		*link = item->next;
+		stub_value_free(&item->user);
+		stub_value_free(&item->def);
+		free(item->name);
+		free(item);
+		return;
+	}
+}
+
+bool obs_data_has_user_value(obs_data_t *data, const char *name)
+{
+	struct stub_item *item = data && name ? stub_find(data, name, false) : NULL;
+	return item && item->user.type != STUB_NONE;
+}
+
+#define STUB_SETTER(suffix, user)                                                       \
+	void obs_data_set_##suffix##string(obs_data_t *data, const char *name,         \
+					   const char *val)                             \
+	{                                                                               \
+		struct stub_value *value = stub_set(data, name, user);                  \
+		if (value) {                                                            \
+			value->type = STUB_STRING;                                      \
+			value->str = strdup(val ? val : "");                            \
+		}                                                                       \
+	}                                                                               \
+	void obs_data_set_##suffix##int(obs_data_t *data, const char *name, long long val) \
+	{                                                                               \
+		struct stub_value *value = stub_set(data, name, user);                  \
+		if (value) {                                                            \
+			value->type = STUB_INT;                                         \
+			value->i = val;                                                 \
+		}                                                                       \
+	}                                                                               \
+	void obs_data_set_##suffix##double(obs_data_t *data, const char *name, double val) \
+	{                                                                               \
+		struct stub_value *value = stub_set(data, name, user);                  \
+		if (value) {                                                            \
+			value->type = STUB_DOUBLE;                                      \
+			value->d = val;                                                 \
+		}                                                                       \
+	}                                                                               \
+	void obs_data_set_##suffix##bool(obs_data_t *data, const char *name, bool val)  \
+	{                                                                               \
+		struct stub_value *value = stub_set(data, name, user);                  \
+		if (value) {                                                            \
+			value->type = STUB_BOOL;                                        \
+			value->b = val;                                                 \
+		}                                                                       \
+	}
+
+STUB_SETTER(, true)
+STUB_SETTER(default_, false)
+
+void obs_data_set_obj(obs_data_t *data, const char *name, obs_data_t *obj)
+{
+	struct stub_value *value = stub_set(data, name, true);
+	if (value && obj) {
+		value->type = STUB_OBJ;
+		value->obj = obj;
+		obs_data_addref(obj);
+	}
+}
+
+void obs_data_set_array(obs_data_t *data, const char *name, obs_data_array_t *array)
+{
+	struct stub_value *value = stub_set(data, name, true);
+	if (value && array) {
+		value->type = STUB_ARRAY;
+		value->array = array;
+		obs_data_array_addref(array);
+	}
+}
+
+const char *obs_data_get_string(obs_data_t *data, const char *name)
+{
+	const struct stub_value *value = stub_get(data, name);
+	return value && value->type == STUB_STRING ? value->str : "";
+}
+
+long long obs_data_get_int(obs_data_t *data, const char *name)
+{
+	const struct stub_value *value = stub_get(data, name);
+	if (!value)
+		return 0;
+	if (value->type == STUB_INT)
+		return value->i;
+	if (value->type == STUB_DOUBLE)
+		return (long long)value->d;
+	return 0;
+}
+
+double obs_data_get_double(obs_data_t *data, const char *name)
+{
+	const struct stub_value *value = stub_get(data, name);
+	if (!value)
+		return 0.0;
+	if (value->type == STUB_DOUBLE)
+		return value->d;
+	if (value->type == STUB_INT)
+		return (double)value->i;
+	return 0.0;
+}
+
+bool obs_data_get_bool(obs_data_t *data, const char *name)
+{
+	const struct stub_value *value = stub_get(data, name);
+	return value && value->type == STUB_BOOL && value->b;
+}
+
+obs_data_t *obs_data_get_obj(obs_data_t *data, const char *name)
+{
+	const struct stub_value *value = stub_get(data, name);
+	if (!value || value->type != STUB_OBJ)
+		return NULL;
+	obs_data_addref(value->obj);
+	return value->obj;
+}
+
+obs_data_array_t *obs_data_get_array(obs_data_t *data, const char *name)
+{
+	const struct stub_value *value = stub_get(data, name);
+	if (!value || value->type != STUB_ARRAY)
+		return NULL;
+	obs_data_array_addref(value->array);
+	return value->array;
+}
+
+/* ------------------------------------------------------------------------- */
+/* arrays                                                                    */
+
+obs_data_array_t *obs_data_array_create(void)
+{
+	obs_data_array_t *array = calloc(1, sizeof(*array));
+	array->refs = 1;
+	return array;
+}
+
+void obs_data_array_addref(obs_data_array_t *array)
+{
+	if (array)
+		os_atomic_inc_long(&array->refs);
+}
+
+void obs_data_array_release(obs_data_array_t *array)
+{
+	if (!array || os_atomic_dec_long(&array->refs) > 0)
+		return;
+
+	for (size_t i = 0; i < array->num; i++)
+		obs_data_release(array->items[i]);
+	free(array->items);
+	free(array);
+}
+
+size_t obs_data_array_count(obs_data_array_t *array)
+{
+	return array ? array->num : 0;
+}
+
+obs_data_t *obs_data_array_item(obs_data_array_t *array, size_t idx)
+{
+	if (!array || idx >= array->num)
+		return NULL;
+	obs_data_addref(array->items[idx]);
+	return array->items[idx];
+}
+
+size_t obs_data_array_push_back(obs_data_array_t *array, obs_data_t *obj)
+{
+	if (!array || !obj)
+		return 0;
+
+	if (array->num == array->capacity) {
+		array->capacity = array->capacity ? array->capacity * 2 : 8;
+		array->items = realloc(array->items, array->capacity * sizeof(*array->items));
+	}
+	obs_data_addref(obj);
+	array->items[array->num] = obj;
+	return array->num++;
+}
+
+/* ------------------------------------------------------------------------- */
+/* json                                                                      */
+
+struct stub_parser {
+	const char *p;
+	bool failed;
+};
+
+static void stub_skip_space(struct stub_parser *ps)
+{
+	while (*ps->p && isspace((unsigned char)*ps->p))
+		ps->p++;
+}
+
+static bool stub_expect(struct stub_parser *ps, char ch)
+{
+	stub_skip_space(ps);
+	if (*ps->p != ch) {
+		ps->failed = true;
+		return false;
+	}
+	ps->p++;
+	return true;
+}
+
+static void stub_put_utf8(struct dstr *out, unsigned long code)
+{
+	if (code < 0x80) {
+		dstr_cat_ch(out, (char)code);
+	}
+	else if (code < 0x800) {
+		dstr_cat_ch(out, (char)(0xC0 | (code >> 6)));
+		dstr_cat_ch(out, (char)(0x80 | (code & 0x3F)));
+	}
+	else if (code < 0x10000) {
+		dstr_cat_ch(out, (char)(0xE0 | (code >> 12)));
+		dstr_cat_ch(out, (char)(0x80 | ((code >> 6) & 0x3F)));
+		dstr_cat_ch(out, (char)(0x80 | (code & 0x3F)));
+	}
+	else {
+		dstr_cat_ch(out, (char)(0xF0 | (code >> 18)));
+		dstr_cat_ch(out, (char)(0x80 | ((code >> 12) & 0x3F)));
+		dstr_cat_ch(out, (char)(0x80 | ((code >> 6) & 0x3F)));
+		dstr_cat_ch(out, (char)(0x80 | (code & 0x3F)));
+	}
+}
+
+static char *stub_parse_string(struct stub_parser *ps)
+{
+	struct dstr out = {0};
+	char *result;
+
+	if (!stub_expect(ps, '"'))
+		return NULL;
+
+	while (*ps->p && *ps->p != '"') {
+		char ch = *ps->p++;
+		if (ch != '\\') {
+			dstr_cat_ch(&out, ch);
+			continue;
+		}
+
+		ch = *ps->p++;
+		switch (ch) {
+		case 'b': dstr_cat_ch(&out, '\b'); break;
+		case 'f': dstr_cat_ch(&out, '\f'); break;
+		case 'n': dstr_cat_ch(&out, '\n'); break;
+		case 'r': dstr_cat_ch(&out, '\r'); break;
+		case 't': dstr_cat_ch(&out, '\t'); break;
+		case 'u': {
+			char hex[5] = {0};
+			unsigned long code;
+			for (int i = 0; i < 4; i++) {
+				if (!isxdigit((unsigned char)ps->p[i])) {
+					ps->failed = true;
+					dstr_free(&out);
+					return NULL;
+				}
+				hex[i] = ps->p[i];
+			}
+			ps->p += 4;
+			code = strtoul(hex, NULL, 16);
+			if (code >= 0xD800 && code < 0xDC00 && ps->p[0] == '\\' && ps->p[1] == 'u') {
+				memcpy(hex, ps->p + 2, 4);
+				unsigned long low = strtoul(hex, NULL, 16);
+				if (low >= 0xDC00 && low < 0xE000) {
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					ps->p += 6;
+				}
+			}
+			stub_put_utf8(&out, code);
+			break;
+		}
+		case 0:
+			ps->failed = true;
+			dstr_free(&out);
+			return NULL;
+		default:
+			dstr_cat_ch(&out, ch);
+		}
+	}
+
+	if (*ps->p != '"') {
+		ps->failed = true;
+		dstr_free(&out);
+		return NULL;
+	}
+	ps->p++;
+
+	result = strdup(out.array ? out.array : "");
+	dstr_free(&out);
+	return result;
+}
+
+static obs_data_t *stub_parse_object(struct stub_parser *ps);
+
+static bool stub_parse_value(struct stub_parser *ps, struct stub_value *value)
+{
+	stub_skip_space(ps);
+	memset(value, 0, sizeof(*value));
+
+	if (*ps->p == '"') {
+		value->str = stub_parse_string(ps);
+		value->type = STUB_STRING;
+		return value->str != NULL;
+	}
+	if (*ps->p == '{') {
+		value->obj = stub_parse_object(ps);
+		value->type = STUB_OBJ;
+		return value->obj != NULL;
+	}
+	if (*ps->p == '[') {
+		ps->p++;
+		value->type = STUB_ARRAY;
+		value->array = obs_data_array_create();
+		stub_skip_space(ps);
+		if (*ps->p == ']') {
+			ps->p++;
+			return true;
+		}
+		for (;;) {
+			struct stub_value item;
+			if (!stub_parse_value(ps, &item))
+				return false;
+			//libobs only keeps objects in arrays
+			if (item.type == STUB_OBJ)
+				obs_data_array_push_back(value->array, item.obj);
+			stub_value_free(&item);
+
+			stub_skip_space(ps);
+			if (*ps->p == ',') {
+				ps->p++;
+				continue;
+			}
+			return stub_expect(ps, ']');
+		}
+	}
+	if (strncmp(ps->p, "true", 4) == 0 || strncmp(ps->p, "false", 5) == 0) {
+		value->type = STUB_BOOL;
+		value->b = *ps->p == 't';
+		ps->p += value->b ? 4 : 5;
+		return true;
+	}
+	if (strncmp(ps->p, "null", 4) == 0) {
+		ps->p += 4;
+		return true;
+	}
+	if (*ps->p == '-' || isdigit((unsigned char)*ps->p)) {
+		const char *start = ps->p;
+		bool real = false;
+		char *end;
+
+		while (*ps->p && strchr("+-0123456789.eE", *ps->p)) {
+			if (strchr(".eE", *ps->p))
+				real = true;
+			ps->p++;
+		}
+		if (real) {
+			value->type = STUB_DOUBLE;
+			value->d = strtod(start, &end);
+		}
+		else {
+			value->type = STUB_INT;
+			value->i = strtoll(start, &end, 10);
+		}
+		if (end != ps->p)
+			ps->failed = true;
+		return !ps->failed;
+	}
+
+	ps->failed = true;
+	return false;
+}
+
+static obs_data_t *stub_parse_object(struct stub_parser *ps)
+{
+	obs_data_t *data;
+
+	if (!stub_expect(ps, '{'))
+		return NULL;
+
+	data = obs_data_create();
+	stub_skip_space(ps);
+	if (*ps->p == '}') {
+		ps->p++;
+		return data;
+	}
+
+	for (;;) {
+		struct stub_value value = {0};
+		char *name;
+
+		stub_skip_space(ps);
+		name = stub_parse_string(ps);
+		if (!name || !stub_expect(ps, ':') || !stub_parse_value(ps, &value)) {
+			free(name);
+			ps->failed = true;
+			stub_value_free(&value);
+			obs_data_release(data);
+			return NULL;
+		}
+
+		if (value.type != STUB_NONE) {
+			struct stub_value *slot = stub_set(data, name, true);
+			*slot = value;
+		}
+		free(name);
+
+		stub_skip_space(ps);
+		if (*ps->p == ',') {
+			ps->p++;
+			continue;
+		}
+		if (!stub_expect(ps, '}')) {
+			obs_data_release(data);
+			return NULL;
+		}
+		return data;
+	}
+}
+
+obs_data_t *obs_data_create_from_json(const char *json_string)
+{
+	struct stub_parser ps = {json_string, false};
+	obs_data_t *data;
+
+	if (!json_string)
+		return NULL;
+
+	data = stub_parse_object(&ps);
+	stub_skip_space(&ps);
+	if (data && (ps.failed || *ps.p)) {
+		obs_data_release(data);
+		data = NULL;
+	}
+	if (!data)
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_json] Failed reading json string");
+	return data;
+}
+
+obs_data_t *obs_data_create_from_json_file(const char *json_file)
+{
+	char *text = os_quick_read_utf8_file(json_file);
+	obs_data_t *data = NULL;
+
+	if (text && *text)
+		data = obs_data_create_from_json(text);
+	bfree(text);
+	return data;
+}
+
+static void stub_write_string(struct dstr *out, const char *str)
+{
+	dstr_cat_ch(out, '"');
+	for (; *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(out, '\\');
+			dstr_cat_ch(out, (char)ch);
+		}
+		else if (ch == '\n') {
+			dstr_cat(out, "\\n");
+		}
+		else if (ch == '\r') {
+			dstr_cat(out, "\\r");
+		}
+		else if (ch == '\t') {
+			dstr_cat(out, "\\t");
+		}
+		else if (ch < 0x20) {
+			dstr_catf(out, "\\u%04x", ch);
+		}
+		else {
+			dstr_cat_ch(out, (char)ch);
+		}
+	}
+	dstr_cat_ch(out, '"');
+}
+
+static void stub_write_object(struct dstr *out, obs_data_t *data, int indent);
+
+static void stub_write_value(struct dstr *out, const struct stub_value *value, int indent)
+{
+	switch (value->type) {
+	case STUB_STRING:
+		stub_write_string(out, value->str);
+		break;
+	case STUB_INT:
+		dstr_catf(out, "%lld", value->i);
+		break;
+	case STUB_DOUBLE:
+		if (isfinite(value->d))
+			dstr_catf(out, "%.17g", value->d);
+		else
+			dstr_cat(out, "0.0");
+		break;
+	case STUB_BOOL:
+		dstr_cat(out, value->b ? "true" : "false");
+		break;
+	case STUB_OBJ:
+		stub_write_object(out, value->obj, indent);
+		break;
+	case STUB_ARRAY:
+		dstr_cat_ch(out, '[');
+		for (size_t i = 0; i < value->array->num; i++) {
+			dstr_catf(out, "%s\n%*s", i ? "," : "", (indent + 1) * 4, "");
+			stub_write_object(out, value->array->items[i], indent + 1);
+		}
+		if (value->array->num)
+			dstr_catf(out, "\n%*s", indent * 4, "");
+		dstr_cat_ch(out, ']');
+		break;
+	case STUB_NONE:
+		dstr_cat(out, "null");
+		break;
+	}
+}
+
+static void stub_write_object(struct dstr *out, obs_data_t *data, int indent)
+{
+	bool first = true;
+
+	dstr_cat_ch(out, '{');
+	for (struct stub_item *item = data->first; item; item = item->next) {
+		if (item->user.type == STUB_NONE)
+			continue;
+		dstr_catf(out, "%s\n%*s", first ? "" : ",", (indent + 1) * 4, "");
+		stub_write_string(out, item->name);
+		dstr_cat(out, ": ");
+		stub_write_value(out, &item->user, indent + 1);
+		first = false;
+	}
+	if (!first)
+		dstr_catf(out, "\n%*s", indent * 4, "");
+	dstr_cat_ch(out, '}');
+}
+
+const char *obs_data_get_json(obs_data_t *data)
+{
+	struct dstr out = {0};
+
+	if (!data)
+		return NULL;
+
+	stub_write_object(&out, data, 0);
+	free(data->json);
+	data->json = strdup(out.array);
+	dstr_free(&out);
+	return data->json;
+}
+
+bool obs_data_save_json(obs_data_t *data, const char *file)
+{
+	const char *json = obs_data_get_json(data);
+	return json && os_quick_write_utf8_file(file, json, strlen(json), false);
+}
+
+static volatile long stub_save_delay_ms;
+
+void stub_set_save_delay(uint32_t ms)
+{
+	os_atomic_set_long(&stub_save_delay_ms, (long)ms);
+}
+
+bool obs_data_save_json_safe(obs_data_t *data, const char *file, const char *temp_ext,
+			     const char *backup_ext)
+{
+	long delay = os_atomic_load_long(&stub_save_delay_ms);
+	if (delay)
+		os_sleep_ms((uint32_t)delay);
+	const char *json = obs_data_get_json(data);
+	return json && os_quick_write_utf8_file_safe(file, json, strlen(json), false, temp_ext,
+						     backup_ext);
+}
@@ -0,0 +1,439 @@
+/*
+ * Graphics calls are recorded, not drawn.  Textures only remember their size
+ * so copies and draws can be checked against it, image files are decoded for
+ * real with libjpeg so decode costs show up in the benchmarks.
+ */
+
+#include <obs-module.h>
+
+#include <setjmp.h>
+#include <jpeglib.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include "dm-stub.h"
+
+struct gs_texture {
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_format format;
+};
+
+static pthread_mutex_t stub_graphics_mutex;
+static pthread_once_t stub_graphics_once = PTHREAD_ONCE_INIT;
+static __thread int stub_graphics_depth;
+
+static struct {
+	volatile long textures_created;
+	volatile long textures_destroyed;
+	volatile long textures_live;
+	volatile long copies;
+	volatile long draws;
+	volatile long decodes;
+	volatile long graphics_enters;
+	volatile long outside_graphics;
+	volatile long out_of_bounds;
+} stub_gfx;
+
+static pthread_mutex_t stub_upload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static long long stub_bytes_uploaded;
+static volatile long stub_upload_delay_ms;
+static volatile long stub_decode_delay_ms;
+
+static void stub_graphics_init(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&stub_graphics_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+void obs_enter_graphics(void)
+{
+	pthread_once(&stub_graphics_once, stub_graphics_init);
+	pthread_mutex_lock(&stub_graphics_mutex);
+	stub_graphics_depth++;
+	os_atomic_inc_long(&stub_gfx.graphics_enters);
+}
+
+void obs_leave_graphics(void)
+{
+	if (stub_graphics_depth <= 0) {
+		blog(LOG_ERROR, "obs_leave_graphics without obs_enter_graphics");
+		os_atomic_inc_long(&stub_gfx.outside_graphics);
+		return;
+	}
+	stub_graphics_depth--;
+	pthread_mutex_unlock(&stub_graphics_mutex);
+}
+
+static void stub_check_context(const char *func)
+{
+	if (stub_graphics_depth > 0)
+		return;
+	blog(LOG_ERROR, "%s called outside the graphics context", func);
+	os_atomic_inc_long(&stub_gfx.outside_graphics);
+}
+
+void stub_gfx_reset(void)
+{
+	memset((void *)&stub_gfx, 0, sizeof(stub_gfx));
+	pthread_mutex_lock(&stub_upload_mutex);
+	stub_bytes_uploaded = 0;
+	pthread_mutex_unlock(&stub_upload_mutex);
+}
+
+void stub_gfx_get(struct stub_gfx_counts *counts)
+{
+	counts->textures_created = os_atomic_load_long(&stub_gfx.textures_created);
+	counts->textures_destroyed = os_atomic_load_long(&stub_gfx.textures_destroyed);
+	counts->textures_live = os_atomic_load_long(&stub_gfx.textures_live);
+	counts->copies = os_atomic_load_long(&stub_gfx.copies);
+	counts->draws = os_atomic_load_long(&stub_gfx.draws);
+	counts->decodes = os_atomic_load_long(&stub_gfx.decodes);
+	counts->graphics_enters = os_atomic_load_long(&stub_gfx.graphics_enters);
+	counts->outside_graphics = os_atomic_load_long(&stub_gfx.outside_graphics);
+	counts->out_of_bounds = os_atomic_load_long(&stub_gfx.out_of_bounds);
+	pthread_mutex_lock(&stub_upload_mutex);
+	counts->bytes_uploaded = stub_bytes_uploaded;
+	pthread_mutex_unlock(&stub_upload_mutex);
+}
+
+uint32_t gs_get_format_bpp(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_A8:
+	case GS_R8:
+		return 8;
+	case GS_R16:
+	case GS_R16F:
+		return 16;
+	case GS_RGBA:
+	case GS_BGRX:
+	case GS_BGRA:
+	case GS_R10G10B10A2:
+	case GS_RG16F:
+	case GS_R32F:
+		return 32;
+	case GS_RGBA16:
+	case GS_RGBA16F:
+	case GS_RG32F:
+		return 64;
+	case GS_RGBA32F:
+		return 128;
+	case GS_DXT1:
+		return 4;
+	case GS_DXT3:
+	case GS_DXT5:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+bool gs_is_compressed_format(enum gs_color_format format)
+{
+	return format == GS_DXT1 || format == GS_DXT3 || format == GS_DXT5;
+}
+
+gs_texture_t *gs_texture_create(uint32_t width, uint32_t height, enum gs_color_format color_format,
+				uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex;
+
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(flags);
+	stub_check_context("gs_texture_create");
+	if (!width || !height)
+		return NULL;
+
+	tex = calloc(1, sizeof(*tex));
+	tex->cx = width;
+	tex->cy = height;
+	tex->format = color_format;
+	os_atomic_inc_long(&stub_gfx.textures_created);
+	os_atomic_inc_long(&stub_gfx.textures_live);
+
+	if (data && *data) {
+		long long bytes = (long long)width * height * gs_get_format_bpp(color_format) / 8;
+		pthread_mutex_lock(&stub_upload_mutex);
+		stub_bytes_uploaded += bytes;
+		pthread_mutex_unlock(&stub_upload_mutex);
+		long delay = os_atomic_load_long(&stub_upload_delay_ms);
+		if (delay)
+			os_sleep_ms((uint32_t)delay);
+	}
+	return tex;
+}
+
+void stub_set_upload_delay(uint32_t ms)
+{
+	os_atomic_set_long(&stub_upload_delay_ms, (long)ms);
+}
+
+gs_texture_t *gs_texture_create_gdi(uint32_t width, uint32_t height)
+{
+	return gs_texture_create(width, height, GS_BGRA, 1, NULL, 0);
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+	stub_check_context("gs_texture_destroy");
+	os_atomic_inc_long(&stub_gfx.textures_destroyed);
+	os_atomic_dec_long(&stub_gfx.textures_live);
+	free(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex ? tex->cx : 0;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex ? tex->cy : 0;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex ? tex->format : GS_UNKNOWN;
+}
+
+static bool stub_region_fits(const gs_texture_t *tex, uint32_t x, uint32_t y, uint32_t cx, uint32_t cy)
+{
+	return (uint64_t)x + cx <= tex->cx && (uint64_t)y + cy <= tex->cy;
+}
+
+void gs_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y, gs_texture_t *src,
+			    uint32_t src_x, uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	stub_check_context("gs_copy_texture_region");
+	os_atomic_inc_long(&stub_gfx.copies);
+
+	if (!dst || !src) {
+		blog(LOG_ERROR, "gs_copy_texture_region: missing texture");
+		os_atomic_inc_long(&stub_gfx.out_of_bounds);
+		return;
+	}
+
+	//like libobs, a zero size copies the rest of the source
+	if (!src_w)
+		src_w = src->cx > src_x ? src->cx - src_x : 0;
+	if (!src_h)
+		src_h = src->cy > src_y ? src->cy - src_y : 0;
+
+	if (!stub_region_fits(src, src_x, src_y, src_w, src_h) ||
+	    !stub_region_fits(dst, dst_x, dst_y, src_w, src_h)) {
+		blog(LOG_ERROR,
+		     "gs_copy_texture_region: %ux%u from (%u,%u) of %ux%u to (%u,%u) of %ux%u is out of bounds",
+		     src_w, src_h, src_x, src_y, src->cx, src->cy, dst_x, dst_y, dst->cx, dst->cy);
+		os_atomic_inc_long(&stub_gfx.out_of_bounds);
+	}
+}
+
+void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width, uint32_t height)
+{
+	UNUSED_PARAMETER(flip);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	stub_check_context("gs_draw_sprite");
+	os_atomic_inc_long(&stub_gfx.draws);
+	if (!tex)
+		os_atomic_inc_long(&stub_gfx.out_of_bounds);
+}
+
+void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip, uint32_t x, uint32_t y,
+			      uint32_t cx, uint32_t cy)
+{
+	UNUSED_PARAMETER(flip);
+	stub_check_context("gs_draw_sprite_subregion");
+	os_atomic_inc_long(&stub_gfx.draws);
+	if (!tex || !stub_region_fits(tex, x, y, cx, cy)) {
+		blog(LOG_ERROR, "gs_draw_sprite_subregion: region out of bounds");
+		os_atomic_inc_long(&stub_gfx.out_of_bounds);
+	}
+}
+
+static gs_eparam_t *stub_param = (gs_eparam_t *)&stub_gfx;
+
+gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *name)
+{
+	UNUSED_PARAMETER(effect);
+	UNUSED_PARAMETER(name);
+	return stub_param;
+}
+
+void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+	stub_check_context("gs_effect_set_texture");
+}
+
+void gs_matrix_push(void)
+{
+	stub_check_context("gs_matrix_push");
+}
+
+void gs_matrix_pop(void)
+{
+	stub_check_context("gs_matrix_pop");
+}
+
+void gs_matrix_translate3f(float x, float y, float z)
+{
+	UNUSED_PARAMETER(x);
+	UNUSED_PARAMETER(y);
+	UNUSED_PARAMETER(z);
+}
+
+void gs_matrix_scale3f(float x, float y, float z)
+{
+	UNUSED_PARAMETER(x);
+	UNUSED_PARAMETER(y);
+	UNUSED_PARAMETER(z);
+}
+
+void gs_flush(void)
+{
+	stub_check_context("gs_flush");
+}
+
+/* ------------------------------------------------------------------------- */
+/* jpeg                                                                      */
+
+struct stub_jpeg_error {
+	struct jpeg_error_mgr mgr;
+	jmp_buf jump;
+};
+
+static void stub_jpeg_fail(j_common_ptr cinfo)
+{
+	struct stub_jpeg_error *err = (struct stub_jpeg_error *)cinfo->err;
+	longjmp(err->jump, 1);
+}
+
+static void stub_jpeg_quiet(j_common_ptr cinfo)
+{
+	UNUSED_PARAMETER(cinfo);
+}
+
+void stub_set_decode_delay(uint32_t ms)
+{
+	os_atomic_set_long(&stub_decode_delay_ms, (long)ms);
+}
+
+uint8_t *gs_create_texture_file_data(const char *file, enum gs_color_format *format,
+				     uint32_t *cx, uint32_t *cy)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct stub_jpeg_error err;
+	uint8_t *volatile pixels = NULL;
+	uint8_t *row = NULL;
+	FILE *fp = fopen(file, "rb");
+
+	if (!fp)
+		return NULL;
+	long delay = os_atomic_load_long(&stub_decode_delay_ms);
+	if (delay)
+		os_sleep_ms((uint32_t)delay);
+
+	cinfo.err = jpeg_std_error(&err.mgr);
+	err.mgr.error_exit = stub_jpeg_fail;
+	err.mgr.output_message = stub_jpeg_quiet;
+	if (setjmp(err.jump)) {
+		jpeg_destroy_decompress(&cinfo);
+		fclose(fp);
+		bfree(pixels);
+		free(row);
+		return NULL;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, fp);
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&cinfo);
+
+	pixels = bmalloc((size_t)cinfo.output_width * cinfo.output_height * 4);
+	row = malloc((size_t)cinfo.output_width * 3);
+	while (cinfo.output_scanline < cinfo.output_height) {
+		uint8_t *out = pixels + (size_t)cinfo.output_scanline * cinfo.output_width * 4;
+		JSAMPROW rows[1] = {row};
+		jpeg_read_scanlines(&cinfo, rows, 1);
+		for (uint32_t x = 0; x < cinfo.output_width; x++) {
+			out[x * 4 + 0] = row[x * 3 + 0];
+			out[x * 4 + 1] = row[x * 3 + 1];
+			out[x * 4 + 2] = row[x * 3 + 2];
+			out[x * 4 + 3] = 255;
+		}
+	}
+
+	*format = GS_RGBA;
+	*cx = cinfo.output_width;
+	*cy = cinfo.output_height;
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	fclose(fp);
+	free(row);
+	os_atomic_inc_long(&stub_gfx.decodes);
+	return pixels;
+}
+
+uint8_t *stub_encode_jpeg(uint32_t cx, uint32_t cy, uint32_t seed, size_t *size)
+{
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	unsigned char *buffer = NULL;
+	unsigned long length = 0;
+	uint8_t *row = malloc((size_t)cx * 3);
+	uint8_t *result;
+
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_mem_dest(&cinfo, &buffer, &length);
+	cinfo.image_width = cx;
+	cinfo.image_height = cy;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, 85, TRUE);
+	jpeg_start_compress(&cinfo, TRUE);
+
+	while (cinfo.next_scanline < cy) {
+		uint32_t y = cinfo.next_scanline;
+		JSAMPROW rows[1] = {row};
+		for (uint32_t x = 0; x < cx; x++) {
+			row[x * 3 + 0] = (uint8_t)(x * 255 / cx + seed * 37);
+			row[x * 3 + 1] = (uint8_t)(y * 255 / cy + seed * 91);
+			row[x * 3 + 2] = (uint8_t)((x ^ y) + seed * 13);
+		}
+		jpeg_write_scanlines(&cinfo, rows, 1);
+	}
+
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	free(row);
+
+	result = bmemdup(buffer, length);
+	free(buffer);
+	*size = length;
+	return result;
+}
+
+bool stub_write_jpeg(const char *path, uint32_t cx, uint32_t cy, uint32_t seed)
+{
+	size_t size;
+	uint8_t *data = stub_encode_jpeg(cx, cy, seed, &size);
+	FILE *fp = fopen(path, "wb");
+	bool ok = fp && fwrite(data, 1, size, fp) == size;
+
+	if (fp)
+		ok = fclose(fp) == 0 && ok;
+	bfree(data);
+	return ok;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+/*
+ * Headless stand-in for the parts of libobs the plugin uses.  Data, file and
+ * threading helpers behave like libobs, graphics calls are only recorded.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "util/bmem.h"
+#include "util/base.h"
+
+#define UNUSED_PARAMETER(param) (void)param
+#define EXPORT
+
+typedef struct obs_source obs_source_t;
+typedef struct obs_data obs_data_t;
+typedef struct obs_data_array obs_data_array_t;
+typedef struct obs_properties obs_properties_t;
+typedef struct obs_property obs_property_t;
+typedef struct gs_effect gs_effect_t;
+typedef struct gs_effect_param gs_eparam_t;
+typedef struct gs_texture gs_texture_t;
+typedef struct obs_hotkey obs_hotkey_t;
+typedef size_t obs_hotkey_id;
+
+#define OBS_INVALID_HOTKEY_ID (~(obs_hotkey_id)0)
+
+typedef void (*obs_hotkey_func)(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
+typedef bool (*obs_property_clicked_t)(obs_properties_t *props, obs_property_t *property, void *data);
+
+enum gs_color_format {
+	GS_UNKNOWN,
+	GS_A8,
+	GS_R8,
+	GS_RGBA,
+	GS_BGRX,
+	GS_BGRA,
+	GS_R10G10B10A2,
+	GS_RGBA16,
+	GS_R16,
+	GS_RGBA16F,
+	GS_RGBA32F,
+	GS_RG16F,
+	GS_RG32F,
+	GS_R16F,
+	GS_R32F,
+	GS_DXT1,
+	GS_DXT3,
+	GS_DXT5,
+};
+
+#define GS_DYNAMIC (1 << 1)
+#define GS_RENDER_TARGET (1 << 2)
+
+enum obs_source_type {
+	OBS_SOURCE_TYPE_INPUT,
+	OBS_SOURCE_TYPE_FILTER,
+	OBS_SOURCE_TYPE_TRANSITION,
+	OBS_SOURCE_TYPE_SCENE,
+};
+
+#define OBS_SOURCE_VIDEO (1 << 0)
+#define OBS_SOURCE_CUSTOM_DRAW (1 << 3)
+
+enum obs_text_type {
+	OBS_TEXT_DEFAULT,
+	OBS_TEXT_PASSWORD,
+	OBS_TEXT_MULTILINE,
+	OBS_TEXT_INFO,
+};
+
+enum obs_path_type {
+	OBS_PATH_FILE,
+	OBS_PATH_FILE_SAVE,
+	OBS_PATH_DIRECTORY,
+};
+
+enum obs_combo_type {
+	OBS_COMBO_TYPE_INVALID,
+	OBS_COMBO_TYPE_EDITABLE,
+	OBS_COMBO_TYPE_LIST,
+};
+
+enum obs_combo_format {
+	OBS_COMBO_FORMAT_INVALID,
+	OBS_COMBO_FORMAT_INT,
+	OBS_COMBO_FORMAT_FLOAT,
+	OBS_COMBO_FORMAT_STRING,
+};
+
+struct obs_video_info {
+	const char *graphics_module;
+	uint32_t fps_num;
+	uint32_t fps_den;
+	uint32_t base_width;
+	uint32_t base_height;
+	uint32_t output_width;
+	uint32_t output_height;
+};
+
+struct obs_source_info {
+	const char *id;
+	enum obs_source_type type;
+	uint32_t output_flags;
+	const char *(*get_name)(void *type_data);
+	void *(*create)(obs_data_t *settings, obs_source_t *source);
+	void (*destroy)(void *data);
+	uint32_t (*get_width)(void *data);
+	uint32_t (*get_height)(void *data);
+	void (*get_defaults)(obs_data_t *settings);
+	obs_properties_t *(*get_properties)(void *data);
+	void (*update)(void *data, obs_data_t *settings);
+	void (*save)(void *data, obs_data_t *settings);
+	void (*activate)(void *data);
+	void (*deactivate)(void *data);
+	void (*show)(void *data);
+	void (*hide)(void *data);
+	void (*video_tick)(void *data, float seconds);
+	void (*video_render)(void *data, gs_effect_t *effect);
+};
+
+#define OBS_DECLARE_MODULE()
+#define OBS_MODULE_USE_DEFAULT_LOCALE(module_name, default_locale)
+
+/* module and sources */
+const char *obs_module_text(const char *lookup_string);
+void obs_register_source(struct obs_source_info *info);
+bool obs_module_load(void);
+void obs_module_unload(void);
+
+const char *obs_source_get_name(const obs_source_t *source);
+obs_data_t *obs_source_get_settings(const obs_source_t *source);
+
+void obs_enter_graphics(void);
+void obs_leave_graphics(void);
+uint64_t obs_get_video_frame_time(void);
+bool obs_get_video_info(struct obs_video_info *ovi);
+
+obs_hotkey_id obs_hotkey_register_source(obs_source_t *source, const char *name,
+					 const char *description, obs_hotkey_func func, void *data);
+void obs_hotkey_unregister(obs_hotkey_id id);
+
+/* settings */
+obs_data_t *obs_data_create(void);
+obs_data_t *obs_data_create_from_json(const char *json_string);
+obs_data_t *obs_data_create_from_json_file(const char *json_file);
+void obs_data_addref(obs_data_t *data);
+void obs_data_release(obs_data_t *data);
+const char *obs_data_get_json(obs_data_t *data);
+bool obs_data_save_json(obs_data_t *data, const char *file);
+bool obs_data_save_json_safe(obs_data_t *data, const char *file, const char *temp_ext,
+			     const char *backup_ext);
+void obs_data_erase(obs_data_t *data, const char *name);
+bool obs_data_has_user_value(obs_data_t *data, const char *name);
+
+void obs_data_set_string(obs_data_t *data, const char *name, const char *val);
+void obs_data_set_int(obs_data_t *data, const char *name, long long val);
+void obs_data_set_double(obs_data_t *data, const char *name, double val);
+void obs_data_set_bool(obs_data_t *data, const char *name, bool val);
+void obs_data_set_obj(obs_data_t *data, const char *name, obs_data_t *obj);
+void obs_data_set_array(obs_data_t *data, const char *name, obs_data_array_t *array);
+
+void obs_data_set_default_string(obs_data_t *data, const char *name, const char *val);
+void obs_data_set_default_int(obs_data_t *data, const char *name, long long val);
+void obs_data_set_default_double(obs_data_t *data, const char *name, double val);
+void obs_data_set_default_bool(obs_data_t *data, const char *name, bool val);
+
+const char *obs_data_get_string(obs_data_t *data, const char *name);
+long long obs_data_get_int(obs_data_t *data, const char *name);
+double obs_data_get_double(obs_data_t *data, const char *name);
+bool obs_data_get_bool(obs_data_t *data, const char *name);
+obs_data_t *obs_data_get_obj(obs_data_t *data, const char *name);
+obs_data_array_t *obs_data_get_array(obs_data_t *data, const char *name);
+
+obs_data_array_t *obs_data_array_create(void);
+void obs_data_array_addref(obs_data_array_t *array);
+void obs_data_array_release(obs_data_array_t *array);
+size_t obs_data_array_count(obs_data_array_t *array);
+obs_data_t *obs_data_array_item(obs_data_array_t *array, size_t idx);
+size_t obs_data_array_push_back(obs_data_array_t *array, obs_data_t *obj);
+
+/* properties */
+obs_properties_t *obs_properties_create(void);
+void obs_properties_destroy(obs_properties_t *props);
+obs_property_t *obs_properties_get(obs_properties_t *props, const char *property);
+obs_property_t *obs_properties_add_bool(obs_properties_t *props, const char *name,
+					const char *description);
+obs_property_t *obs_properties_add_int(obs_properties_t *props, const char *name,
+				       const char *description, int min, int max, int step);
+obs_property_t *obs_properties_add_text(obs_properties_t *props, const char *name,
+					const char *description, enum obs_text_type type);
+obs_property_t *obs_properties_add_path(obs_properties_t *props, const char *name,
+					const char *description, enum obs_path_type type,
+					const char *filter, const char *default_path);
+obs_property_t *obs_properties_add_list(obs_properties_t *props, const char *name,
+					const char *description, enum obs_combo_type type,
+					enum obs_combo_format format);
+obs_property_t *obs_properties_add_color(obs_properties_t *props, const char *name,
+					 const char *description);
+obs_property_t *obs_properties_add_button(obs_properties_t *props, const char *name,
+					  const char *text, obs_property_clicked_t callback);
+size_t obs_property_list_add_string(obs_property_t *p, const char *name, const char *val);
+void obs_property_set_enabled(obs_property_t *p, bool enabled);
+void obs_property_set_long_description(obs_property_t *p, const char *long_description);
+const char *obs_property_description(obs_property_t *p);
+enum obs_text_type obs_property_text_type(obs_property_t *p);
+int obs_property_int_max(obs_property_t *p);
+bool obs_property_button_clicked(obs_property_t *p, void *obj);
+
+/* graphics */
+gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *name);
+void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val);
+
+gs_texture_t *gs_texture_create(uint32_t width, uint32_t height, enum gs_color_format color_format,
+				uint32_t levels, const uint8_t **data, uint32_t flags);
+gs_texture_t *gs_texture_create_gdi(uint32_t width, uint32_t height);
+void gs_texture_destroy(gs_texture_t *tex);
+uint32_t gs_texture_get_width(const gs_texture_t *tex);
+uint32_t gs_texture_get_height(const gs_texture_t *tex);
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex);
+void gs_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y, gs_texture_t *src,
+			    uint32_t src_x, uint32_t src_y, uint32_t src_w, uint32_t src_h);
+void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width, uint32_t height);
+void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip, uint32_t x, uint32_t y,
+			      uint32_t cx, uint32_t cy);
+void gs_matrix_push(void);
+void gs_matrix_pop(void);
+void gs_matrix_translate3f(float x, float y, float z);
+void gs_matrix_scale3f(float x, float y, float z);
+void gs_flush(void);
+uint32_t gs_get_format_bpp(enum gs_color_format format);
+bool gs_is_compressed_format(enum gs_color_format format);
+uint8_t *gs_create_texture_file_data(const char *file, enum gs_color_format *format,
+				     uint32_t *cx, uint32_t *cy);
@@ -0,0 +1,335 @@
+/*
+ * Module, source, hotkey, property and video globals.
+ */
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include "dm-stub.h"
+
+struct obs_source {
+	char *name;
+	obs_data_t *settings;
+};
+
+struct stub_hotkey {
+	obs_source_t *source;
+	char *name;
+	obs_hotkey_func func;
+	void *data;
+	bool registered;
+};
+
+#define STUB_MAX_HOTKEYS 64
+
+static struct stub_hotkey stub_hotkeys[STUB_MAX_HOTKEYS];
+static size_t stub_hotkey_count;
+static pthread_mutex_t stub_hotkey_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t stub_video_cx = 1920;
+static uint32_t stub_video_cy = 1080;
+
+const char *obs_module_text(const char *lookup_string)
+{
+	return lookup_string;
+}
+
+void obs_register_source(struct obs_source_info *info)
+{
+	UNUSED_PARAMETER(info);
+}
+
+obs_source_t *stub_source_create(const char *name, obs_data_t *settings)
+{
+	obs_source_t *source = calloc(1, sizeof(*source));
+	source->name = strdup(name);
+	source->settings = settings;
+	obs_data_addref(settings);
+	return source;
+}
+
+void stub_source_destroy(obs_source_t *source)
+{
+	if (!source)
+		return;
+
+	pthread_mutex_lock(&stub_hotkey_mutex);
+	for (size_t i = 0; i < stub_hotkey_count; i++) {
+		if (stub_hotkeys[i].source == source)
+			stub_hotkeys[i].registered = false;
+	}
+	pthread_mutex_unlock(&stub_hotkey_mutex);
+
+	obs_data_release(source->settings);
+	free(source->name);
+	free(source);
+}
+
+const char *obs_source_get_name(const obs_source_t *source)
+{
+	return source ? source->name : "";
+}
+
+obs_data_t *obs_source_get_settings(const obs_source_t *source)
+{
+	if (!source)
+		return NULL;
+	obs_data_addref(source->settings);
+	return source->settings;
+}
+
+obs_hotkey_id obs_hotkey_register_source(obs_source_t *source, const char *name,
+					 const char *description, obs_hotkey_func func, void *data)
+{
+	obs_hotkey_id id = OBS_INVALID_HOTKEY_ID;
+
+	UNUSED_PARAMETER(description);
+	pthread_mutex_lock(&stub_hotkey_mutex);
+	if (stub_hotkey_count < STUB_MAX_HOTKEYS) {
+		struct stub_hotkey *hotkey = &stub_hotkeys[stub_hotkey_count];
+		hotkey->source = source;
+		hotkey->name = strdup(name);
+		hotkey->func = func;
+		hotkey->data = data;
+		hotkey->registered = true;
+		id = stub_hotkey_count++;
+	}
+	pthread_mutex_unlock(&stub_hotkey_mutex);
+	return id;
+}
+
+void obs_hotkey_unregister(obs_hotkey_id id)
+{
+	pthread_mutex_lock(&stub_hotkey_mutex);
+	if (id < stub_hotkey_count)
+		stub_hotkeys[id].registered = false;
+	pthread_mutex_unlock(&stub_hotkey_mutex);
+}
+
+bool stub_hotkey_press(const char *name)
+{
+	bool found = false;
+
+	for (size_t i = 0; i < stub_hotkey_count; i++) {
+		struct stub_hotkey *hotkey = &stub_hotkeys[i];
+		if (!hotkey->registered || strcmp(hotkey->name, name) != 0)
+			continue;
+		hotkey->func(hotkey->data, i, NULL, true);
+		hotkey->func(hotkey->data, i, NULL, false);
+		found = true;
+	}
+	return found;
+}
+
+void stub_set_video_size(uint32_t cx, uint32_t cy)
+{
+	stub_video_cx = cx;
+	stub_video_cy = cy;
+}
+
+bool obs_get_video_info(struct obs_video_info *ovi)
+{
+	memset(ovi, 0, sizeof(*ovi));
+	ovi->graphics_module = "stub";
+	ovi->fps_num = 60;
+	ovi->fps_den = 1;
+	ovi->base_width = stub_video_cx;
+	ovi->base_height = stub_video_cy;
+	ovi->output_width = stub_video_cx;
+	ovi->output_height = stub_video_cy;
+	return true;
+}
+
+uint64_t obs_get_video_frame_time(void)
+{
+	return os_gettime_ns();
+}
+
+/* ------------------------------------------------------------------------- */
+/* properties                                                                */
+
+enum stub_property_type {
+	STUB_PROP_BOOL,
+	STUB_PROP_INT,
+	STUB_PROP_TEXT,
+	STUB_PROP_PATH,
+	STUB_PROP_LIST,
+	STUB_PROP_COLOR,
+	STUB_PROP_BUTTON,
+};
+
+struct obs_property {
+	enum stub_property_type type;
+	char *name;
+	char *description;
+	char *long_description;
+	enum obs_text_type text_type;
+	int min;
+	int max;
+	bool enabled;
+	size_t items;
+	obs_property_clicked_t clicked;
+	obs_properties_t *parent;
+	struct obs_property *next;
+};
+
+struct obs_properties {
+	struct obs_property *first;
+	struct obs_property *last;
+};
+
+obs_properties_t *obs_properties_create(void)
+{
+	return calloc(1, sizeof(obs_properties_t));
+}
+
+void obs_properties_destroy(obs_properties_t *props)
+{
+	if (!props)
+		return;
+
+	for (struct obs_property *p = props->first, *next; p; p = next) {
+		next = p->next;
+		free(p->name);
+		free(p->description);
+		free(p->long_description);
+		free(p);
+	}
+	free(props);
+}
+
+obs_property_t *obs_properties_get(obs_properties_t *props, const char *property)
+{
+	for (struct obs_property *p = props ? props->first : NULL; p; p = p->next) {
+		if (strcmp(p->name, property) == 0)
+			return p;
+	}
+	return NULL;
+}
+
+static obs_property_t *stub_property_add(obs_properties_t *props, enum stub_property_type type,
+					 const char *name, const char *description)
+{
+	struct obs_property *p;
+
+	if (!props || obs_properties_get(props, name))
+		return NULL;
+
+	p = calloc(1, sizeof(*p));
+	p->type = type;
+	p->name = strdup(name);
+	p->description = strdup(description ? description : "");
+	p->enabled = true;
+	p->parent = props;
+	if (props->last)
+		props->last->next = p;
+	else
+		props->first = p;
+	props->last = p;
+	return p;
+}
+
+obs_property_t *obs_properties_add_bool(obs_properties_t *props, const char *name,
+					const char *description)
+{
+	return stub_property_add(props, STUB_PROP_BOOL, name, description);
+}
+
+obs_property_t *obs_properties_add_int(obs_properties_t *props, const char *name,
+				       const char *description, int min, int max, int step)
+{
+	obs_property_t *p = stub_property_add(props, STUB_PROP_INT, name, description);
+	UNUSED_PARAMETER(step);
+	if (p) {
+		p->min = min;
+		p->max = max;
+	}
+	return p;
+}
+
+obs_property_t *obs_properties_add_text(obs_properties_t *props, const char *name,
+					const char *description, enum obs_text_type type)
+{
+	obs_property_t *p = stub_property_add(props, STUB_PROP_TEXT, name, description);
+	if (p)
+		p->text_type = type;
+	return p;
+}
+
+obs_property_t *obs_properties_add_path(obs_properties_t *props, const char *name,
+					const char *description, enum obs_path_type type,
+					const char *filter, const char *default_path)
+{
+	UNUSED_PARAMETER(type);
+	UNUSED_PARAMETER(filter);
+	UNUSED_PARAMETER(default_path);
+	return stub_property_add(props, STUB_PROP_PATH, name, description);
+}
+
+obs_property_t *obs_properties_add_list(obs_properties_t *props, const char *name,
+					const char *description, enum obs_combo_type type,
+					enum obs_combo_format format)
+{
+	UNUSED_PARAMETER(type);
+	UNUSED_PARAMETER(format);
+	return stub_property_add(props, STUB_PROP_LIST, name, description);
+}
+
+obs_property_t *obs_properties_add_color(obs_properties_t *props, const char *name,
+					 const char *description)
+{
+	return stub_property_add(props, STUB_PROP_COLOR, name, description);
+}
+
+obs_property_t *obs_properties_add_button(obs_properties_t *props, const char *name,
+					  const char *text, obs_property_clicked_t callback)
+{
+	obs_property_t *p = stub_property_add(props, STUB_PROP_BUTTON, name, text);
+	if (p)
+		p->clicked = callback;
+	return p;
+}
+
+size_t obs_property_list_add_string(obs_property_t *p, const char *name, const char *val)
+{
+	UNUSED_PARAMETER(name);
+	UNUSED_PARAMETER(val);
+	return p ? p->items++ : 0;
+}
+
+void obs_property_set_enabled(obs_property_t *p, bool enabled)
+{
+	if (p)
+		p->enabled = enabled;
+}
+
+void obs_property_set_long_description(obs_property_t *p, const char *long_description)
+{
+	if (!p)
+		return;
+	free(p->long_description);
+	p->long_description = long_description ? strdup(long_description) : NULL;
+}
+
+const char *obs_property_description(obs_property_t *p)
+{
+	return p ? p->description : NULL;
+}
+
+enum obs_text_type obs_property_text_type(obs_property_t *p)
+{
+	return p ? p->text_type : OBS_TEXT_DEFAULT;
+}
+
+int obs_property_int_max(obs_property_t *p)
+{
+	return p ? p->max : 0;
+}
+
+bool obs_property_button_clicked(obs_property_t *p, void *obj)
+{
+	if (!p || !p->clicked)
+		return false;
+	return p->clicked(p->parent, p, obj);
+}
@@ -0,0 +1,1067 @@
+/*
+ * Memory, logging, containers, files, threads and the profiler, written to
+ * behave like their libobs counterparts closely enough for the plugin.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <obs-module.h>
+#include <util/crc32.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/task.h>
+#include <util/threading.h>
+
+#include "dm-stub.h"
+
+/* ------------------------------------------------------------------------- */
+/* memory and logging                                                        */
+
+static volatile long stub_allocs;
+static volatile long stub_live;
+static int stub_log_level = LOG_WARNING;
+static volatile long stub_logs[4];
+
+void *bmalloc(size_t size)
+{
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		abort();
+	os_atomic_inc_long(&stub_allocs);
+	os_atomic_inc_long(&stub_live);
+	return ptr;
+}
+
+void *brealloc(void *ptr, size_t size)
+{
+	if (!ptr)
+		return bmalloc(size);
+	ptr = realloc(ptr, size ? size : 1);
+	if (!ptr)
+		abort();
+	os_atomic_inc_long(&stub_allocs);
+	return ptr;
+}
+
+void bfree(void *ptr)
+{
+	if (!ptr)
+		return;
+	os_atomic_dec_long(&stub_live);
+	free(ptr);
+}
+
+long stub_alloc_count(void)
+{
+	return os_atomic_load_long(&stub_allocs);
+}
+
+long stub_alloc_live(void)
+{
+	return os_atomic_load_long(&stub_live);
+}
+
+void stub_set_log_level(int level)
+{
+	stub_log_level = level;
+}
+
+long stub_log_count(int level)
+{
+	return os_atomic_load_long(&stub_logs[level / 100 - 1]);
+}
+
+void blog(int log_level, const char *format, ...)
+{
+	if (log_level >= LOG_ERROR && log_level <= LOG_DEBUG)
+		os_atomic_inc_long(&stub_logs[log_level / 100 - 1]);
+	if (log_level > stub_log_level)
+		return;
+
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+/* ------------------------------------------------------------------------- */
+/* crc32, the zlib polynomial like libobs                                    */
+
+static uint32_t stub_crc_table[256];
+static pthread_once_t stub_crc_once = PTHREAD_ONCE_INIT;
+
+static void stub_crc_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for (int k = 0; k < 8; k++)
+			c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		stub_crc_table[i] = c;
+	}
+}
+
+uint32_t calc_crc32(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	pthread_once(&stub_crc_once, stub_crc_init);
+	crc = ~crc;
+	while (size--)
+		crc = stub_crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+/* ------------------------------------------------------------------------- */
+/* darray                                                                    */
+
+static inline void *darray_item(size_t element_size, const struct darray *da, size_t idx)
+{
+	return (uint8_t *)da->array + element_size * idx;
+}
+
+static void darray_ensure_capacity(size_t element_size, struct darray *dst, size_t new_size)
+{
+	size_t new_cap;
+	void *ptr;
+
+	if (new_size <= dst->capacity)
+		return;
+
+	new_cap = !dst->capacity ? new_size : dst->capacity * 2;
+	if (new_size > new_cap)
+		new_cap = new_size;
+	ptr = bmalloc(element_size * new_cap);
+	if (dst->array) {
+		if (dst->capacity)
+			memcpy(ptr, dst->array, element_size * dst->capacity);
+		bfree(dst->array);
+	}
+	dst->array = ptr;
+	dst->capacity = new_cap;
+}
+
+void darray_free(struct darray *dst)
+{
+	bfree(dst->array);
+	dst->array = NULL;
+	dst->num = 0;
+	dst->capacity = 0;
+}
+
+void darray_reserve(const size_t element_size, struct darray *dst, const size_t capacity)
+{
+	void *ptr;
+
+	if (capacity == 0 || capacity <= dst->capacity)
+		return;
+
+	ptr = bmalloc(element_size * capacity);
+	if (dst->array) {
+		if (dst->num)
+			memcpy(ptr, dst->array, element_size * dst->num);
+		bfree(dst->array);
+	}
+	dst->array = ptr;
+	dst->capacity = capacity;
+}
+
+void darray_resize(const size_t element_size, struct darray *dst, const size_t size)
+{
+	size_t old_num;
+	bool clear;
+
+	if (size == dst->num)
+		return;
+	if (size == 0) {
+		dst->num = 0;
+		return;
+	}
+
+	clear = size > dst->num;
+	old_num = dst->num;
+	darray_ensure_capacity(element_size, dst, size);
+	dst->num = size;
+	if (clear)
+		memset(darray_item(element_size, dst, old_num), 0, element_size * (dst->num - old_num));
+}
+
+void darray_copy(const size_t element_size, struct darray *dst, const struct darray *da)
+{
+	if (da->num == 0) {
+		darray_free(dst);
+	}
+	else {
+		darray_resize(element_size, dst, da->num);
+		memcpy(dst->array, da->array, element_size * da->num);
+	}
+}
+
+size_t darray_push_back(const size_t element_size, struct darray *dst, const void *item)
+{
+	darray_ensure_capacity(element_size, dst, ++dst->num);
+	memcpy(darray_item(element_size, dst, dst->num - 1), item, element_size);
+	return dst->num - 1;
+}
+
+void *darray_push_back_new(const size_t element_size, struct darray *dst)
+{
+	void *last;
+
+	darray_ensure_capacity(element_size, dst, ++dst->num);
+	last = darray_item(element_size, dst, dst->num - 1);
+	memset(last, 0, element_size);
+	return last;
+}
+
+size_t darray_push_back_array(const size_t element_size, struct darray *dst, const void *array,
+			      const size_t num)
+{
+	size_t old_num;
+
+	if (!array || !num)
+		return dst->num;
+
+	old_num = dst->num;
+	darray_resize(element_size, dst, dst->num + num);
+	memcpy(darray_item(element_size, dst, old_num), array, element_size * num);
+	return old_num;
+}
+
+void *darray_insert_new(const size_t element_size, struct darray *dst, const size_t idx)
+{
+	void *item;
+	size_t move_count;
+
+	if (idx >= dst->num)
+		return darray_push_back_new(element_size, dst);
+
+	move_count = dst->num - idx;
+	darray_ensure_capacity(element_size, dst, ++dst->num);
+	item = darray_item(element_size, dst, idx);
+	memmove(darray_item(element_size, dst, idx + 1), item, move_count * element_size);
+	memset(item, 0, element_size);
+	return item;
+}
+
+void darray_insert(const size_t element_size, struct darray *dst, const size_t idx, const void *item)
+{
+	void *new_item = darray_insert_new(element_size, dst, idx);
+	memcpy(new_item, item, element_size);
+}
+
+void darray_erase(const size_t element_size, struct darray *dst, const size_t idx)
+{
+	if (idx >= dst->num || !--dst->num)
+		return;
+
+	memmove(darray_item(element_size, dst, idx), darray_item(element_size, dst, idx + 1),
+		element_size * (dst->num - idx));
+}
+
+void darray_erase_range(const size_t element_size, struct darray *dst, const size_t start,
+			const size_t end)
+{
+	size_t count, move_count, last = end;
+
+	if (start >= dst->num)
+		return;
+	if (last > dst->num)
+		last = dst->num;
+
+	count = last - start;
+	if (!count)
+		return;
+	if (count == dst->num) {
+		dst->num = 0;
+		return;
+	}
+
+	move_count = dst->num - last;
+	if (move_count)
+		memmove(darray_item(element_size, dst, start), darray_item(element_size, dst, last),
+			move_count * element_size);
+	dst->num -= count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* dstr                                                                      */
+
+static void dstr_ensure_capacity(struct dstr *dst, size_t new_size)
+{
+	size_t new_cap;
+
+	if (new_size <= dst->capacity)
+		return;
+
+	new_cap = !dst->capacity ? new_size : dst->capacity * 2;
+	if (new_size > new_cap)
+		new_cap = new_size;
+	dst->array = brealloc(dst->array, new_cap);
+	dst->capacity = new_cap;
+}
+
+void dstr_free(struct dstr *dst)
+{
+	bfree(dst->array);
+	dst->array = NULL;
+	dst->len = 0;
+	dst->capacity = 0;
+}
+
+void dstr_copy(struct dstr *dst, const char *array)
+{
+	if (dst->array)
+		dstr_free(dst);
+	if (!array || !*array)
+		return;
+
+	dst->len = strlen(array);
+	dst->capacity = dst->len + 1;
+	dst->array = bmemdup(array, dst->capacity);
+}
+
+void dstr_ncopy(struct dstr *dst, const char *array, const size_t len)
+{
+	if (dst->array)
+		dstr_free(dst);
+	if (!len)
+		return;
+
+	dst->array = bmalloc(len + 1);
+	memcpy(dst->array, array, len);
+	dst->array[len] = 0;
+	dst->len = len;
+	dst->capacity = len + 1;
+}
+
+void dstr_ncat(struct dstr *dst, const char *array, const size_t len)
+{
+	size_t new_len;
+
+	if (!array || !*array || !len)
+		return;
+
+	new_len = dst->len + len;
+	dstr_ensure_capacity(dst, new_len + 1);
+	memcpy(dst->array + dst->len, array, len);
+	dst->len = new_len;
+	dst->array[new_len] = 0;
+}
+
+void dstr_cat(struct dstr *dst, const char *array)
+{
+	if (array && *array)
+		dstr_ncat(dst, array, strlen(array));
+}
+
+void dstr_cat_ch(struct dstr *dst, char ch)
+{
+	dstr_ensure_capacity(dst, ++dst->len + 1);
+	dst->array[dst->len - 1] = ch;
+	dst->array[dst->len] = 0;
+}
+
+void dstr_insert(struct dstr *dst, const size_t idx, const char *array)
+{
+	size_t len;
+
+	if (!array || !*array)
+		return;
+	if (idx == dst->len) {
+		dstr_cat(dst, array);
+		return;
+	}
+
+	len = strlen(array);
+	dstr_ensure_capacity(dst, dst->len + len + 1);
+	memmove(dst->array + idx + len, dst->array + idx, dst->len - idx + 1);
+	memcpy(dst->array + idx, array, len);
+	dst->len += len;
+}
+
+void dstr_resize(struct dstr *dst, const size_t num)
+{
+	if (!num) {
+		dstr_free(dst);
+		return;
+	}
+
+	dstr_ensure_capacity(dst, num + 1);
+	dst->array[num] = 0;
+	dst->len = num;
+}
+
+void dstr_vcatf(struct dstr *dst, const char *format, va_list args)
+{
+	va_list copy;
+	int len;
+
+	va_copy(copy, args);
+	len = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	if (len <= 0)
+		return;
+
+	dstr_ensure_capacity(dst, dst->len + (size_t)len + 1);
+	vsnprintf(dst->array + dst->len, (size_t)len + 1, format, args);
+	dst->len += (size_t)len;
+}
+
+void dstr_vprintf(struct dstr *dst, const char *format, va_list args)
+{
+	if (dst->array) {
+		dst->len = 0;
+		dst->array[0] = 0;
+	}
+	dstr_vcatf(dst, format, args);
+	if (!dst->len)
+		dstr_free(dst);
+}
+
+void dstr_printf(struct dstr *dst, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	dstr_vprintf(dst, format, args);
+	va_end(args);
+}
+
+void dstr_catf(struct dstr *dst, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	dstr_vcatf(dst, format, args);
+	va_end(args);
+}
+
+int astrcmpi(const char *str1, const char *str2)
+{
+	if (!str1)
+		str1 = "";
+	if (!str2)
+		str2 = "";
+
+	do {
+		int ch1 = toupper((unsigned char)*str1);
+		int ch2 = toupper((unsigned char)*str2);
+		if (ch1 < ch2)
+			return -1;
+		else if (ch1 > ch2)
+			return 1;
+	} while (*str1++ && *str2++);
+
+	return 0;
+}
+
+int astrcmpi_n(const char *str1, const char *str2, size_t n)
+{
+	if (!n)
+		return 0;
+	if (!str1)
+		str1 = "";
+	if (!str2)
+		str2 = "";
+
+	do {
+		int ch1 = toupper((unsigned char)*str1);
+		int ch2 = toupper((unsigned char)*str2);
+		if (ch1 < ch2)
+			return -1;
+		else if (ch1 > ch2)
+			return 1;
+	} while (*str1++ && *str2++ && --n);
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* files                                                                     */
+
+FILE *os_fopen(const char *path, const char *mode)
+{
+	return path ? fopen(path, mode) : NULL;
+}
+
+int os_stat(const char *file, struct stat *st)
+{
+	return stat(file, st);
+}
+
+bool os_file_exists(const char *path)
+{
+	return path && access(path, F_OK) == 0;
+}
+
+int os_unlink(const char *path)
+{
+	return unlink(path);
+}
+
+int os_rename(const char *old_path, const char *new_path)
+{
+	return rename(old_path, new_path);
+}
+
+const char *os_get_path_extension(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	const char *dot = strrchr(path, '.');
+	if (!dot || (slash && dot < slash))
+		return NULL;
+	return dot;
+}
+
+int os_mkdir(const char *path)
+{
+	if (mkdir(path, 0755) == 0)
+		return MKDIR_SUCCESS;
+	return errno == EEXIST ? MKDIR_EXISTS : MKDIR_ERROR;
+}
+
+int os_mkdirs(const char *path)
+{
+	char *copy = bstrdup(path);
+	int result = MKDIR_EXISTS;
+
+	for (char *p = copy + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = 0;
+		os_mkdir(copy);
+		*p = '/';
+	}
+	result = os_mkdir(copy);
+	bfree(copy);
+	return result;
+}
+
+void os_sleep_ms(uint32_t duration)
+{
+	struct timespec ts = {duration / 1000, (long)(duration % 1000) * 1000000};
+	nanosleep(&ts, NULL);
+}
+
+int os_get_logical_cores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+
+uint64_t os_gettime_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+char *os_quick_read_utf8_file(const char *path)
+{
+	FILE *file = path ? fopen(path, "rb") : NULL;
+	char *text;
+	long size;
+
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size < 0) {
+		fclose(file);
+		return NULL;
+	}
+
+	text = bmalloc((size_t)size + 1);
+	size = (long)fread(text, 1, (size_t)size, file);
+	text[size] = 0;
+	fclose(file);
+
+	if (size >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0)
+		memmove(text, text + 3, (size_t)size - 2);
+	return text;
+}
+
+bool os_quick_write_utf8_file(const char *path, const char *str, size_t len, bool marker)
+{
+	FILE *file = path ? fopen(path, "wb") : NULL;
+	bool ok;
+
+	if (!file)
+		return false;
+
+	ok = !marker || fwrite("\xEF\xBB\xBF", 1, 3, file) == 3;
+	if (ok && len)
+		ok = fwrite(str, 1, len, file) == len;
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
+
+bool os_quick_write_utf8_file_safe(const char *path, const char *str, size_t len, bool marker,
+				   const char *temp_ext, const char *backup_ext)
+{
+	struct dstr temp = {0};
+	struct dstr backup = {0};
+	bool ok = false;
+
+	if (!temp_ext || !*temp_ext)
+		return false;
+
+	dstr_copy(&temp, path);
+	if (*temp_ext != '.')
+		dstr_cat(&temp, ".");
+	dstr_cat(&temp, temp_ext);
+
+	if (os_quick_write_utf8_file(temp.array, str, len, marker)) {
+		if (backup_ext && *backup_ext && os_file_exists(path)) {
+			dstr_copy(&backup, path);
+			if (*backup_ext != '.')
+				dstr_cat(&backup, ".");
+			dstr_cat(&backup, backup_ext);
+			os_unlink(backup.array);
+			link(path, backup.array);
+		}
+		ok = rename(temp.array, path) == 0;
+	}
+
+	dstr_free(&temp);
+	dstr_free(&backup);
+	return ok;
+}
+
+struct os_dir {
+	DIR *dir;
+	char *path;
+	struct os_dirent out;
+};
+
+os_dir_t *os_opendir(const char *path)
+{
+	DIR *dir = path ? opendir(path) : NULL;
+	struct os_dir *result;
+
+	if (!dir)
+		return NULL;
+
+	result = calloc(1, sizeof(*result));
+	result->dir = dir;
+	result->path = strdup(path);
+	return result;
+}
+
+struct os_dirent *os_readdir(os_dir_t *dir)
+{
+	struct dirent *entry;
+
+	if (!dir)
+		return NULL;
+
+	entry = readdir(dir->dir);
+	if (!entry)
+		return NULL;
+
+	snprintf(dir->out.d_name, sizeof(dir->out.d_name), "%s", entry->d_name);
+	if (entry->d_type == DT_UNKNOWN) {
+		char full[4096];
+		struct stat st;
+		snprintf(full, sizeof(full), "%s/%s", dir->path, entry->d_name);
+		dir->out.directory = stat(full, &st) == 0 && S_ISDIR(st.st_mode);
+	}
+	else {
+		dir->out.directory = entry->d_type == DT_DIR;
+	}
+	return &dir->out;
+}
+
+void os_closedir(os_dir_t *dir)
+{
+	if (!dir)
+		return;
+	closedir(dir->dir);
+	free(dir->path);
+	free(dir);
+}
+
+char *stub_temp_dir(const char *prefix)
+{
+	const char *base = getenv("TMPDIR");
+	struct dstr path = {0};
+
+	dstr_printf(&path, "%s/%s-XXXXXX", base && *base ? base : "/tmp", prefix);
+	if (!mkdtemp(path.array)) {
+		dstr_free(&path);
+		return NULL;
+	}
+	return path.array;
+}
+
+static int stub_remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+	UNUSED_PARAMETER(st);
+	UNUSED_PARAMETER(flag);
+	UNUSED_PARAMETER(ftw);
+	return remove(path);
+}
+
+void stub_remove_dir(const char *path)
+{
+	if (path && *path)
+		nftw(path, stub_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* ------------------------------------------------------------------------- */
+/* threading                                                                 */
+
+struct os_event_data {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	volatile bool signalled;
+	bool manual;
+};
+
+int os_event_init(os_event_t **event, enum os_event_type type)
+{
+	struct os_event_data *data = calloc(1, sizeof(*data));
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&data->mutex, NULL);
+	pthread_cond_init(&data->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	data->manual = type == OS_EVENT_TYPE_MANUAL;
+	*event = data;
+	return 0;
+}
+
+void os_event_destroy(os_event_t *event)
+{
+	if (!event)
+		return;
+	pthread_mutex_destroy(&event->mutex);
+	pthread_cond_destroy(&event->cond);
+	free(event);
+}
+
+int os_event_wait(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signalled)
+		pthread_cond_wait(&event->cond, &event->mutex);
+	if (!event->manual)
+		event->signalled = false;
+	pthread_mutex_unlock(&event->mutex);
+	return 0;
+}
+
+int os_event_timedwait(os_event_t *event, unsigned long milliseconds)
+{
+	struct timespec ts;
+	int code = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += milliseconds / 1000;
+	ts.tv_nsec += (long)(milliseconds % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signalled && code == 0)
+		code = pthread_cond_timedwait(&event->cond, &event->mutex, &ts);
+	if (event->signalled) {
+		code = 0;
+		if (!event->manual)
+			event->signalled = false;
+	}
+	pthread_mutex_unlock(&event->mutex);
+	return code;
+}
+
+int os_event_try(os_event_t *event)
+{
+	int code = EAGAIN;
+
+	pthread_mutex_lock(&event->mutex);
+	if (event->signalled) {
+		if (!event->manual)
+			event->signalled = false;
+		code = 0;
+	}
+	pthread_mutex_unlock(&event->mutex);
+	return code;
+}
+
+int os_event_signal(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = true;
+	pthread_cond_broadcast(&event->cond);
+	pthread_mutex_unlock(&event->mutex);
+	return 0;
+}
+
+void os_event_reset(os_event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = false;
+	pthread_mutex_unlock(&event->mutex);
+}
+
+void os_set_thread_name(const char *name)
+{
+	char short_name[16];
+	snprintf(short_name, sizeof(short_name), "%s", name);
+	pthread_setname_np(pthread_self(), short_name);
+}
+
+/* ------------------------------------------------------------------------- */
+/* task queue                                                                */
+
+struct stub_task {
+	os_task_t task;
+	void *param;
+};
+
+struct os_task_queue {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	DARRAY(struct stub_task) tasks;
+	bool stop;
+};
+
+static void *stub_task_thread(void *data)
+{
+	struct os_task_queue *tq = data;
+
+	os_set_thread_name("task queue");
+	pthread_mutex_lock(&tq->mutex);
+	for (;;) {
+		while (!tq->tasks.num && !tq->stop)
+			pthread_cond_wait(&tq->cond, &tq->mutex);
+		if (!tq->tasks.num)
+			break;
+
+		struct stub_task task = tq->tasks.array[0];
+		da_erase(tq->tasks, 0);
+		pthread_mutex_unlock(&tq->mutex);
+		task.task(task.param);
+		pthread_mutex_lock(&tq->mutex);
+	}
+	pthread_mutex_unlock(&tq->mutex);
+	return NULL;
+}
+
+os_task_queue_t *os_task_queue_create(void)
+{
+	struct os_task_queue *tq = calloc(1, sizeof(*tq));
+
+	pthread_mutex_init(&tq->mutex, NULL);
+	pthread_cond_init(&tq->cond, NULL);
+	if (pthread_create(&tq->thread, NULL, stub_task_thread, tq) != 0) {
+		pthread_mutex_destroy(&tq->mutex);
+		pthread_cond_destroy(&tq->cond);
+		free(tq);
+		return NULL;
+	}
+	return tq;
+}
+
+bool os_task_queue_queue_task(os_task_queue_t *tq, os_task_t task, void *param)
+{
+	struct stub_task item = {task, param};
+
+	if (!tq)
+		return false;
+
+	pthread_mutex_lock(&tq->mutex);
+	da_push_back(tq->tasks, &item);
+	pthread_cond_signal(&tq->cond);
+	pthread_mutex_unlock(&tq->mutex);
+	return true;
+}
+
+static void stub_task_signal(void *param)
+{
+	os_event_signal(param);
+}
+
+bool os_task_queue_wait(os_task_queue_t *tq)
+{
+	os_event_t *event;
+
+	if (!tq || os_task_queue_inside(tq))
+		return false;
+
+	os_event_init(&event, OS_EVENT_TYPE_MANUAL);
+	os_task_queue_queue_task(tq, stub_task_signal, event);
+	os_event_wait(event);
+	os_event_destroy(event);
+	return true;
+}
+
+bool os_task_queue_inside(os_task_queue_t *tq)
+{
+	return tq && pthread_equal(tq->thread, pthread_self());
+}
+
+void os_task_queue_destroy(os_task_queue_t *tq)
+{
+	if (!tq)
+		return;
+
+	pthread_mutex_lock(&tq->mutex);
+	tq->stop = true;
+	pthread_cond_signal(&tq->cond);
+	pthread_mutex_unlock(&tq->mutex);
+	pthread_join(tq->thread, NULL);
+
+	da_free(tq->tasks);
+	pthread_mutex_destroy(&tq->mutex);
+	pthread_cond_destroy(&tq->cond);
+	free(tq);
+}
+
+/* ------------------------------------------------------------------------- */
+/* profiler, totals per scope name pointer                                   */
+
+#define STUB_PROFILE_NAMES 64
+#define STUB_PROFILE_DEPTH 32
+
+static struct {
+	const char *name;
+	long calls;
+	uint64_t ns;
+} stub_profile[STUB_PROFILE_NAMES];
+static pthread_mutex_t stub_profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct {
+	const char *name;
+	uint64_t start;
+} stub_profile_stack[STUB_PROFILE_DEPTH];
+static __thread int stub_profile_depth;
+
+void profile_start(const char *name)
+{
+	if (stub_profile_depth < STUB_PROFILE_DEPTH) {
+		stub_profile_stack[stub_profile_depth].name = name;
+		stub_profile_stack[stub_profile_depth].start = os_gettime_ns();
+	}
+	stub_profile_depth++;
+}
+
+void profile_end(const char *name)
+{
+	uint64_t ns;
+
+	if (--stub_profile_depth >= STUB_PROFILE_DEPTH || stub_profile_depth < 0)
+		return;
+	if (stub_profile_stack[stub_profile_depth].name != name) {
+		blog(LOG_ERROR, "profile_end(\"%s\") closes \"%s\"", name,
+		     stub_profile_stack[stub_profile_depth].name);
+		return;
+	}
+
+	ns = os_gettime_ns() - stub_profile_stack[stub_profile_depth].start;
+	pthread_mutex_lock(&stub_profile_mutex);
+	for (size_t i = 0; i < STUB_PROFILE_NAMES; i++) {
+		if (stub_profile[i].name && stub_profile[i].name != name)
+			continue;
+		stub_profile[i].name = name;
+		stub_profile[i].calls++;
+		stub_profile[i].ns += ns;
+		break;
+	}
+	pthread_mutex_unlock(&stub_profile_mutex);
+}
+
+void stub_profile_reset(void)
+{
+	pthread_mutex_lock(&stub_profile_mutex);
+	memset(stub_profile, 0, sizeof(stub_profile));
+	pthread_mutex_unlock(&stub_profile_mutex);
+}
+
+bool stub_profile_get(const char *name, long *calls, uint64_t *ns)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&stub_profile_mutex);
+	for (size_t i = 0; i < STUB_PROFILE_NAMES && stub_profile[i].name; i++) {
+		if (stub_profile[i].name != name)
+			continue;
+		*calls = stub_profile[i].calls;
+		*ns = stub_profile[i].ns;
+		found = true;
+		break;
+	}
+	pthread_mutex_unlock(&stub_profile_mutex);
+
+	if (!found) {
+		*calls = 0;
+		*ns = 0;
+	}
+	return found;
+}
+
+/* ------------------------------------------------------------------------- */
+/* timings                                                                   */
+
+void stub_timings_add(struct stub_timings *t, uint64_t ns)
+{
+	if (t->num == t->capacity) {
+		t->capacity = t->capacity ? t->capacity * 2 : 256;
+		t->ns = realloc(t->ns, t->capacity * sizeof(*t->ns));
+	}
+	t->ns[t->num++] = ns;
+}
+
+static int stub_compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+uint64_t stub_timings_percentile(struct stub_timings *t, double p)
+{
+	size_t idx;
+
+	if (!t->num)
+		return 0;
+
+	qsort(t->ns, t->num, sizeof(*t->ns), stub_compare_u64);
+	idx = (size_t)(p / 100.0 * (double)(t->num - 1) + 0.5);
+	return t->ns[idx < t->num ? idx : t->num - 1];
+}
+
+void stub_timings_print(const struct stub_timings *t, const char *label)
+{
+	struct stub_timings sorted = *t;
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < t->num; i++)
+		total += t->ns[i];
+
+	printf("  %-26s %6zu frames  mean %8.1f us  p50 %8.1f  p95 %8.1f  p99 %8.1f  max %8.1f\n",
+	       label, t->num, t->num ? (double)total / (double)t->num / 1000.0 : 0.0,
+	       stub_timings_percentile(&sorted, 50) / 1000.0,
+	       stub_timings_percentile(&sorted, 95) / 1000.0,
+	       stub_timings_percentile(&sorted, 99) / 1000.0,
+	       stub_timings_percentile(&sorted, 100) / 1000.0);
+}
+
+void stub_timings_free(struct stub_timings *t)
+{
+	free(t->ns);
+	memset(t, 0, sizeof(*t));
+}
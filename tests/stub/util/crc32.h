@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+uint32_t calc_crc32(uint32_t crc, const void *buf, size_t size);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+#define DARRAY_INVALID ((size_t)-1)
+
+struct darray {
+	void *array;
+	size_t num;
+	size_t capacity;
+};
+
+#define DARRAY(type)                     \
+	union {                          \
+		struct darray da;        \
+		struct {                 \
+			type *array;     \
+			size_t num;      \
+			size_t capacity; \
+		};                       \
+	}
+
+void darray_free(struct darray *dst);
+void darray_reserve(const size_t element_size, struct darray *dst, const size_t capacity);
+void darray_resize(const size_t element_size, struct darray *dst, const size_t size);
+void darray_copy(const size_t element_size, struct darray *dst, const struct darray *da);
+size_t darray_push_back(const size_t element_size, struct darray *dst, const void *item);
+void *darray_push_back_new(const size_t element_size, struct darray *dst);
+size_t darray_push_back_array(const size_t element_size, struct darray *dst, const void *array,
+			      const size_t num);
+void darray_insert(const size_t element_size, struct darray *dst, const size_t idx, const void *item);
+void *darray_insert_new(const size_t element_size, struct darray *dst, const size_t idx);
+void darray_erase(const size_t element_size, struct darray *dst, const size_t idx);
+void darray_erase_range(const size_t element_size, struct darray *dst, const size_t start,
+			const size_t end);
+
+#define da_init(v) memset(&(v), 0, sizeof(v))
+#define da_free(v) darray_free(&(v).da)
+#define da_reserve(v, capacity) darray_reserve(sizeof(*(v).array), &(v).da, capacity)
+#define da_resize(v, size) darray_resize(sizeof(*(v).array), &(v).da, size)
+#define da_copy(dst, src) darray_copy(sizeof(*(dst).array), &(dst).da, &(src).da)
+#define da_push_back(v, item) darray_push_back(sizeof(*(v).array), &(v).da, item)
+#define da_push_back_new(v) darray_push_back_new(sizeof(*(v).array), &(v).da)
+#define da_push_back_array(dst, src_array, n) \
+	darray_push_back_array(sizeof(*(dst).array), &(dst).da, src_array, n)
+#define da_insert(v, idx, item) darray_insert(sizeof(*(v).array), &(v).da, idx, item)
+#define da_insert_new(v, idx) darray_insert_new(sizeof(*(v).array), &(v).da, idx)
+#define da_erase(v, idx) darray_erase(sizeof(*(v).array), &(v).da, idx)
+#define da_erase_range(v, start, end) darray_erase_range(sizeof(*(v).array), &(v).da, start, end)
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+FILE *os_fopen(const char *path, const char *mode);
+int os_stat(const char *file, struct stat *st);
+bool os_file_exists(const char *path);
+int os_unlink(const char *path);
+int os_rename(const char *old_path, const char *new_path);
+const char *os_get_path_extension(const char *path);
+
+#define MKDIR_EXISTS 1
+#define MKDIR_SUCCESS 0
+#define MKDIR_ERROR -1
+
+int os_mkdir(const char *path);
+int os_mkdirs(const char *path);
+
+void os_sleep_ms(uint32_t duration);
+uint64_t os_gettime_ns(void);
+int os_get_logical_cores(void);
+
+char *os_quick_read_utf8_file(const char *path);
+bool os_quick_write_utf8_file(const char *path, const char *str, size_t len, bool marker);
+bool os_quick_write_utf8_file_safe(const char *path, const char *str, size_t len, bool marker,
+				   const char *temp_ext, const char *backup_ext);
+
+struct os_dir;
+typedef struct os_dir os_dir_t;
+
+struct os_dirent {
+	char d_name[256];
+	bool directory;
+};
+
+os_dir_t *os_opendir(const char *path);
+struct os_dirent *os_readdir(os_dir_t *dir);
+void os_closedir(os_dir_t *dir);
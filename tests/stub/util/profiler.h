@@ -0,0 +1,4 @@
+#pragma once
+
+void profile_start(const char *name);
+void profile_end(const char *name);
@@ -0,0 +1,170 @@
+/*
+ * The team control file is read and parsed on the task queue: a read that
+ * blocks never holds up the tick, deltas still land on a later tick in
+ * order and once per seq, the changed team reaches the settings only when
+ * they're saved, and a source can go away while its read is stuck.  A new
+ * dice count in cycle cards is redrawn into the card's atlas cells.
+ * The control file is a fifo for the blocking cases, opening one for
+ * reading waits until a writer shows up.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *team = "4x75bff;2x78avx;3x12xfc";
+
+static void write_control(const char *path, const char *json)
+{
+	struct dstr temp = { 0 };
+	dstr_printf(&temp, "%s.tmp", path);
+	STUB_CHECK(os_quick_write_utf8_file(temp.array, json, strlen(json), false));
+	STUB_CHECK(os_rename(temp.array, path) == 0);
+	dstr_free(&temp);
+}
+
+//lets a read stuck opening the fifo through, it reads nothing
+static void release_fifo(const char *path)
+{
+	int fd = -1;
+	for (int i = 0; i < 5000 && fd < 0; i++) {
+		fd = open(path, O_WRONLY | O_NONBLOCK);
+		if (fd < 0)
+			os_sleep_ms(1);
+	}
+	STUB_CHECK(fd >= 0);
+	close(fd);
+}
+
+static void frames(struct harness_source *h, int count)
+{
+	for (int i = 0; i < count; i++) {
+		harness_frame(h, 1.0f / 60.0f);
+		os_sleep_ms(1);
+	}
+}
+
+static bool run_until_dice(struct harness_source *h, size_t card, uint8_t dice)
+{
+	for (int i = 0; i < 60 * 10; i++) {
+		if (h->context->team.array[card].dice == dice)
+			return true;
+		frames(h, 1);
+	}
+	return false;
+}
+
+static void test_atlas(const char *folder)
+{
+	struct harness_source h;
+	struct dstr control = { 0 };
+	struct stub_gfx_counts before, after;
+
+	dstr_printf(&control, "%s/atlas.json", folder);
+	obs_data_t *settings = harness_settings(folder, team, "Cycle Cards");
+	obs_data_set_string(settings, "controlfile", control.array);
+	obs_data_set_bool(settings, "dicecount", true);
+	harness_create(&h, "atlas", settings);
+	dm_source_show(h.context);
+	harness_settle(&h, 1000);
+	frames(&h, 2);
+	gs_texture_t *atlas = h.context->atlas;
+	STUB_CHECK(atlas && h.context->frames.num == 3);
+
+	stub_gfx_get(&before);
+	write_control(control.array, "{\"seq\": 1, \"deltas\": [{\"op\": \"dice\", \"card\": 3, \"dice\": 7}]}");
+	STUB_CHECK(run_until_dice(&h, 2, 7));
+	stub_gfx_get(&after);
+	printf("dice delta in the atlas: %ld textures created, %ld copies\n",
+		after.textures_created - before.textures_created, after.copies - before.copies);
+	STUB_CHECK(h.context->atlas == atlas && h.context->frames.num == 3);
+	//just the one cell: blanked around the narrower strip, card, strip
+	STUB_CHECK(after.copies > before.copies && after.copies - before.copies <= 3);
+
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	os_task_queue_wait(dm_tasks);
+	dstr_free(&control);
+}
+
+int main(void)
+{
+	struct harness_source h;
+	struct dstr control = { 0 };
+
+	//a read on the video thread would hang here, fail instead
+	alarm(60);
+	harness_module_load();
+	char *folder = stub_temp_dir("dm-control");
+	STUB_CHECK(folder);
+	harness_write_cards(folder, team, NULL, 0);
+	dstr_printf(&control, "%s/control.json", folder);
+	STUB_CHECK(mkfifo(control.array, 0600) == 0);
+
+	obs_data_t *settings = harness_settings(folder, team, "Playmat View");
+	obs_data_set_string(settings, "controlfile", control.array);
+	harness_create(&h, "control", settings);
+	dm_source_show(h.context);
+	harness_settle(&h, 1000);
+
+	//the read is stuck on the fifo for a couple of seconds of frames
+	uint64_t start = os_gettime_ns();
+	frames(&h, 120);
+	STUB_CHECK(os_atomic_load_bool(&h.context->control->reading));
+	printf("120 frames with the control file read blocked: %.1f ms\n", (os_gettime_ns() - start) / 1e6);
+	release_fifo(control.array);
+	os_task_queue_wait(dm_tasks);
+	os_unlink(control.array);
+
+	long calls;
+	uint64_t ns;
+	write_control(control.array, "{\"seq\": 1, \"deltas\": [{\"op\": \"dice\", \"card\": 1, \"dice\": 1}, "
+		"{\"op\": \"dice\", \"card\": 1, \"dice\": 6}]}");
+	STUB_CHECK(run_until_dice(&h, 0, 6));
+	STUB_CHECK(stub_profile_get(dm_profile_control, &calls, &ns) && calls > 0);
+	STUB_CHECK(strcmp(h.context->tbstring, "6x75bff;2x78avx;3x12xfc") == 0);
+
+	//the tick leaves the settings alone, an update for another setting
+	//keeps the changed team and saving writes it back
+	STUB_CHECK(strcmp(obs_data_get_string(settings, "tbstring"), team) == 0);
+	obs_data_set_int(settings, "speed", 5);
+	harness_update(&h);
+	STUB_CHECK(strcmp(h.context->tbstring, "6x75bff;2x78avx;3x12xfc") == 0);
+	dm_source_save(h.context, settings);
+	STUB_CHECK(strcmp(obs_data_get_string(settings, "tbstring"), "6x75bff;2x78avx;3x12xfc") == 0);
+	harness_update(&h);
+	STUB_CHECK(strcmp(h.context->tbstring, "6x75bff;2x78avx;3x12xfc") == 0);
+
+	//new contents at an old seq are ignored, a higher seq repeats a delta
+	write_control(control.array, "{\"seq\": 1, \"deltas\": [{\"op\": \"dice\", \"card\": 2, \"dice\": 9}]}");
+	frames(&h, 90);
+	os_task_queue_wait(dm_tasks);
+	frames(&h, 1);
+	STUB_CHECK(h.context->team.array[1].dice == 2);
+	write_control(control.array, "{\"seq\": 2, \"deltas\": [{\"op\": \"dice\", \"card\": 2, \"dice\": 9}]}");
+	STUB_CHECK(run_until_dice(&h, 1, 9));
+
+	test_atlas(folder);
+
+	//the source goes away while its read is stuck
+	os_unlink(control.array);
+	STUB_CHECK(mkfifo(control.array, 0600) == 0);
+	frames(&h, 60);
+	STUB_CHECK(os_atomic_load_bool(&h.context->control->reading));
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	release_fifo(control.array);
+	os_task_queue_wait(dm_tasks);
+
+	harness_check_graphics();
+	obs_module_unload();
+	os_unlink(control.array);
+	stub_remove_dir(folder);
+	bfree(folder);
+	dstr_free(&control);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
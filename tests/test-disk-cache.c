@@ -0,0 +1,346 @@
+/*
+ * The on disk cache index: a card deleted behind its back is fetched again,
+ * only that card, compressed variants and bundles count against the budget,
+ * changes from another process sharing the folder are merged rather than
+ * written over, a card another process just replaced isn't deleted for
+ * not matching the size this one recorded, and lookups aren't held up by a
+ * flush writing the index.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+#include "mock-server.h"
+#include <utime.h>
+
+static const char *team = "2x75bff;1x78avx;3x12xfc";
+
+static void card_path(struct dstr *path, const char *folder, const char *name)
+{
+	dstr_printf(path, "%s/%s", folder, name);
+}
+
+static void age_file(const char *path, time_t seconds)
+{
+	struct utimbuf times;
+	times.actime = times.modtime = time(NULL) - seconds;
+	STUB_CHECK(utime(path, &times) == 0);
+}
+
+static uint64_t file_size(const char *path)
+{
+	struct stat st;
+	STUB_CHECK(os_stat(path, &st) == 0);
+	return (uint64_t)st.st_size;
+}
+
+//the in-memory entry for path, false if there's none
+static bool entry_get(const char *path, struct dm_disk_entry *out)
+{
+	size_t folder_len, pos;
+	const char *name = dm_disk_split(path, &folder_len);
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(path, folder_len);
+	bool found = dm_disk_find(index, name, &pos);
+	if (found)
+		*out = index->entries.array[pos];
+	pthread_mutex_unlock(&dm_disk.mutex);
+	return found;
+}
+
+static uint64_t index_bytes(const char *folder)
+{
+	pthread_mutex_lock(&dm_disk.mutex);
+	uint64_t bytes = dm_disk_get(folder, strlen(folder))->bytes;
+	pthread_mutex_unlock(&dm_disk.mutex);
+	return bytes;
+}
+
+//what another process would see in the folder's index file
+static bool saved_has(const char *folder, const char *name)
+{
+	struct dm_disk_index disk = { 0 };
+	size_t pos;
+	disk.folder = (char *)folder;
+	dm_disk_load(&disk);
+	bool found = dm_disk_find(&disk, name, &pos);
+	dm_disk_clear(&disk);
+	return found;
+}
+
+//an index that was in the cache but whose file is gone is forgotten on the
+//failed load, not trusted forever
+static void test_stale_index(const char *folder)
+{
+	struct dstr path = { 0 };
+	struct dm_disk_entry entry;
+
+	card_path(&path, folder, "75bff.jpg");
+	STUB_CHECK(dm_disk_exists(path.array));
+	os_unlink(path.array);
+	STUB_CHECK(entry_get(path.array, &entry));
+
+	dm_images_purge();
+	STUB_CHECK(dm_image_acquire(path.array, 0, false, NULL) == NULL);
+	STUB_CHECK(!entry_get(path.array, &entry));
+	STUB_CHECK(!dm_disk_exists(path.array));
+
+	harness_write_cards(folder, "1x75bff", NULL, 0);
+	dstr_free(&path);
+}
+
+//cycle mode refetches the one card that went missing instead of parsing
+//the team again on every prefetch
+static void test_cycle_refetch(const char *folder, struct mock_server *srv)
+{
+	struct harness_source h;
+	struct mock_server_counts before, after;
+	struct dstr path = { 0 };
+	long parses, parsed;
+	uint64_t ns;
+
+	obs_data_t *settings = harness_settings(folder, team, "Cycle Cards");
+	obs_data_set_string(settings, "cardservice", mock_server_url(srv));
+	obs_data_set_bool(settings, "cycleatlas", false);
+	obs_data_set_int(settings, "speed", 1);
+	harness_create(&h, "cycle", settings);
+	dm_source_show(h.context);
+	harness_settle(&h, 1000);
+	STUB_CHECK(h.context->waiting == 0);
+
+	//the last card hasn't been on screen or prefetched yet
+	card_path(&path, folder, "12xfc.jpg");
+	os_unlink(path.array);
+	dm_images_purge();
+	mock_server_counts(srv, &before);
+	STUB_CHECK(stub_profile_get(dm_profile_file_list, &parses, &ns));
+
+	for (int i = 0; i < 60 * 20 && !(os_file_exists(path.array) && h.context->waiting == 0); i++) {
+		harness_frame(&h, 1.0f / 60.0f);
+		os_sleep_ms(1);
+	}
+	//a few more turns of the cycle with the card back
+	for (int i = 0; i < 60 * 4; i++)
+		harness_frame(&h, 1.0f / 60.0f);
+
+	mock_server_counts(srv, &after);
+	STUB_CHECK(stub_profile_get(dm_profile_file_list, &parsed, &ns));
+	STUB_CHECK(os_file_exists(path.array));
+	STUB_CHECK(after.requests - before.requests == 1);
+	STUB_CHECK(parsed == parses);
+
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	dstr_free(&path);
+}
+
+//variants and bundles are in the index, variants are evicted with their
+//cards and bundles stay
+static void test_budget(const char *folder)
+{
+	struct dstr path = { 0 };
+	struct dstr bc1 = { 0 };
+	struct dstr file = { 0 };
+	struct dm_disk_entry entry;
+	size_t sets;
+
+	card_path(&path, folder, "78avx.jpg");
+	dm_images_purge();
+	struct dm_image *image = dm_image_acquire(path.array, 0, true, NULL);
+	STUB_CHECK(image && image->compressed);
+	dm_image_release(image);
+	dm_bc1_path(&bc1, path.array, 0);
+	STUB_CHECK(entry_get(bc1.array, &entry) && entry.size == file_size(bc1.array));
+
+	STUB_CHECK(dm_bundle_build_folder(folder, &sets) > 0);
+	card_path(&file, folder, "avx.dmb");
+	char *pointer = os_quick_read_utf8_file(file.array);
+	STUB_CHECK(pointer);
+	card_path(&file, folder, pointer);
+	bfree(pointer);
+	STUB_CHECK(entry_get(file.array, &entry) && entry.size == file_size(file.array));
+	uint64_t bundles = 0;
+	pthread_mutex_lock(&dm_disk.mutex);
+	struct dm_disk_index *index = dm_disk_get(folder, strlen(folder));
+	for (size_t i = 0; i < index->entries.num; i++)
+		if (dm_bundle_is_file(index->entries.array[i].name))
+			bundles += index->entries.array[i].size;
+	pthread_mutex_unlock(&dm_disk.mutex);
+
+	//nothing counts as used this session, the budget is far too small
+	int64_t session_start = dm_disk.session_start;
+	dm_disk.session_start = INT64_MAX;
+	dm_disk_set_budget(1);
+	STUB_CHECK(index_bytes(folder) > 1024 * 1024);
+	STUB_CHECK(dm_disk_flush());
+	dm_disk.session_start = session_start;
+	dm_disk_set_budget(DM_DISK_DEFAULT_BUDGET_MB);
+
+	STUB_CHECK(!os_file_exists(path.array) && !os_file_exists(bc1.array));
+	STUB_CHECK(!entry_get(bc1.array, &entry));
+	STUB_CHECK(os_file_exists(file.array));
+	STUB_CHECK(index_bytes(folder) == bundles);
+	STUB_CHECK(saved_has(folder, strrchr(file.array, '/') + 1));
+
+	dstr_free(&path);
+	dstr_free(&bc1);
+	dstr_free(&file);
+}
+
+//another process adds one card and evicts another while this one adds a
+//third, the index ends up with the adds of both and neither eviction
+static void test_merge(const char *folder)
+{
+	struct dstr path = { 0 };
+	struct dm_disk_index other = { 0 };
+	struct dm_disk_entry entry;
+	size_t pos;
+
+	harness_write_cards(folder, "1x1abc;1x2abc;1x3abc", NULL, 0);
+	card_path(&path, folder, "1abc.jpg");
+	STUB_CHECK(dm_disk_exists(path.array));
+	STUB_CHECK(dm_disk_flush());
+	STUB_CHECK(saved_has(folder, "1abc.jpg"));
+
+	//the other process, 2abc is its download, 1abc it evicted
+	other.folder = (char *)folder;
+	dm_disk_load(&other);
+	card_path(&path, folder, "2abc.jpg");
+	dm_disk_insert(&other, "2abc.jpg", file_size(path.array))->used = (int64_t)time(NULL);
+	STUB_CHECK(dm_disk_find(&other, "1abc.jpg", &pos));
+	dm_disk_erase(&other, pos);
+	card_path(&path, folder, "1abc.jpg");
+	os_unlink(path.array);
+	pthread_mutex_lock(&dm_disk.mutex);
+	dm_disk_save(&other);
+	pthread_mutex_unlock(&dm_disk.mutex);
+	dm_disk_clear(&other);
+
+	card_path(&path, folder, "3abc.jpg");
+	STUB_CHECK(dm_disk_exists(path.array));
+	STUB_CHECK(dm_disk_flush());
+	STUB_CHECK(saved_has(folder, "2abc.jpg"));
+	STUB_CHECK(saved_has(folder, "3abc.jpg"));
+	STUB_CHECK(!saved_has(folder, "1abc.jpg"));
+	card_path(&path, folder, "2abc.jpg");
+	STUB_CHECK(entry_get(path.array, &entry));
+
+	//and what this process drops doesn't come back from the file
+	card_path(&path, folder, "3abc.jpg");
+	dm_disk_invalidate(path.array);
+	STUB_CHECK(dm_disk_flush());
+	STUB_CHECK(!saved_has(folder, "3abc.jpg"));
+	STUB_CHECK(!entry_get(path.array, &entry));
+
+	dstr_free(&path);
+}
+
+static void test_size_mismatch(const char *folder)
+{
+	struct dstr path = { 0 };
+	struct dm_disk_entry entry;
+	struct dm_image *image;
+
+	harness_write_cards(folder, "1x4abc;1x5abc", NULL, 0);
+	card_path(&path, folder, "4abc.jpg");
+	uint64_t size = file_size(path.array);
+
+	//just replaced by another process whose index isn't saved yet
+	dm_disk_record(path.array, size + 1, 1234);
+	dm_images_purge();
+	image = dm_image_acquire(path.array, 0, false, NULL);
+	STUB_CHECK(image);
+	dm_image_release(image);
+	STUB_CHECK(os_file_exists(path.array));
+	STUB_CHECK(entry_get(path.array, &entry) && entry.size == size && entry.crc == 0);
+
+	//an older replacement the other process has saved to the index
+	dm_disk_record(path.array, size, 777);
+	STUB_CHECK(dm_disk_flush());
+	dm_disk_record(path.array, size + 1, 555);
+	age_file(path.array, DM_FETCH_LOCK_STALE_S * 2);
+	dm_images_purge();
+	image = dm_image_acquire(path.array, 0, false, NULL);
+	STUB_CHECK(image);
+	dm_image_release(image);
+	STUB_CHECK(entry_get(path.array, &entry) && entry.size == size && entry.crc == 777);
+
+	//an old file nobody accounts for is still taken as corrupt
+	card_path(&path, folder, "5abc.jpg");
+	dm_disk_record(path.array, file_size(path.array) + 1, 555);
+	age_file(path.array, DM_FETCH_LOCK_STALE_S * 2);
+	dm_images_purge();
+	STUB_CHECK(dm_image_acquire(path.array, 0, false, NULL) == NULL);
+	STUB_CHECK(!os_file_exists(path.array));
+
+	dstr_free(&path);
+}
+
+#define SAVE_DELAY_MS 300
+
+static void *flush_thread(void *data)
+{
+	volatile bool *flushing = data;
+	os_atomic_set_bool(flushing, true);
+	STUB_CHECK(dm_disk_flush());
+	return NULL;
+}
+
+//the index is written with the mutex let go, a card looked up meanwhile
+//doesn't wait for the disk
+static void test_unlocked_flush(const char *folder)
+{
+	struct dstr path = { 0 };
+	volatile bool flushing = false;
+	pthread_t thread;
+
+	harness_write_cards(folder, "1x6abc;1x7abc", NULL, 0);
+	card_path(&path, folder, "6abc.jpg");
+	STUB_CHECK(dm_disk_exists(path.array));
+
+	stub_set_save_delay(SAVE_DELAY_MS);
+	STUB_CHECK(pthread_create(&thread, NULL, flush_thread, (void *)&flushing) == 0);
+	while (!os_atomic_load_bool(&flushing))
+		os_sleep_ms(1);
+	os_sleep_ms(SAVE_DELAY_MS / 10);
+
+	card_path(&path, folder, "7abc.jpg");
+	uint64_t start = os_gettime_ns();
+	STUB_CHECK(dm_disk_exists(path.array));
+	uint64_t ns = os_gettime_ns() - start;
+	pthread_join(thread, NULL);
+	stub_set_save_delay(0);
+
+	printf("lookup during a %d ms index save took %.1f ms\n", SAVE_DELAY_MS, ns / 1e6);
+	STUB_CHECK(ns < SAVE_DELAY_MS / 2 * 1000000ULL);
+	STUB_CHECK(saved_has(folder, "6abc.jpg"));
+	//added after the copy was taken, so it waits for the next flush
+	STUB_CHECK(dm_disk_flush());
+	STUB_CHECK(saved_has(folder, "7abc.jpg"));
+
+	dstr_free(&path);
+}
+
+int main(void)
+{
+	harness_module_load();
+	struct mock_server *srv = mock_server_start();
+	STUB_CHECK(srv);
+	char *folder = stub_temp_dir("dm-disk-cache");
+	STUB_CHECK(folder);
+	harness_write_cards(folder, team, NULL, 0);
+
+	test_stale_index(folder);
+	test_cycle_refetch(folder, srv);
+	test_budget(folder);
+	test_merge(folder);
+	test_size_mismatch(folder);
+	test_unlocked_flush(folder);
+	harness_check_graphics();
+
+	mock_server_stop(srv);
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * The per-file fetch lock shared between OBS instances: it names its owner,
+ * an owner's unlock never removes another process's lock, a stale lock is
+ * taken over along with the partial download it left, a running download
+ * keeps its lock fresh, and a finished download holds its lock until the
+ * decoders have it in the cache.  A download is decoded from memory and
+ * cached even when its file can't be written.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+#include "mock-server.h"
+#include <utime.h>
+
+//a process that isn't this one
+#define OTHER_PID 999999UL
+
+static void write_file(const char *path, const char *text)
+{
+	STUB_CHECK(os_quick_write_utf8_file(path, text, strlen(text), false));
+}
+
+static void age_file(const char *path, time_t seconds)
+{
+	struct utimbuf times;
+	times.actime = times.modtime = time(NULL) - seconds;
+	STUB_CHECK(utime(path, &times) == 0);
+}
+
+static time_t file_age(const char *path)
+{
+	struct stat st;
+	STUB_CHECK(os_stat(path, &st) == 0);
+	return time(NULL) - st.st_mtime;
+}
+
+static void test_lock(const char *folder)
+{
+	struct dstr path = { 0 }, lock = { 0 }, part = { 0 };
+	dstr_printf(&path, "%s/75bff.jpg", folder);
+	dm_fetch_lock_path(&lock, path.array);
+
+	//ours, and only once
+	STUB_CHECK(dm_fetch_lock(path.array));
+	STUB_CHECK(dm_fetch_lock_owner(lock.array) == dm_process_id());
+	STUB_CHECK(!dm_fetch_lock(path.array));
+
+	//a download keeps it from going stale
+	age_file(lock.array, DM_FETCH_LOCK_STALE_S / 2);
+	dm_fetch_touch(path.array);
+	STUB_CHECK(file_age(lock.array) < DM_FETCH_LOCK_STALE_S / 2);
+	dm_fetch_unlock(path.array);
+	STUB_CHECK(!os_file_exists(lock.array));
+
+	//another process's lock blocks us and outlives our unlock
+	write_file(lock.array, "999999\n");
+	STUB_CHECK(!dm_fetch_lock(path.array));
+	dm_fetch_unlock(path.array);
+	dm_fetch_touch(path.array);
+	STUB_CHECK(dm_fetch_lock_owner(lock.array) == OTHER_PID);
+
+	//once stale it's taken over and its partial download removed
+	dm_fetch_part_path(&part, path.array, OTHER_PID);
+	write_file(part.array, "half a jpeg");
+	age_file(lock.array, DM_FETCH_LOCK_STALE_S + 10);
+	STUB_CHECK(dm_fetch_lock(path.array));
+	STUB_CHECK(dm_fetch_lock_owner(lock.array) == dm_process_id());
+	STUB_CHECK(!os_file_exists(part.array));
+	dm_fetch_unlock(path.array);
+	STUB_CHECK(!os_file_exists(lock.array));
+
+	dstr_free(&path);
+	dstr_free(&lock);
+	dstr_free(&part);
+}
+
+static bool fetch_idle(void)
+{
+	pthread_mutex_lock(&dm_fetch.mutex);
+	bool idle = dm_fetch.count == 0 && dm_fetch.inflight.num == 0;
+	pthread_mutex_unlock(&dm_fetch.mutex);
+	return idle;
+}
+
+//holds up a decoder until the event is signalled
+static void block_decoder(void *param)
+{
+	os_event_wait((os_event_t *)param);
+}
+
+static void block_decoders(os_event_t *release)
+{
+	for (size_t i = 0; i < dm_decoders.count; i++)
+		os_task_queue_queue_task(dm_decoders.queues[i], block_decoder, release);
+}
+
+static void wait_idle(void)
+{
+	for (int i = 0; i < 10000 && !fetch_idle(); i++)
+		os_sleep_ms(1);
+	STUB_CHECK(fetch_idle());
+}
+
+static void push_card(struct mock_server *srv, const char *path, const char *set, const char *number)
+{
+	struct dm_fetch_job job = { 0 };
+	struct dstr url = { 0 };
+	dstr_printf(&url, "%s/Image.php?set=%s&cardnum=%s&res=l", mock_server_url(srv), set, number);
+	job.url = url.array;
+	job.path = bstrdup(path);
+	STUB_CHECK(dm_fetch_push(&job));
+}
+
+static bool image_cached(const char *path)
+{
+	bool cached = false;
+	pthread_mutex_lock(&dm_images.mutex);
+	for (size_t i = 0; i < dm_images.images.num && !cached; i++)
+		cached = strcmp(dm_images.images.array[i]->path, path) == 0;
+	pthread_mutex_unlock(&dm_images.mutex);
+	return cached;
+}
+
+//downloads are decoded from memory and written into the cache on the
+//decoders, the worker goes on to the next transfer meanwhile.  each keeps
+//its lock and in flight entry until its file is in place, and nothing is
+//ever written to the shared <path>.part.
+static void test_commit(const char *folder, struct mock_server *srv)
+{
+	static const char *cards[][2] = {{"avx", "78"}, {"xfc", "12"}};
+	struct dstr path[2] = { 0 }, shared[2] = { 0 }, lock[2] = { 0 };
+	struct mock_server_counts before, after;
+	struct stub_gfx_counts files_before, files_after;
+	os_event_t *release;
+
+	STUB_CHECK(os_event_init(&release, OS_EVENT_TYPE_MANUAL) == 0);
+	block_decoders(release);
+	mock_server_counts(srv, &before);
+	stub_gfx_get(&files_before);
+	long memory = os_atomic_load_long(&dm_gfx.memory_decodes);
+
+	for (int i = 0; i < 2; i++) {
+		dstr_printf(&path[i], "%s/%s%s.jpg", folder, cards[i][1], cards[i][0]);
+		dstr_printf(&shared[i], "%s.part", path[i].array);
+		dm_fetch_lock_path(&lock[i], path[i].array);
+		push_card(srv, path[i].array, cards[i][0], cards[i][1]);
+	}
+
+	//both bodies come in while the decoders are held up
+	for (int i = 0; i < 10000; i++) {
+		mock_server_counts(srv, &after);
+		if (after.full - before.full == 2)
+			break;
+		for (int c = 0; c < 2; c++)
+			STUB_CHECK(!os_file_exists(shared[c].array));
+		os_sleep_ms(1);
+	}
+	STUB_CHECK(after.full - before.full == 2);
+	os_sleep_ms(100);
+	for (int i = 0; i < 2; i++) {
+		STUB_CHECK(!os_file_exists(path[i].array));
+		STUB_CHECK(dm_fetch_lock_owner(lock[i].array) == dm_process_id());
+	}
+	STUB_CHECK(!fetch_idle());
+
+	os_event_signal(release);
+	wait_idle();
+	//decoded from the bodies, not from the files after they were written
+	stub_gfx_get(&files_after);
+	STUB_CHECK(os_atomic_load_long(&dm_gfx.memory_decodes) - memory == 2);
+	STUB_CHECK(files_after.decodes == files_before.decodes);
+	for (int i = 0; i < 2; i++) {
+		struct dstr part = { 0 };
+		dm_fetch_part_path(&part, path[i].array, dm_process_id());
+		STUB_CHECK(os_file_exists(path[i].array));
+		STUB_CHECK(image_cached(path[i].array));
+		STUB_CHECK(!os_file_exists(part.array));
+		STUB_CHECK(!os_file_exists(shared[i].array));
+		STUB_CHECK(!os_file_exists(lock[i].array));
+		dstr_free(&part);
+		dstr_free(&path[i]);
+		dstr_free(&shared[i]);
+		dstr_free(&lock[i]);
+	}
+	os_event_destroy(release);
+
+	//a directory in the way of the part file fails the write, the pixels
+	//are still cached for the sources waiting on the card
+	struct dstr failed = { 0 }, part = { 0 }, lock_failed = { 0 };
+	dstr_printf(&failed, "%s/30wol.jpg", folder);
+	dm_fetch_part_path(&part, failed.array, dm_process_id());
+	dm_fetch_lock_path(&lock_failed, failed.array);
+	STUB_CHECK(os_mkdir(part.array) == MKDIR_SUCCESS);
+	push_card(srv, failed.array, "wol", "30");
+	wait_idle();
+	STUB_CHECK(!os_file_exists(failed.array));
+	STUB_CHECK(!os_file_exists(lock_failed.array));
+	STUB_CHECK(image_cached(failed.array));
+	bool hit = false;
+	struct dm_image *image = dm_image_acquire(failed.array, 0, false, &hit);
+	STUB_CHECK(image && hit);
+	dm_image_release(image);
+	dstr_free(&failed);
+	dstr_free(&part);
+	dstr_free(&lock_failed);
+}
+
+int main(void)
+{
+	harness_module_load();
+	struct mock_server *srv = mock_server_start();
+	STUB_CHECK(srv);
+	char *folder = stub_temp_dir("dm-fetch-lock");
+	STUB_CHECK(folder);
+
+	test_lock(folder);
+	test_commit(folder, srv);
+
+	mock_server_stop(srv);
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
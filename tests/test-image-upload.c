@@ -0,0 +1,89 @@
+/*
+ * dm_image_face uploads outside the image cache lock: while one image is
+ * being uploaded by a slow driver, another thread still gets cached images
+ * straight away, and the upload is published once with its bytes counted.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+#define UPLOAD_DELAY_MS 300
+
+struct lookup {
+	const char *path;
+	volatile bool uploading;
+	uint64_t ns;
+	bool hit;
+};
+
+//looks up a cached image while the main thread is uploading another
+static void *lookup_thread(void *data)
+{
+	struct lookup *lookup = data;
+	while (!os_atomic_load_bool(&lookup->uploading))
+		os_sleep_ms(1);
+	os_sleep_ms(UPLOAD_DELAY_MS / 10);
+
+	uint64_t start = os_gettime_ns();
+	struct dm_image *image = dm_image_acquire(lookup->path, 0, false, &lookup->hit);
+	lookup->ns = os_gettime_ns() - start;
+	STUB_CHECK(image);
+	dm_image_release(image);
+	return NULL;
+}
+
+int main(void)
+{
+	struct lookup lookup = { 0 };
+	struct dstr first = { 0 }, second = { 0 };
+	pthread_t thread;
+
+	harness_module_load();
+	char *folder = stub_temp_dir("dm-upload");
+	STUB_CHECK(folder);
+	harness_write_cards(folder, "1x75bff;1x78avx", NULL, 0);
+	dstr_printf(&first, "%s/75bff.jpg", folder);
+	dstr_printf(&second, "%s/78avx.jpg", folder);
+
+	struct dm_image *image = dm_image_acquire(first.array, 0, false, NULL);
+	struct dm_image *other = dm_image_acquire(second.array, 0, false, NULL);
+	STUB_CHECK(image && other && !image->textures[0]);
+	dm_image_release(other);
+	pthread_mutex_lock(&dm_images.mutex);
+	size_t bytes = dm_images.bytes;
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	lookup.path = second.array;
+	STUB_CHECK(pthread_create(&thread, NULL, lookup_thread, &lookup) == 0);
+	stub_set_upload_delay(UPLOAD_DELAY_MS);
+	obs_enter_graphics();
+	os_atomic_set_bool(&lookup.uploading, true);
+	gs_texture_t *texture = dm_image_face(image, 0);
+	obs_leave_graphics();
+	stub_set_upload_delay(0);
+	pthread_join(thread, NULL);
+
+	printf("lookup during a %d ms upload took %.1f ms\n", UPLOAD_DELAY_MS, lookup.ns / 1e6);
+	STUB_CHECK(lookup.hit);
+	STUB_CHECK(lookup.ns < UPLOAD_DELAY_MS / 2 * 1000000ULL);
+
+	//published once, the second call finds it
+	STUB_CHECK(texture && image->textures[0] == texture);
+	obs_enter_graphics();
+	STUB_CHECK(dm_image_face(image, 0) == texture);
+	obs_leave_graphics();
+	pthread_mutex_lock(&dm_images.mutex);
+	STUB_CHECK(dm_images.bytes == bytes + image->pixel_bytes);
+	STUB_CHECK(image->refs == 1);
+	pthread_mutex_unlock(&dm_images.mutex);
+
+	dm_image_release(image);
+	harness_check_graphics();
+	dstr_free(&first);
+	dstr_free(&second);
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
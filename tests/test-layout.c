@@ -0,0 +1,125 @@
+/*
+ * Custom layouts: bad counts are refused, slots past the canvas are dropped,
+ * and nothing a layout asks for is copied or drawn outside a texture.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+static const char *team = "4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol";
+
+static struct dm_layout *create(const char *json)
+{
+	obs_data_t *data = obs_data_create_from_json(json);
+	STUB_CHECK(data);
+	struct dm_layout *layout = dm_layout_create(data, "test");
+	obs_data_release(data);
+	return layout;
+}
+
+static void test_validation(void)
+{
+	struct dm_layout *layout = create("{\"slots\": [{\"col\": 0, \"row\": 0}, {\"col\": 1, \"row\": 0}]}");
+	STUB_CHECK(layout && layout->slots.num == 2);
+	dm_layout_destroy(layout);
+
+	static const char *bad[] = {
+		"{\"slots\": [{\"col\": -1, \"row\": 0}]}",
+		"{\"slots\": [{\"col\": 0, \"row\": -3}]}",
+		"{\"slots\": [{\"col\": 1, \"row\": 0, \"xmargins\": -2}]}",
+		"{\"slots\": [{\"col\": 0, \"row\": 1, \"ymargins\": -1}]}",
+		"{\"slots\": [{\"col\": 100000, \"row\": 0}]}",
+		"{\"columns\": -5}",
+		"{\"columns\": 4000000000}",
+		"{\"columns\": 5, \"width\": {\"cards\": 5, \"margins\": -4}}",
+		"{\"columns\": 5, \"height\": {\"cards\": 1, \"dice\": -1}}",
+		"{\"columns\": 5, \"width\": {\"aspect\": -1.0}}",
+		"{\"columns\": 5, \"width\": {\"aspect\": 1000.0}}",
+		"{\"columns\": 5, \"height\": {\"margins\": 2}}",
+	};
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		layout = create(bad[i]);
+		if (layout)
+			fprintf(stderr, "accepted %s\n", bad[i]);
+		STUB_CHECK(!layout);
+	}
+}
+
+static void write_layout(const char *path, const char *json)
+{
+	STUB_CHECK(os_quick_write_utf8_file(path, json, strlen(json), false));
+}
+
+//renders a custom layout both ways and checks every copy and draw stayed in bounds
+static size_t run_custom(const char *folder, const char *layoutfile, bool direct)
+{
+	struct harness_source h;
+	obs_data_t *settings = harness_settings(folder, team, "Custom Layout");
+	obs_data_set_string(settings, "layoutfile", layoutfile);
+	obs_data_set_bool(settings, "directrender", direct);
+	obs_data_set_bool(settings, "dicecount", true);
+
+	dm_images_purge();
+	stub_gfx_reset();
+	harness_create(&h, "layout", settings);
+	dm_source_show(h.context);
+	harness_settle(&h, 1000);
+	for (int i = 0; i < 5; i++)
+		harness_frame(&h, 1.0f / 60.0f);
+
+	size_t slots = h.context->slots.num;
+	for (size_t i = 0; i < slots; i++) {
+		struct dm_slot *slot = &h.context->slots.array[i];
+		STUB_CHECK(slot->x + slot->cx <= h.context->width);
+		STUB_CHECK(slot->dicey + h.context->rebuild.diceheight <= h.context->height);
+	}
+	harness_check_graphics();
+
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	return slots;
+}
+
+int main(void)
+{
+	harness_module_load();
+	test_validation();
+
+	char *folder = stub_temp_dir("dm-layout");
+	STUB_CHECK(folder);
+	//cards narrower than the dice strips at their default height
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS];
+	size_t count = dm_parse_team(team, cards, DM_TEAM_MAX_CARDS);
+	struct dstr path = { 0 };
+	for (size_t i = 0; i < count; i++) {
+		dstr_printf(&path, "%s/%u%s.jpg", folder, cards[i].number, cards[i].set);
+		STUB_CHECK(stub_write_jpeg(path.array, 200, 280, cards[i].number));
+	}
+
+	//a two card canvas with slots three and four past its right edge, and a
+	//right aligned slot wider than what's left of it
+	dstr_printf(&path, "%s/layout.json", folder);
+	write_layout(path.array,
+		"{\"width\": {\"cards\": 2, \"margins\": 1},"
+		" \"height\": {\"cards\": 1, \"dice\": 1},"
+		" \"slots\": ["
+		"  {\"col\": 0, \"row\": 0},"
+		"  {\"col\": 1, \"row\": 0},"
+		"  {\"col\": 2, \"row\": 0},"
+		"  {\"col\": 3, \"row\": 0},"
+		"  {\"col\": 2, \"row\": 0, \"align\": \"right\"}]}");
+	STUB_CHECK(run_custom(folder, path.array, false) == 2);
+	STUB_CHECK(run_custom(folder, path.array, true) == 2);
+
+	//a refused layout falls back to the horizontal row
+	write_layout(path.array, "{\"slots\": [{\"col\": -1, \"row\": 0}, {\"col\": 0, \"row\": -1}]}");
+	STUB_CHECK(run_custom(folder, path.array, false) == count);
+	STUB_CHECK(run_custom(folder, path.array, true) == count);
+
+	dstr_free(&path);
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * dm_parse_team against the corpus in data/team-strings.txt, plus generated
+ * oversized inputs, checking it never allocates and never writes past max.
+ *
+ * test-parse-team <corpus>
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+//the cards as the corpus writes them, "<dice>x<number><set>" space separated
+static void format_cards(struct dstr *out, const struct dm_team_card *cards, size_t count)
+{
+	dstr_copy(out, "");
+	for (size_t i = 0; i < count; i++)
+		dstr_catf(out, "%s%ux%u%s", i ? " " : "", cards[i].dice, cards[i].number, cards[i].set);
+}
+
+static void unescape(struct dstr *out, const char *line)
+{
+	dstr_copy(out, "");
+	if (strcmp(line, "<empty>") == 0)
+		return;
+	for (const char *p = line; *p; p++) {
+		if (p[0] == '\\' && (p[1] == 't' || p[1] == 'r' || p[1] == 'n')) {
+			p++;
+			dstr_cat_ch(out, *p == 't' ? '\t' : *p == 'r' ? '\r' : '\n');
+		}
+		else {
+			dstr_cat_ch(out, *p);
+		}
+	}
+}
+
+//parses with a guard card past max, which must come back untouched
+static size_t parse(const char *input, struct dm_team_card *cards, size_t max)
+{
+	struct dm_team_card guard;
+	memset(&guard, 0xA5, sizeof(guard));
+	cards[max] = guard;
+
+	long allocs = stub_alloc_count();
+	size_t count = dm_parse_team(input, cards, max);
+	STUB_CHECK(stub_alloc_count() == allocs);
+	STUB_CHECK(count <= max);
+	STUB_CHECK(memcmp(&cards[max], &guard, sizeof(guard)) == 0);
+
+	for (size_t i = 0; i < count; i++) {
+		STUB_CHECK(cards[i].number > 0 && cards[i].number < 1000);
+		STUB_CHECK(cards[i].set[0] && strlen(cards[i].set) < DM_SET_CODE_MAX);
+	}
+	return count;
+}
+
+static int run_corpus(const char *path)
+{
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS + 1];
+	struct dstr input = { 0 };
+	struct dstr got = { 0 };
+	int cases = 0, failures = 0;
+
+	char *text = os_quick_read_utf8_file(path);
+	STUB_CHECK(text);
+
+	char *line = text;
+	char *pending = NULL;
+	int pending_line = 0;
+	for (int number = 1; line && *line; number++) {
+		char *next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+		size_t len = strlen(line);
+		if (len && line[len - 1] == '\r')
+			line[len - 1] = 0;
+
+		if (strncmp(line, "=>", 2) == 0) {
+			STUB_CHECK(pending);
+			const char *expected = line[2] == ' ' ? line + 3 : line + 2;
+			unescape(&input, pending);
+			format_cards(&got, cards, parse(input.array ? input.array : "", cards, DM_TEAM_MAX_CARDS));
+			const char *result = got.array ? got.array : "";
+			if (strcmp(result, expected) != 0) {
+				fprintf(stderr, "%s:%d: '%s' parsed to '%s', expected '%s'\n", path, pending_line,
+					pending, result, expected);
+				failures++;
+			}
+			cases++;
+			pending = NULL;
+		}
+		else if (*line && *line != '#') {
+			STUB_CHECK(!pending);
+			pending = line;
+			pending_line = number;
+		}
+		line = next;
+	}
+	STUB_CHECK(!pending);
+
+	printf("%d corpus cases, %d failed\n", cases, failures);
+	dstr_free(&input);
+	dstr_free(&got);
+	bfree(text);
+	return failures;
+}
+
+static void test_oversized(void)
+{
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS + 1];
+	struct dstr input = { 0 };
+
+	//no input at all
+	STUB_CHECK(dm_parse_team(NULL, cards, DM_TEAM_MAX_CARDS) == 0);
+	STUB_CHECK(parse("4x75bff", cards, 0) == 0);
+
+	//more cards than fit, the first max are kept in order
+	for (int i = 0; i < 1000; i++)
+		dstr_catf(&input, "%dx%dab;", i % 10, i % 999 + 1);
+	STUB_CHECK(parse(input.array, cards, DM_TEAM_MAX_CARDS) == DM_TEAM_MAX_CARDS);
+	for (int i = 0; i < DM_TEAM_MAX_CARDS; i++)
+		STUB_CHECK(cards[i].dice == i % 10 && cards[i].number == i % 999 + 1);
+	STUB_CHECK(parse(input.array, cards, 3) == 3);
+
+	//the same as a link, with the list ending at the next query value
+	dstr_insert(&input, 0, "https://dicecoalition.com/teambuilder/?team=");
+	dstr_cat(&input, "&name=x");
+	STUB_CHECK(parse(input.array, cards, DM_TEAM_MAX_CARDS) == DM_TEAM_MAX_CARDS);
+
+	//a set code far past the limit spoils only its own token
+	dstr_copy(&input, "1x1");
+	for (int i = 0; i < 100000; i++)
+		dstr_cat_ch(&input, 'a');
+	dstr_cat(&input, ";2x78avx");
+	STUB_CHECK(parse(input.array, cards, DM_TEAM_MAX_CARDS) == 1);
+	STUB_CHECK(cards[0].number == 78 && strcmp(cards[0].set, "avx") == 0);
+
+	//a megabyte of delimiters and of digits
+	dstr_resize(&input, 0);
+	for (int i = 0; i < 1024 * 1024; i++)
+		dstr_cat_ch(&input, ';');
+	STUB_CHECK(parse(input.array, cards, DM_TEAM_MAX_CARDS) == 0);
+	memset(input.array, '9', input.len);
+	STUB_CHECK(parse(input.array, cards, DM_TEAM_MAX_CARDS) == 0);
+
+	dstr_free(&input);
+}
+
+int main(int argc, char **argv)
+{
+	STUB_CHECK(argc > 1);
+	harness_module_load();
+
+	int failures = run_corpus(argv[1]);
+	test_oversized();
+
+	obs_module_unload();
+	STUB_CHECK(stub_alloc_live() == 0);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Updates while a direct render view is on screen: the slot table being
+ * drawn is only replaced together with its images when a rebuild swaps in,
+ * and a changed layout is always compiled again.  Rebuilds are spread over
+ * frames and every frame is rendered, and a slow decode is waited on by
+ * later frames rather than taking one over.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+#define DECODE_DELAY_MS 100
+
+static const char *team = "4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol;1x44dxm;3x59avx;2x88bff;1x120wol;4x7xfc";
+
+//the table on screen and the images drawn from it always agree
+static void check_view(struct harness_source *h)
+{
+	struct dm_source *context = h->context;
+	if (context->slotcards.num) {
+		STUB_CHECK(context->slots.num == context->slotcards.num);
+		STUB_CHECK(context->slotdice.num == context->slotcards.num);
+	}
+	for (size_t i = 0; i < context->slots.num; i++) {
+		STUB_CHECK(context->slots.array[i].card < context->files.num ||
+			   context->rebuild.stage != DM_REBUILD_IDLE);
+		STUB_CHECK(context->slots.array[i].x + context->slots.array[i].cx <= context->width);
+	}
+}
+
+static uint64_t longest_frame_ns;
+
+//frames until the rebuild the update started has swapped in, returns how
+//many drew the old view
+static int run_rebuild(struct harness_source *h)
+{
+	int frames = 0;
+	while (h->context->rebuild.stage != DM_REBUILD_IDLE && frames < 10000) {
+		uint64_t start = os_gettime_ns();
+		harness_frame(h, 1.0f / 60.0f);
+		if (os_gettime_ns() - start > longest_frame_ns)
+			longest_frame_ns = os_gettime_ns() - start;
+		check_view(h);
+		os_sleep_ms(1);
+		frames++;
+	}
+	STUB_CHECK(h->context->rebuild.stage == DM_REBUILD_IDLE);
+	return frames;
+}
+
+static void update(struct harness_source *h, const char *format, long long margins)
+{
+	obs_data_set_string(h->settings, "format", format);
+	obs_data_set_int(h->settings, "margins", margins);
+	harness_update(h);
+	check_view(h);
+}
+
+int main(void)
+{
+	struct harness_source h;
+	struct dstr layout = { 0 };
+
+	harness_module_load();
+	char *folder = stub_temp_dir("dm-rebuild");
+	STUB_CHECK(folder);
+	//big enough art that a decode takes most of a frame's rebuild budget
+	struct dm_team_card cards[DM_TEAM_MAX_CARDS];
+	size_t count = dm_parse_team(team, cards, DM_TEAM_MAX_CARDS);
+	for (size_t i = 0; i < count; i++) {
+		dstr_printf(&layout, "%s/%u%s.jpg", folder, cards[i].number, cards[i].set);
+		STUB_CHECK(stub_write_jpeg(layout.array, 1472, 2060, cards[i].number));
+	}
+	dstr_printf(&layout, "%s/three.json", folder);
+	const char *json = "{\"slots\": [{\"col\": 0, \"row\": 0}, {\"col\": 1, \"row\": 0}, {\"col\": 2, \"row\": 0}]}";
+	STUB_CHECK(os_quick_write_utf8_file(layout.array, json, strlen(json), false));
+
+	obs_data_t *settings = harness_settings(folder, team, "Horizontal Row");
+	obs_data_set_bool(settings, "directrender", true);
+	obs_data_set_bool(settings, "dicecount", true);
+	obs_data_set_int(settings, "rebuildbudget", 1);
+	obs_data_set_string(settings, "layoutfile", layout.array);
+	harness_create(&h, "rebuild", settings);
+	dm_source_show(h.context);
+	run_rebuild(&h);
+	STUB_CHECK(h.context->slots.num == 10 && h.context->slotcards.num == 10);
+
+	//fewer slots, the old ten are drawn until the three swap in
+	update(&h, "Custom Layout", 0);
+	STUB_CHECK(h.context->rebuild.stage == DM_REBUILD_IDLE || h.context->slotcards.num == 10);
+	run_rebuild(&h);
+	STUB_CHECK(h.context->slots.num == 3 && h.context->slotcards.num == 3);
+
+	//back to the row with seven cards to decode, the three stay on screen
+	//while it's built and no frame waits out a decode
+	dm_images_purge();
+	stub_set_decode_delay(DECODE_DELAY_MS);
+	longest_frame_ns = 0;
+	update(&h, "Horizontal Row", 0);
+	int frames = run_rebuild(&h);
+	stub_set_decode_delay(0);
+	printf("row rebuilt over %d frames, %d ms decodes, longest frame %.1f ms\n", frames,
+		DECODE_DELAY_MS, longest_frame_ns / 1e6);
+	STUB_CHECK(frames > 1);
+	STUB_CHECK(longest_frame_ns < DECODE_DELAY_MS / 2 * 1000000ULL);
+	STUB_CHECK(h.context->slots.num == 10 && h.context->slotcards.num == 10);
+
+	//and a change of layout halfway through a rebuild
+	dm_images_purge();
+	update(&h, "Custom Layout", 0);
+	run_rebuild(&h);
+	dm_images_purge();
+	update(&h, "Horizontal Row", 0);
+	for (int i = 0; i < 2; i++) {
+		harness_frame(&h, 1.0f / 60.0f);
+		check_view(&h);
+	}
+	update(&h, "Creator View", 0);
+	run_rebuild(&h);
+	STUB_CHECK(h.context->slots.num == 10 && h.context->slotcards.num == 10);
+	//two rows of five
+	STUB_CHECK(h.context->slots.array[5].y > h.context->slots.array[0].y);
+	STUB_CHECK(h.context->slots.array[5].x == h.context->slots.array[0].x);
+
+	//the same layout with other margins is compiled again
+	uint32_t x = h.context->slots.array[1].x;
+	update(&h, "Creator View", 20);
+	run_rebuild(&h);
+	STUB_CHECK(h.context->slots.array[1].x == x + 20);
+
+	for (int i = 0; i < 30; i++) {
+		harness_frame(&h, 1.0f / 60.0f);
+		check_view(&h);
+	}
+	harness_check_graphics();
+
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	dstr_free(&layout);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * The statistics line in the properties panel: it shows the video thread's
+ * last snapshot, is never written into the source's settings, and the panel
+ * can be opened from another thread while the source is ticking.  Also
+ * checks the layout compile step has its own profiler scope.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+static const char *team = "4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol";
+
+struct panel {
+	struct dm_source *context;
+	volatile bool stop;
+	volatile long opened;
+};
+
+//the ui thread opening the properties panel over and over
+static void *panel_thread(void *data)
+{
+	struct panel *panel = data;
+	while (!os_atomic_load_bool(&panel->stop)) {
+		obs_properties_t *props = dm_source_properties(panel->context);
+		obs_property_t *stats = obs_properties_get(props, "stats");
+		STUB_CHECK(stats && obs_property_text_type(stats) == OBS_TEXT_INFO);
+		STUB_CHECK(strncmp(obs_property_description(stats), "Statistics", 10) == 0);
+		obs_properties_destroy(props);
+		os_atomic_inc_long(&panel->opened);
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	struct harness_source h;
+	struct panel panel = { 0 };
+	pthread_t thread;
+
+	harness_module_load();
+	char *folder = stub_temp_dir("dm-stats");
+	STUB_CHECK(folder);
+	harness_write_cards(folder, team, NULL, 0);
+
+	obs_data_t *settings = harness_settings(folder, team, "Playmat View");
+	stub_profile_reset();
+	harness_create(&h, "stats", settings);
+
+	//before the first tick there's nothing to show yet
+	obs_properties_t *props = dm_source_properties(h.context);
+	STUB_CHECK(strstr(obs_property_description(obs_properties_get(props, "stats")), "image cache") == NULL);
+	obs_properties_destroy(props);
+
+	dm_source_show(h.context);
+	panel.context = h.context;
+	STUB_CHECK(pthread_create(&thread, NULL, panel_thread, &panel) == 0);
+	harness_settle(&h, 1000);
+	//a frame at a time, so the panel gets opened between ticks
+	for (int i = 0; i < 120 || os_atomic_load_long(&panel.opened) < 20; i++) {
+		harness_frame(&h, 1.0f / 60.0f);
+		os_sleep_ms(1);
+	}
+	os_atomic_set_bool(&panel.stop, true);
+	pthread_join(thread, NULL);
+	STUB_CHECK(panel.opened > 0);
+
+	props = dm_source_properties(h.context);
+	const char *text = obs_property_description(obs_properties_get(props, "stats"));
+	printf("%s\n", text);
+	STUB_CHECK(strstr(text, "image cache:") && strstr(text, "combo texture:"));
+	obs_properties_destroy(props);
+	STUB_CHECK(!obs_data_has_user_value(settings, "stats"));
+
+	long probe_calls, layout_calls;
+	uint64_t ns;
+	STUB_CHECK(stub_profile_get(dm_profile_layout, &layout_calls, &ns) && layout_calls > 0);
+	STUB_CHECK(stub_profile_get(dm_profile_probe, &probe_calls, &ns) && probe_calls > 0);
+
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}
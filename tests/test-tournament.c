@@ -0,0 +1,128 @@
+/*
+ * Switching teams of a tournament source once every team is preloaded: a
+ * team laid out the same as the last one is drawn into the last one's combo
+ * texture or atlas, so a switch creates no textures at all.  The switch only
+ * reaches the settings when they're saved.  Also checks the team list and
+ * the Active Team property go up to DM_TOURNAMENT_MAX_TEAMS.
+ */
+
+#include "../dm-source.c"
+#include "dm-harness.h"
+
+static const char *teams = "Heroes: 4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol\n"
+			   "Villains: 2x44dxm;1x59avx;4x88bff;3x120wol;2x7xfc\n"
+			   "Mixed: 1x75bff;4x44dxm;2x12xfc;3x59avx;2x30wol";
+
+static void frames(struct harness_source *h, int count)
+{
+	for (int i = 0; i < count; i++) {
+		harness_frame(h, 1.0f / 60.0f);
+		os_sleep_ms(1);
+	}
+}
+
+static void switch_team(struct harness_source *h, size_t team)
+{
+	STUB_CHECK(stub_hotkey_press("dm_source.next_team"));
+	frames(h, 1);
+	harness_settle(h, 1000);
+	STUB_CHECK(h->context->activeteam == team);
+}
+
+static void test_switch(const char *folder, const char *format, bool dicecount)
+{
+	struct harness_source h;
+	struct stub_gfx_counts before, after;
+
+	obs_data_t *settings = harness_settings(folder, "", format);
+	obs_data_set_string(settings, "teams", teams);
+	obs_data_set_int(settings, "activeteam", 1);
+	obs_data_set_bool(settings, "dicecount", dicecount);
+	harness_create(&h, "tournament", settings);
+	dm_source_show(h.context);
+	harness_settle(&h, 1000);
+	//lets the preload take every team's cards
+	frames(&h, 120);
+	STUB_CHECK(h.context->teams.num == 3);
+
+	//the first time round leaves a spare of every size in use
+	switch_team(&h, 1);
+	switch_team(&h, 2);
+
+	for (size_t team = 0; team < 3; team++) {
+		stub_gfx_get(&before);
+		switch_team(&h, team);
+		frames(&h, 10);
+		stub_gfx_get(&after);
+		printf("%s%s, switch to team %zu: %ld textures created, %ld copies\n", format,
+			dicecount ? " with dice" : "", team + 1,
+			after.textures_created - before.textures_created, after.copies - before.copies);
+		STUB_CHECK(after.textures_created == before.textures_created);
+		STUB_CHECK(after.copies > before.copies);
+		if (h.context->layout)
+			STUB_CHECK(h.context->comboTexture && h.context->slots.num == 5);
+		else
+			STUB_CHECK(h.context->atlas && h.context->frames.num == 5);
+	}
+
+	//an update for another setting keeps the team the hotkey picked
+	switch_team(&h, 0);
+	switch_team(&h, 1);
+	STUB_CHECK(obs_data_get_int(settings, "activeteam") == 1);
+	obs_data_set_int(settings, "speed", 5);
+	harness_update(&h);
+	STUB_CHECK(h.context->activeteam == 1);
+	dm_source_save(h.context, settings);
+	STUB_CHECK(obs_data_get_int(settings, "activeteam") == 2);
+	//and one for the active team itself picks that
+	obs_data_set_int(settings, "activeteam", 3);
+	harness_update(&h);
+	STUB_CHECK(h.context->activeteam == 2);
+	harness_settle(&h, 1000);
+
+	dm_source_hide(h.context);
+	harness_destroy(&h);
+	harness_check_graphics();
+}
+
+static void test_limits(const char *folder)
+{
+	struct harness_source h;
+	struct dstr many = { 0 };
+
+	for (int i = 0; i < DM_TOURNAMENT_MAX_TEAMS + 6; i++)
+		dstr_catf(&many, "Team %d: %dx75bff\n", i, i % 4 + 1);
+	obs_data_t *settings = harness_settings(folder, "", "Playmat View");
+	obs_data_set_string(settings, "teams", many.array);
+	obs_data_set_int(settings, "activeteam", DM_TOURNAMENT_MAX_TEAMS);
+	harness_create(&h, "tournament", settings);
+	STUB_CHECK(h.context->teams.num == DM_TOURNAMENT_MAX_TEAMS);
+	STUB_CHECK(h.context->activeteam == DM_TOURNAMENT_MAX_TEAMS - 1);
+
+	obs_properties_t *props = dm_source_properties(h.context);
+	STUB_CHECK(obs_property_int_max(obs_properties_get(props, "activeteam")) == DM_TOURNAMENT_MAX_TEAMS);
+	obs_properties_destroy(props);
+
+	harness_destroy(&h);
+	dstr_free(&many);
+}
+
+int main(void)
+{
+	harness_module_load();
+	char *folder = stub_temp_dir("dm-tournament");
+	STUB_CHECK(folder);
+	harness_write_cards(folder, "4x75bff;2x78avx;3x12xfc;1x101aou;2x30wol", NULL, 0);
+	harness_write_cards(folder, "2x44dxm;1x59avx;4x88bff;3x120wol;2x7xfc", NULL, 0);
+
+	test_switch(folder, "Playmat View", false);
+	test_switch(folder, "Playmat View", true);
+	test_switch(folder, "Cycle Cards", true);
+	test_limits(folder);
+
+	obs_module_unload();
+	stub_remove_dir(folder);
+	bfree(folder);
+	STUB_CHECK(stub_alloc_live() == 0);
+	return 0;
+}